@@ -34,6 +34,7 @@
 #include <fstream>
 #include <iomanip>
 #include <sstream>
+#include <cctype>
 #include <version.h>
 
 
@@ -50,8 +51,19 @@ arc_welder::arc_welder(arc_welder_args args) : current_arc_(
         args.allow_3d_arcs,
         args.default_xyz_precision,
         args.default_e_precision,
+        args.max_gcode_length,
+        args.reduce_precision_to_fit
+    ),
+    current_bezier_(
+        DEFAULT_MIN_SEGMENTS,
+        args.buffer_size,
+        args.resolution_mm,
+        args.path_tolerance_percent,
+        args.default_xyz_precision,
+        args.default_e_precision,
         args.max_gcode_length
     ),
+    lookahead_points_(DEFAULT_MAX_SEGMENTS),
     segment_statistics_(
         segment_statistic_lengths,
         segment_statistic_lengths_count,
@@ -76,15 +88,58 @@ arc_welder::arc_welder(arc_welder_args args) : current_arc_(
 
     logger_type_ = 0;
     resolution_mm_ = args.resolution_mm;
+    for (int feature_type = 0; feature_type < NUM_FEATURE_TYPES; feature_type++)
+    {
+      const feature_tolerance& tolerance = args.feature_tolerances[feature_type];
+      feature_tolerances_[feature_type] = feature_tolerance(
+        tolerance.resolution_mm >= 0 ? tolerance.resolution_mm : args.resolution_mm,
+        tolerance.path_tolerance_percent >= 0 ? tolerance.path_tolerance_percent : args.path_tolerance_percent,
+        tolerance.max_radius_mm >= 0 ? tolerance.max_radius_mm : args.max_radius_mm
+      );
+      if (feature_tolerances_[feature_type].max_radius_mm > DEFAULT_MAX_RADIUS_MM)
+      {
+        feature_tolerances_[feature_type].max_radius_mm = DEFAULT_MAX_RADIUS_MM;
+      }
+    }
     progress_callback_ = args.callback;
     verbose_output_ = false;
     source_path_ = args.source_path;
     target_path_ = args.target_path;
     gcode_position_args_ = get_args_(args.g90_g91_influences_extruder, args.buffer_size);
+    // Feature types are only tracked when they are needed, since runs never span a feature change.  Tracking them
+    // otherwise would change the default output.  Welding through comments needs them to end shapes at feature comments.
+    gcode_position_args_.track_feature_types = args.weld_through_comments;
+    for (int feature_type = 0; feature_type < NUM_FEATURE_TYPES; feature_type++)
+    {
+      if (args.feature_tolerances[feature_type].is_set())
+      {
+        gcode_position_args_.track_feature_types = true;
+      }
+    }
     allow_3d_arcs_ = args.allow_3d_arcs;
     allow_travel_arcs_ = args.allow_travel_arcs;
     allow_dynamic_precision_ = args.allow_dynamic_precision;
+    allow_bezier_curves_ = args.allow_bezier_curves;
+    simplify_polylines_ = args.simplify_polylines;
+    merge_arcs_ = args.merge_arcs;
+    weld_through_comments_ = args.weld_through_comments;
     extrusion_rate_variance_percent_ = args.extrusion_rate_variance_percent;
+    lookahead_window_ = args.lookahead_window;
+    if (lookahead_window_ < 1)
+    {
+      lookahead_window_ = 0;
+    }
+    lookahead_limit_ = lookahead_window_;
+    lookahead_minimize_bytes_ = args.lookahead_minimize_bytes;
+    compact_output_ = args.compact_output;
+    strip_comments_ = args.strip_comments;
+    current_arc_.set_compact_output(compact_output_);
+    current_bezier_.set_compact_output(compact_output_);
+    meatpack_output_ = args.meatpack_output;
+    meatpack_encoder_.set_no_spaces(args.meatpack_no_spaces);
+    line_numbers_ = args.line_numbers;
+    is_bgcode_ = false;
+    bgcode_gcode_position_ = 0;
     lines_processed_ = 0;
     gcodes_processed_ = 0;
     file_size_ = 0;
@@ -92,6 +147,11 @@ arc_welder::arc_welder(arc_welder_args args) : current_arc_(
     last_gcode_line_written_ = 0;
     points_compressed_ = 0;
     arcs_created_ = 0;
+    beziers_created_ = 0;
+    points_simplified_ = 0;
+    num_precision_reductions_ = 0;
+    bytes_saved_ = 0;
+    previous_motion_was_g0_ = false;
     arcs_aborted_by_flow_rate_ = 0;
     waiting_for_arc_ = false;
     previous_feedrate_ = -1;
@@ -145,6 +205,10 @@ gcode_position_args arc_welder::get_args_(bool g90_g91_influences_extruder, int
   args.y_max = 9999;
   args.z_min = -9999;
   args.z_max = 9999;
+  // Only motion and extruder state are needed, skip layer, height, zhop and bounds tracking.
+  args.tracking_type = position_tracking_type_motion;
+  // Relative arcs only need the distance between points, so weld them even before the position is known.
+  args.relative_moves_from_unknown_position = true;
   return args;
 }
 
@@ -167,6 +231,11 @@ void arc_welder::reset()
   file_size_ = 0;
   points_compressed_ = 0;
   arcs_created_ = 0;
+  beziers_created_ = 0;
+  points_simplified_ = 0;
+  num_precision_reductions_ = 0;
+  bytes_saved_ = 0;
+  previous_motion_was_g0_ = false;
   waiting_for_arc_ = false;
 }
 
@@ -217,6 +286,50 @@ arc_welder_results arc_welder::process()
   stream << "Source file size: " << file_size_;
   p_logger_->log(logger_type_, log_levels::DEBUG, stream.str());
 
+  is_bgcode_ = bgcode_reader::is_bgcode_file(source_path_);
+  if (is_bgcode_)
+  {
+    p_logger_->log(logger_type_, log_levels::DEBUG, "The source file is binary gcode, and the target file will be too.");
+    if (meatpack_output_)
+    {
+      p_logger_->log(logger_type_, log_levels::WARNING, "MeatPack output is not used for binary gcode, which sets its own gcode encoding.");
+      meatpack_output_ = false;
+    }
+    if (line_numbers_)
+    {
+      p_logger_->log(logger_type_, log_levels::WARNING, "Line numbers are not added to binary gcode, which isn't sent to the printer line by line.");
+      line_numbers_ = false;
+    }
+  }
+
+  if (merge_arcs_ && lookahead_window_ > 0)
+  {
+    p_logger_->log(logger_type_, log_levels::WARNING, "Existing arcs are not merged when the lookahead window is enabled.");
+  }
+  if (weld_through_comments_ && lookahead_window_ > 0)
+  {
+    p_logger_->log(logger_type_, log_levels::WARNING, "Comments end the current arc when the lookahead window is enabled.");
+  }
+
+  // Compressed sources are detected from their content.  The target is compressed according to its extension, or the
+  // same way as the source when the source is overwritten.
+  compression_format source_format = compressed_file::detect_format(source_path_);
+  compression_format target_format = source_path_ == target_path_ ? source_format : compressed_file::get_format_from_path(target_path_);
+  if (source_format != compression_format_none || target_format != compression_format_none)
+  {
+    stream.clear();
+    stream.str("");
+    stream << "Source file compression: " << compressed_file::get_format_name(source_format) << ", target file compression: " << compressed_file::get_format_name(target_format) << ".";
+    p_logger_->log(logger_type_, log_levels::DEBUG, stream.str());
+  }
+  if (!compressed_file::is_format_supported(target_format))
+  {
+    results.success = false;
+    results.message = std::string("Unable to write the target file, ") + compressed_file::get_format_name(target_format) + " compression is not supported by this build.";
+    p_logger_->log_exception(logger_type_, results.message);
+    return results;
+  }
+
   // Determine if we need to overwrite the source file
   bool overwrite_source_file = false;
   std::string temp_file_path;
@@ -239,13 +352,13 @@ arc_welder_results arc_welder::process()
   }
 
   // Create the source file read stream and target write stream
-  std::ifstream gcodeFile;
+  compressed_ifstream gcodeFile;
   p_logger_->log(logger_type_, log_levels::DEBUG, "Opening the source file for reading.");
-  gcodeFile.open(source_path_.c_str(), std::ifstream::in);
+  gcodeFile.open(source_path_.c_str(), is_bgcode_ ? std::ifstream::in | std::ifstream::binary : std::ifstream::in);
   if (!gcodeFile.is_open())
   {
     results.success = false;
-    results.message = "Unable to open the source file.";
+    results.message = gcodeFile.get_error().empty() ? "Unable to open the source file." : gcodeFile.get_error();
     p_logger_->log_exception(logger_type_, results.message);
     return results;
   }
@@ -253,17 +366,38 @@ arc_welder_results arc_welder::process()
 
   p_logger_->log(logger_type_, log_levels::DEBUG, "Opening the target file for writing.");
 
-  output_file_.open(target_path_.c_str(), std::ios_base::binary | std::ios_base::out);
+  output_file_.open(target_path_.c_str(), std::ios_base::binary | std::ios_base::out, target_format);
   if (!output_file_.is_open())
   {
     results.success = false;
-    results.message = "Unable to open the target file.";
+    results.message = output_file_.get_error().empty() ? "Unable to open the target file." : output_file_.get_error();
     p_logger_->log_exception(logger_type_, results.message);
     gcodeFile.close();
     return results;
   }
 
   p_logger_->log(logger_type_, log_levels::DEBUG, "Target file opened successfully.");
+  if (is_bgcode_ && !start_bgcode(gcodeFile))
+  {
+    results.success = false;
+    results.message = bgcode_reader_.get_error();
+    p_logger_->log_exception(logger_type_, results.message);
+    output_file_.close();
+    gcodeFile.close();
+    return results;
+  }
+  if (meatpack_output_)
+  {
+    packed_buffer_.clear();
+    meatpack_encoder_.append_start(packed_buffer_);
+    output_file_ << packed_buffer_;
+  }
+  if (line_numbers_)
+  {
+    numbered_buffer_.clear();
+    line_number_encoder_.append_start(numbered_buffer_);
+    write_encoded_to_target(numbered_buffer_);
+  }
   std::string line;
   int lines_with_no_commands = 0;
   parsed_command cmd;
@@ -273,7 +407,7 @@ arc_welder_results arc_welder::process()
   p_logger_->log(logger_type_, log_levels::DEBUG, "Processing source file.");
 
   bool arc_Welder_comment_added = false;
-  while (std::getline(gcodeFile, line) && continue_processing)
+  while (read_source_line(gcodeFile, line) && continue_processing)
   {
     lines_processed_++;
     // Check the first line of gcode and see if it = ;FLAVOR:UltiGCode
@@ -318,7 +452,7 @@ arc_welder_results arc_welder::process()
     // Always process the command through the printer, even if no command is found
     // This is important so that comments can be analyzed
     //std::cout << "stabilization::process_file - updating position...";
-    process_gcode(cmd, false, false);
+    process_gcode(cmd, false);
 
     // Only continue to process if we've found a command and either a progress_callback_ is supplied, or debug loggin is enabled.
     if (has_gcode)
@@ -335,13 +469,59 @@ arc_welder_results arc_welder::process()
     }
   }
 
-  if (current_arc_.is_shape() && waiting_for_arc_)
+  if (waiting_for_arc_ && (current_arc_.is_shape() || current_bezier_.is_shape() || lookahead_window_ > 0))
   {
     p_logger_->log(logger_type_, log_levels::DEBUG, "Processing the final line.");
-    process_gcode(cmd, true, false);
+    process_gcode(cmd, true);
   }
   p_logger_->log(logger_type_, log_levels::DEBUG, "Writing all unwritten gcodes to the target file.");
   write_unwritten_gcodes_to_file();
+  if (line_numbers_)
+  {
+    numbered_buffer_.clear();
+    line_number_encoder_.append_end(numbered_buffer_);
+    write_encoded_to_target(numbered_buffer_);
+  }
+  if (meatpack_output_)
+  {
+    // Switch the firmware back to plain text once the file has been sent
+    packed_buffer_.clear();
+    meatpack_encoder_.append_end(packed_buffer_);
+    output_file_ << packed_buffer_;
+  }
+  if (is_bgcode_)
+  {
+    packed_buffer_.clear();
+    bgcode_writer_.append_end(packed_buffer_);
+    output_file_ << packed_buffer_;
+    if (!bgcode_reader_.get_error().empty())
+    {
+      results.success = false;
+      results.message = bgcode_reader_.get_error();
+      p_logger_->log_exception(logger_type_, results.message);
+      output_file_.close();
+      gcodeFile.close();
+      if (overwrite_source_file)
+      {
+        std::remove(target_path_.c_str());
+      }
+      return results;
+    }
+  }
+  if (!gcodeFile.get_error().empty())
+  {
+    // A compressed source that is corrupt or cut short
+    results.success = false;
+    results.message = gcodeFile.get_error();
+    p_logger_->log_exception(logger_type_, results.message);
+    output_file_.close();
+    gcodeFile.close();
+    if (overwrite_source_file)
+    {
+      std::remove(target_path_.c_str());
+    }
+    return results;
+  }
 
   p_logger_->log(logger_type_, log_levels::DEBUG, "Fetching the final progress struct.");
 
@@ -418,7 +598,12 @@ arc_welder_progress arc_welder::get_progress_(long source_file_position, double
     progress.compression_percent = 0;
   }
   progress.num_firmware_compensations = current_arc_.get_num_firmware_compensations();
-  progress.num_gcode_length_exceptions = current_arc_.get_num_gcode_length_exceptions();
+  progress.num_gcode_length_exceptions = current_arc_.get_num_gcode_length_exceptions() + current_bezier_.get_num_gcode_length_exceptions();
+  progress.num_prefilter_rejects = current_arc_.get_num_prefilter_rejects();
+  progress.beziers_created = beziers_created_;
+  progress.points_simplified = points_simplified_;
+  progress.num_precision_reductions = num_precision_reductions_;
+  progress.bytes_saved = bytes_saved_;
   progress.segment_statistics = segment_statistics_;
   progress.segment_retraction_statistics = segment_retraction_statistics_;
   progress.travel_statistics = travel_statistics_;
@@ -427,12 +612,48 @@ arc_welder_progress arc_welder::get_progress_(long source_file_position, double
 
 }
 
-int arc_welder::process_gcode(parsed_command cmd, bool is_end, bool is_reprocess)
+// Returns true if the command is an extrusion that could be merged with its neighbors
+static bool is_polyline_move(const unwritten_command& command)
+{
+  return command.is_g0_g1 && command.is_extrusion && command.length > 0 && command.comment.length() == 0 &&
+    !command.end_point.is_xyz_relative && command.start_point.z == command.end_point.z;
+}
+
+// Gets I and J from a G2/G3 command.  Arcs that are described with R instead are not merged.
+static bool try_get_arc_center_offset(const parsed_command& cmd, double& i, double& j)
+{
+  bool has_center_offset = false;
+  i = 0;
+  j = 0;
+  for (std::vector<parsed_command_parameter>::const_iterator it = cmd.parameters.begin(); it != cmd.parameters.end(); ++it)
+  {
+    switch ((*it).name[0])
+    {
+    case 'I':
+      i = (*it).double_value;
+      has_center_offset = true;
+      break;
+    case 'J':
+      j = (*it).double_value;
+      has_center_offset = true;
+      break;
+    case 'R':
+      return false;
+    }
+  }
+  return has_center_offset;
+}
+
+int arc_welder::process_gcode(parsed_command& cmd, bool is_end)
 {
 
   
-  // Update the position for the source gcode file
-  p_source_position_->update(cmd, lines_processed_, gcodes_processed_, -1);
+  // Update the position for the source gcode file.  When processing the end of the file there is no new
+  // command, so the final shape is created from the current position.
+  if (!is_end)
+  {
+    p_source_position_->update(cmd, lines_processed_, gcodes_processed_, -1);
+  }
   position* p_cur_pos = p_source_position_->get_current_position_ptr();
   position* p_pre_pos = p_source_position_->get_previous_position_ptr();
   bool is_previous_extruder_relative = p_pre_pos->is_extruder_relative;
@@ -442,17 +663,28 @@ int arc_welder::process_gcode(parsed_command cmd, bool is_end, bool is_reprocess
   // Determine if this is a G0, G1, G2 or G3
   bool is_g0_g1 = cmd.command == "G0" || cmd.command == "G1";
   bool is_g2_g3 = cmd.command == "G2" || cmd.command == "G3";
+  // Existing arcs may be added to the current arc whole, when they follow the same circle
+  double arc_i = 0;
+  double arc_j = 0;
+  bool is_arc_span = !is_end && merge_arcs_ && is_g2_g3 && lookahead_window_ == 0 && try_get_arc_center_offset(cmd, arc_i, arc_j);
   //std::cout << lines_processed_ << " - " << cmd.gcode << ", CurrentEAbsolute: " << cur_extruder.e <<", ExtrusionLength: " << cur_extruder.extrusion_length << ", Retraction Length: " << cur_extruder.retraction_length << ", IsExtruding: " << cur_extruder.is_extruding << ", IsRetracting: " << cur_extruder.is_retracting << ".\n";
 
   int lines_written = 0;
   // see if this point is an extrusion
 
-  bool arc_added = false;
-  bool clear_shapes = false;
   double movement_length_mm = 0;
   bool is_extrusion = extruder_current.e_relative > 0;
   bool is_retraction = extruder_current.e_relative < 0;
   bool is_travel = !(is_extrusion || is_retraction) && (is_g0_g1 || is_g2_g3);
+
+  // Compact output leaves out Z and F when they match the previous position.  Marlin can keep a separate feedrate
+  // for G0, so F is only left out when this and the previous motion command aren't G0.
+  bool is_z_unchanged = !p_pre_pos->z_null && !p_cur_pos->z_null && p_pre_pos->z == p_cur_pos->z;
+  bool is_f_unchanged = !p_pre_pos->f_null && p_pre_pos->f == p_cur_pos->f && cmd.command != "G0" && !previous_motion_was_g0_;
+  if (!is_end && (is_g0_g1 || is_g2_g3))
+  {
+    previous_motion_was_g0_ = cmd.command == "G0";
+  }
   
   // Update the source file statistics
   if (p_cur_pos->has_xy_position_changed)
@@ -471,14 +703,14 @@ int arc_welder::process_gcode(parsed_command cmd, bool is_end, bool is_reprocess
         switch ((*it).name[0])
         {
         case 'I':
-          i = (*it).double_precision;
+          i = (*it).double_value;
           break;
         case 'J':
-          j = (*it).double_precision;
+          j = (*it).double_value;
           break;
           // Note that the R form isn't fully implemented!
         case 'R':
-          r = (*it).double_precision;
+          r = (*it).double_value;
           break;
         }
       }
@@ -501,7 +733,7 @@ int arc_welder::process_gcode(parsed_command cmd, bool is_end, bool is_reprocess
 
     if (movement_length_mm > 0)
     {
-      if (!is_reprocess)
+      if (!is_end)
       {
         if (is_extrusion)
         {
@@ -520,320 +752,468 @@ int arc_welder::process_gcode(parsed_command cmd, bool is_end, bool is_reprocess
     }
   }
 
-  // calculate the extrusion rate (mm/mm) and see how much it changes
-  double mm_extruded_per_mm_travel = 0;
-  double extrusion_rate_change_percent = 0;
-  bool aborted_by_flow_rate = false;
-  if (extrusion_rate_variance_percent_ != 0)
+  // Lines that are carried across the current shape are kept with its moves, without ending it.  Comments that change
+  // the feature type still end the shape.
+  if (
+    !is_end && weld_through_comments_ && waiting_for_arc_ && lookahead_window_ == 0 &&
+    p_cur_pos->feature_type_tag == p_pre_pos->feature_type_tag && is_carried_line(cmd)
+  )
   {
-      // TODO:  MAKE SURE THIS WORKS FOR TRANSITIONS FROM TRAVEL TO NON TRAVEL MOVES
-      if (movement_length_mm > 0 && (is_extrusion || is_retraction))
-      {
-          mm_extruded_per_mm_travel = extruder_current.e_relative / movement_length_mm;
-          if (previous_extrusion_rate_ > 0)
-          {
-              extrusion_rate_change_percent = utilities::abs(utilities::get_percent_change(previous_extrusion_rate_, mm_extruded_per_mm_travel));
-          }
-      }
-      if (previous_extrusion_rate_ != 0 && utilities::greater_than(extrusion_rate_change_percent, extrusion_rate_variance_percent_))
-      {
-          arcs_aborted_by_flow_rate_++;
-          aborted_by_flow_rate = true;
-      }
+    printer_point point(p_cur_pos->get_gcode_x(), p_cur_pos->get_gcode_y(), p_cur_pos->get_gcode_z(), extruder_current.get_offset_e(), 0, p_cur_pos->f, 0, p_pre_pos->is_extruder_relative, p_cur_pos->is_relative);
+    unwritten_commands_.push_back(unwritten_command(cmd, is_previous_extruder_relative, false, false, false, is_z_unchanged, is_f_unchanged, 0, point, point, p_cur_pos->feature_type_tag));
+    return 0;
   }
-  
 
-  // We need to make sure the printer is using absolute xyz, is extruding, and the extruder axis mode is the same as that of the previous position
-  // TODO: Handle relative XYZ axis.  This is possible, but maybe not so important.
-  
-  if (allow_dynamic_precision_ && is_g0_g1)
+  // If this command terminates the current arc, the arc is written and the command is processed again as a
+  // possible starting point for a new arc.  The position update above is reused, so loop rather than recurse.
+  for (;;)
   {
-    for (std::vector<parsed_command_parameter>::iterator it = cmd.parameters.begin(); it != cmd.parameters.end(); ++it)
+    bool arc_added = false;
+    // calculate the extrusion rate (mm/mm) and see how much it changes
+    double mm_extruded_per_mm_travel = 0;
+    double extrusion_rate_change_percent = 0;
+    bool aborted_by_flow_rate = false;
+    if (extrusion_rate_variance_percent_ != 0)
     {
-      switch ((*it).name[0])
-      {
-      case 'X':
-      case 'Y':
-      case 'Z':
-        current_arc_.update_xyz_precision((*it).double_precision);
-        break;
-      case 'E':
-        current_arc_.update_e_precision((*it).double_precision);
-        break;
-      }
+        // TODO:  MAKE SURE THIS WORKS FOR TRANSITIONS FROM TRAVEL TO NON TRAVEL MOVES
+        if (movement_length_mm > 0 && (is_extrusion || is_retraction))
+        {
+            mm_extruded_per_mm_travel = extruder_current.e_relative / movement_length_mm;
+            if (previous_extrusion_rate_ > 0)
+            {
+                extrusion_rate_change_percent = utilities::abs(utilities::get_percent_change(previous_extrusion_rate_, mm_extruded_per_mm_travel));
+            }
+        }
+        if (previous_extrusion_rate_ != 0 && utilities::greater_than(extrusion_rate_change_percent, extrusion_rate_variance_percent_))
+        {
+            arcs_aborted_by_flow_rate_++;
+            aborted_by_flow_rate = true;
+        }
     }
-  }
-
-  bool z_axis_ok = allow_3d_arcs_ ||
-    utilities::is_equal(p_cur_pos->z, p_pre_pos->z);
   
-  if (
-    !is_end && cmd.is_known_command && !cmd.is_empty && (
-      is_g0_g1 && z_axis_ok &&
-      utilities::is_equal(p_cur_pos->x_offset, p_pre_pos->x_offset) &&
-      utilities::is_equal(p_cur_pos->y_offset, p_pre_pos->y_offset) &&
-      utilities::is_equal(p_cur_pos->z_offset, p_pre_pos->z_offset) &&
-      utilities::is_equal(p_cur_pos->x_firmware_offset, p_pre_pos->x_firmware_offset) &&
-      utilities::is_equal(p_cur_pos->y_firmware_offset, p_pre_pos->y_firmware_offset) &&
-      utilities::is_equal(p_cur_pos->z_firmware_offset, p_pre_pos->z_firmware_offset) &&
-      (previous_extrusion_rate_ == 0 || utilities::less_than_or_equal(extrusion_rate_change_percent, extrusion_rate_variance_percent_)) &&
-      !p_cur_pos->is_relative &&
-      (
-        !waiting_for_arc_ ||
-        extruder_current.is_extruding ||
-        extruder_current.is_retracting ||
-        // Test for travel conversion
-        (allow_travel_arcs_ && p_cur_pos->is_travel())
-        //|| (previous_extruder.is_extruding && extruder_current.is_extruding) // Test to see if 
-        // we can get more arcs.
-        // || (previous_extruder.is_retracting && extruder_current.is_retracting) // Test to see if 
-        // we can get more arcs.
-        ) &&
-      p_cur_pos->is_extruder_relative == is_previous_extruder_relative &&
-      (!waiting_for_arc_ || p_pre_pos->f == p_cur_pos->f) && // might need to skip the waiting for arc check...
-      (!waiting_for_arc_ || p_pre_pos->feature_type_tag == p_cur_pos->feature_type_tag)
-      )
-    ) {
 
-    // Record the extrusion rate
-    previous_extrusion_rate_ = mm_extruded_per_mm_travel;
-    printer_point p(p_cur_pos->get_gcode_x(), p_cur_pos->get_gcode_y(), p_cur_pos->get_gcode_z(), extruder_current.get_offset_e(), extruder_current.e_relative, p_cur_pos->f, movement_length_mm, p_pre_pos->is_extruder_relative);
-    if (!waiting_for_arc_)
+    // We need to make sure the printer is extruding, and the extruder axis mode is the same as that of the previous position
+  
+    if (allow_dynamic_precision_ && (is_g0_g1 || is_arc_span))
     {
-      if (debug_logging_enabled_)
+      for (std::vector<parsed_command_parameter>::iterator it = cmd.parameters.begin(); it != cmd.parameters.end(); ++it)
       {
-        p_logger_->log(logger_type_, log_levels::DEBUG, "Starting new arc from Gcode:" + cmd.gcode);
+        switch ((*it).name[0])
+        {
+        case 'X':
+        case 'Y':
+        case 'Z':
+        case 'I':
+        case 'J':
+          current_arc_.update_xyz_precision((*it).double_precision);
+          current_bezier_.update_xyz_precision((*it).double_precision);
+          break;
+        case 'E':
+          current_arc_.update_e_precision((*it).double_precision);
+          current_bezier_.update_e_precision((*it).double_precision);
+          break;
+        }
       }
-      write_unwritten_gcodes_to_file();
-      // add the previous point as the starting point for the current arc
-      printer_point previous_p(p_pre_pos->get_gcode_x(), p_pre_pos->get_gcode_y(), p_pre_pos->get_gcode_z(), previous_extruder.get_offset_e(), previous_extruder.e_relative, p_pre_pos->f, 0, p_pre_pos->is_extruder_relative);
-      // Don't add any extrusion, or you will over extrude!
-      //std::cout << "Trying to add first point (" << p.x << "," << p.y << "," << p.z << ")...";
-
-      current_arc_.try_add_point(previous_p);
     }
 
-    double e_relative = extruder_current.e_relative;
-    int num_points = current_arc_.get_num_segments();
-    arc_added = current_arc_.try_add_point(p);
-    if (arc_added)
+    // In relative XYZ mode the arc endpoint is written relative to the start of the arc.  This is only exact if
+    // every source move can be represented with the current xyz precision, else rounding errors would accumulate
+    // for the rest of the file.
+    bool relative_precision_ok = true;
+    if (p_cur_pos->is_relative && (is_g0_g1 || is_arc_span))
     {
-      // Make sure our position list is large enough to handle all the segments
-      if (current_arc_.get_num_segments() + 2 > p_source_position_->get_max_positions())
-      {
-        p_source_position_->grow_max_positions(p_source_position_->get_max_positions() * 2);
-      }
-      if (!waiting_for_arc_)
-      {
-        waiting_for_arc_ = true;
-        previous_feedrate_ = p_pre_pos->f;
-      }
-      else
+      for (std::vector<parsed_command_parameter>::iterator it = cmd.parameters.begin(); it != cmd.parameters.end(); ++it)
       {
-        if (debug_logging_enabled_)
+        switch ((*it).name[0])
         {
-          if (num_points + 1 == current_arc_.get_num_segments())
+        case 'X':
+        case 'Y':
+        case 'Z':
+          if ((*it).double_precision > current_arc_.get_xyz_precision())
           {
-            p_logger_->log(logger_type_, log_levels::DEBUG, "Adding point to arc from Gcode:" + cmd.gcode);
+            relative_precision_ok = false;
           }
-
+          break;
         }
       }
     }
-  }
-  else {
 
-    if (debug_logging_enabled_) {
-      if (is_end)
-      {
-        p_logger_->log(logger_type_, log_levels::DEBUG, "Procesing final shape, if one exists.");
-      }
-      else if (!cmd.is_empty)
+    bool z_axis_ok = allow_3d_arcs_ ||
+      utilities::is_equal(p_cur_pos->z, p_pre_pos->z);
+  
+    if (
+      !is_end && cmd.is_known_command && !cmd.is_empty && (
+        (is_g0_g1 || is_arc_span) && z_axis_ok &&
+        utilities::is_equal(p_cur_pos->x_offset, p_pre_pos->x_offset) &&
+        utilities::is_equal(p_cur_pos->y_offset, p_pre_pos->y_offset) &&
+        utilities::is_equal(p_cur_pos->z_offset, p_pre_pos->z_offset) &&
+        utilities::is_equal(p_cur_pos->x_firmware_offset, p_pre_pos->x_firmware_offset) &&
+        utilities::is_equal(p_cur_pos->y_firmware_offset, p_pre_pos->y_firmware_offset) &&
+        utilities::is_equal(p_cur_pos->z_firmware_offset, p_pre_pos->z_firmware_offset) &&
+        (previous_extrusion_rate_ == 0 || utilities::less_than_or_equal(extrusion_rate_change_percent, extrusion_rate_variance_percent_)) &&
+        relative_precision_ok &&
+        (
+          !waiting_for_arc_ ||
+          extruder_current.is_extruding ||
+          extruder_current.is_retracting ||
+          // Test for travel conversion
+          (allow_travel_arcs_ && p_cur_pos->is_travel())
+          //|| (previous_extruder.is_extruding && extruder_current.is_extruding) // Test to see if 
+          // we can get more arcs.
+          // || (previous_extruder.is_retracting && extruder_current.is_retracting) // Test to see if 
+          // we can get more arcs.
+          ) &&
+        p_cur_pos->is_extruder_relative == is_previous_extruder_relative &&
+        (!waiting_for_arc_ || p_pre_pos->f == p_cur_pos->f) && // might need to skip the waiting for arc check...
+        (!waiting_for_arc_ || p_pre_pos->feature_type_tag == p_cur_pos->feature_type_tag)
+        )
+      ) {
+
+      // Record the extrusion rate
+      previous_extrusion_rate_ = mm_extruded_per_mm_travel;
+      printer_point p(p_cur_pos->get_gcode_x(), p_cur_pos->get_gcode_y(), p_cur_pos->get_gcode_z(), extruder_current.get_offset_e(), extruder_current.e_relative, p_cur_pos->f, movement_length_mm, p_pre_pos->is_extruder_relative, p_cur_pos->is_relative);
+      if (!waiting_for_arc_)
       {
-        if (!cmd.is_known_command)
-        {
-          p_logger_->log(logger_type_, log_levels::DEBUG, "Command '" + cmd.command + "' is Unknown.  Gcode:" + cmd.gcode);
-        }
-        else if (cmd.command != "G0" && cmd.command != "G1")
+        if (debug_logging_enabled_)
         {
-          p_logger_->log(logger_type_, log_levels::DEBUG, "Command '" + cmd.command + "' is not G0/G1, skipping.  Gcode:" + cmd.gcode);
+          p_logger_->log(logger_type_, log_levels::DEBUG, "Starting new arc from Gcode:" + cmd.gcode);
         }
-        else if (!allow_3d_arcs_ && !utilities::is_equal(p_cur_pos->z, p_pre_pos->z))
+        if (
+          !simplify_polylines_ || lookahead_window_ > 0 || unwritten_commands_.count() == 0 ||
+          !is_polyline_move(unwritten_commands_[unwritten_commands_.count() - 1])
+        )
         {
-          p_logger_->log(logger_type_, log_levels::DEBUG, "Z axis position changed, cannot convert:" + cmd.gcode);
+          write_unwritten_gcodes_to_file();
         }
-        else if (p_cur_pos->is_relative)
+        // Otherwise keep the commands, since the polyline they end with may continue if this arc fails
+        // Every point of the run has the same feature type, so the tolerances can be chosen now.
+        set_feature_type(p_cur_pos->feature_type_tag);
+        // add the previous point as the starting point for the current arc
+        printer_point previous_p(p_pre_pos->get_gcode_x(), p_pre_pos->get_gcode_y(), p_pre_pos->get_gcode_z(), previous_extruder.get_offset_e(), previous_extruder.e_relative, p_pre_pos->f, 0, p_pre_pos->is_extruder_relative, p_cur_pos->is_relative);
+        // Don't add any extrusion, or you will over extrude!
+        //std::cout << "Trying to add first point (" << p.x << "," << p.y << "," << p.z << ")...";
+
+        if (lookahead_window_ > 0)
         {
-          p_logger_->log(logger_type_, log_levels::DEBUG, "XYZ Axis is in relative mode, cannot convert:" + cmd.gcode);
+          lookahead_points_.clear();
+          lookahead_points_.push_back(previous_p);
+          lookahead_limit_ = lookahead_window_;
         }
-        else if (
-          waiting_for_arc_ && !(
-            (previous_extruder.is_extruding && extruder_current.is_extruding) ||
-            (previous_extruder.is_retracting && extruder_current.is_retracting)
-            )
-          )
+        else
         {
-          std::string message = "Extruding or retracting state changed, cannot add point to current arc: " + cmd.gcode;
-          if (verbose_logging_enabled_)
-          {
-
-            message.append(
-              " - Verbose Info\n\tCurrent Position Info - Absolute E:" + utilities::to_string(extruder_current.e) +
-              ", Offset E:" + utilities::to_string(extruder_current.get_offset_e()) +
-              ", Mode:" + (p_cur_pos->is_extruder_relative_null ? "NULL" : p_cur_pos->is_extruder_relative ? "relative" : "absolute") +
-              ", Retraction: " + utilities::to_string(extruder_current.retraction_length) +
-              ", Extrusion: " + utilities::to_string(extruder_current.extrusion_length) +
-              ", Retracting: " + (extruder_current.is_retracting ? "True" : "False") +
-              ", Extruding: " + (extruder_current.is_extruding ? "True" : "False")
-            );
-            message.append(
-              "\n\tPrevious Position Info - Absolute E:" + utilities::to_string(previous_extruder.e) +
-              ", Offset E:" + utilities::to_string(previous_extruder.get_offset_e()) +
-              ", Mode:" + (p_pre_pos->is_extruder_relative_null ? "NULL" : p_pre_pos->is_extruder_relative ? "relative" : "absolute") +
-              ", Retraction: " + utilities::to_string(previous_extruder.retraction_length) +
-              ", Extrusion: " + utilities::to_string(previous_extruder.extrusion_length) +
-              ", Retracting: " + (previous_extruder.is_retracting ? "True" : "False") +
-              ", Extruding: " + (previous_extruder.is_extruding ? "True" : "False")
-            );
-            p_logger_->log(logger_type_, log_levels::VERBOSE, message);
-          }
-          else
+          current_arc_.try_add_point(previous_p);
+          // Existing arcs are only merged into an arc
+          if (allow_bezier_curves_)
           {
-            p_logger_->log(logger_type_, log_levels::DEBUG, message);
+            current_bezier_.clear();
+            if (!is_arc_span)
+            {
+              current_bezier_.try_add_point(previous_p);
+            }
           }
+        }
+      }
 
+      if (lookahead_window_ > 0)
+      {
+        // Just buffer the point.  The arcs are chosen when the window is full or when the run of points ends.
+        if (waiting_for_arc_ && lookahead_points_.count() > lookahead_limit_)
+        {
+          write_lookahead_gcodes(false);
         }
-        else if (p_cur_pos->is_extruder_relative != p_pre_pos->is_extruder_relative)
+        if (lookahead_points_.count() == lookahead_points_.get_max_size())
         {
-          p_logger_->log(logger_type_, log_levels::DEBUG, "Extruder axis mode changed, cannot add point to current arc: " + cmd.gcode);
+          lookahead_points_.resize(lookahead_points_.get_max_size() * 2);
         }
-        else if (waiting_for_arc_ && p_pre_pos->f != p_cur_pos->f)
+        lookahead_points_.push_back(p);
+        waiting_for_arc_ = true;
+        arc_added = true;
+      }
+      else
+      {
+        double e_relative = extruder_current.e_relative;
+        int num_points = current_arc_.get_num_segments();
+        // Each shape is only extended while it covers the whole run, so an empty shape has dropped out of it.
+        bool arc_point_added = current_arc_.get_num_segments() > 0 && (
+          is_arc_span ? current_arc_.try_add_arc_span(p, arc_i, arc_j, cmd.command == "G2") : current_arc_.try_add_point(p)
+        );
+        bool bezier_point_added = !is_arc_span && current_bezier_.get_num_segments() > 0 && current_bezier_.try_add_point(p);
+        arc_added = arc_point_added || bezier_point_added;
+        if (arc_point_added != bezier_point_added)
         {
-          p_logger_->log(logger_type_, log_levels::DEBUG, "Feedrate changed, cannot add point to current arc: " + cmd.gcode);
+          segmented_shape& added_shape = arc_point_added ? static_cast<segmented_shape&>(current_arc_) : current_bezier_;
+          segmented_shape& rejected_shape = arc_point_added ? static_cast<segmented_shape&>(current_bezier_) : current_arc_;
+          if (rejected_shape.is_shape() && added_shape.get_num_segments() <= rejected_shape.get_num_segments())
+          {
+            // The shape that took the point has dropped some of the points at the start of the run, so end the
+            // run here and write the other one instead.
+            added_shape.clear();
+            arc_added = false;
+          }
+          else
+          {
+            rejected_shape.clear();
+          }
         }
-        else if (waiting_for_arc_ && p_pre_pos->feature_type_tag != p_cur_pos->feature_type_tag)
+        if (arc_added)
         {
-          p_logger_->log(logger_type_, log_levels::DEBUG, "Feature type changed, cannot add point to current arc: " + cmd.gcode);
+          // Make sure our position list is large enough to handle all the segments
+          int num_segments = current_arc_.get_num_segments() > current_bezier_.get_num_segments() ? current_arc_.get_num_segments() : current_bezier_.get_num_segments();
+          if (num_segments + 2 > p_source_position_->get_max_positions())
+          {
+            p_source_position_->grow_max_positions(p_source_position_->get_max_positions() * 2);
+            // Growing reallocates the position buffer
+            p_cur_pos = p_source_position_->get_current_position_ptr();
+            p_pre_pos = p_source_position_->get_previous_position_ptr();
+          }
+          if (!waiting_for_arc_)
+          {
+            waiting_for_arc_ = true;
+            previous_feedrate_ = p_pre_pos->f;
+          }
+          else
+          {
+            if (debug_logging_enabled_)
+            {
+              if (num_points + 1 == current_arc_.get_num_segments())
+              {
+                p_logger_->log(logger_type_, log_levels::DEBUG, "Adding point to arc from Gcode:" + cmd.gcode);
+              }
+
+            }
+          }
         }
-        else if (aborted_by_flow_rate)
+      }
+    }
+    else {
+
+      if (debug_logging_enabled_) {
+        if (is_end)
         {
-          std::stringstream stream;
-          stream << std::fixed << std::setprecision(5);
-          stream << "Arc Canceled - The extrusion rate variance of " << extrusion_rate_variance_percent_ << "% exceeded by " << extrusion_rate_change_percent - extrusion_rate_variance_percent_ << "% on line " << lines_processed_ << ".  Extruded " << extruder_current.e_relative << "mm over " << movement_length_mm << "mm of travel (" << mm_extruded_per_mm_travel << "mm/mm).  Previous rate: " << previous_extrusion_rate_ << "mm/mm.";
-          p_logger_->log(logger_type_, log_levels::DEBUG, stream.str());
+          p_logger_->log(logger_type_, log_levels::DEBUG, "Procesing final shape, if one exists.");
         }
-        else
+        else if (!cmd.is_empty)
         {
-          // Todo:  Add all the relevant values
-          p_logger_->log(logger_type_, log_levels::DEBUG, "There was an unknown issue preventing the current point from being added to the arc: " + cmd.gcode);
+          if (!cmd.is_known_command)
+          {
+            p_logger_->log(logger_type_, log_levels::DEBUG, "Command '" + cmd.command + "' is Unknown.  Gcode:" + cmd.gcode);
+          }
+          else if (cmd.command != "G0" && cmd.command != "G1" && !is_arc_span)
+          {
+            p_logger_->log(logger_type_, log_levels::DEBUG, "Command '" + cmd.command + "' is not G0/G1, skipping.  Gcode:" + cmd.gcode);
+          }
+          else if (!allow_3d_arcs_ && !utilities::is_equal(p_cur_pos->z, p_pre_pos->z))
+          {
+            p_logger_->log(logger_type_, log_levels::DEBUG, "Z axis position changed, cannot convert:" + cmd.gcode);
+          }
+          else if (!relative_precision_ok)
+          {
+            p_logger_->log(logger_type_, log_levels::DEBUG, "XYZ Axis is in relative mode and the gcode precision exceeds the xyz precision, cannot convert:" + cmd.gcode);
+          }
+          else if (
+            waiting_for_arc_ && !(
+              (previous_extruder.is_extruding && extruder_current.is_extruding) ||
+              (previous_extruder.is_retracting && extruder_current.is_retracting)
+              )
+            )
+          {
+            std::string message = "Extruding or retracting state changed, cannot add point to current arc: " + cmd.gcode;
+            if (verbose_logging_enabled_)
+            {
+
+              message.append(
+                " - Verbose Info\n\tCurrent Position Info - Absolute E:" + utilities::to_string(extruder_current.e) +
+                ", Offset E:" + utilities::to_string(extruder_current.get_offset_e()) +
+                ", Mode:" + (p_cur_pos->is_extruder_relative_null ? "NULL" : p_cur_pos->is_extruder_relative ? "relative" : "absolute") +
+                ", Retraction: " + utilities::to_string(extruder_current.retraction_length) +
+                ", Extrusion: " + utilities::to_string(extruder_current.extrusion_length) +
+                ", Retracting: " + (extruder_current.is_retracting ? "True" : "False") +
+                ", Extruding: " + (extruder_current.is_extruding ? "True" : "False")
+              );
+              message.append(
+                "\n\tPrevious Position Info - Absolute E:" + utilities::to_string(previous_extruder.e) +
+                ", Offset E:" + utilities::to_string(previous_extruder.get_offset_e()) +
+                ", Mode:" + (p_pre_pos->is_extruder_relative_null ? "NULL" : p_pre_pos->is_extruder_relative ? "relative" : "absolute") +
+                ", Retraction: " + utilities::to_string(previous_extruder.retraction_length) +
+                ", Extrusion: " + utilities::to_string(previous_extruder.extrusion_length) +
+                ", Retracting: " + (previous_extruder.is_retracting ? "True" : "False") +
+                ", Extruding: " + (previous_extruder.is_extruding ? "True" : "False")
+              );
+              p_logger_->log(logger_type_, log_levels::VERBOSE, message);
+            }
+            else
+            {
+              p_logger_->log(logger_type_, log_levels::DEBUG, message);
+            }
+
+          }
+          else if (p_cur_pos->is_extruder_relative != p_pre_pos->is_extruder_relative)
+          {
+            p_logger_->log(logger_type_, log_levels::DEBUG, "Extruder axis mode changed, cannot add point to current arc: " + cmd.gcode);
+          }
+          else if (waiting_for_arc_ && p_pre_pos->f != p_cur_pos->f)
+          {
+            p_logger_->log(logger_type_, log_levels::DEBUG, "Feedrate changed, cannot add point to current arc: " + cmd.gcode);
+          }
+          else if (waiting_for_arc_ && p_pre_pos->feature_type_tag != p_cur_pos->feature_type_tag)
+          {
+            p_logger_->log(logger_type_, log_levels::DEBUG, "Feature type changed, cannot add point to current arc: " + cmd.gcode);
+          }
+          else if (aborted_by_flow_rate)
+          {
+            std::stringstream stream;
+            stream << std::fixed << std::setprecision(5);
+            stream << "Arc Canceled - The extrusion rate variance of " << extrusion_rate_variance_percent_ << "% exceeded by " << extrusion_rate_change_percent - extrusion_rate_variance_percent_ << "% on line " << lines_processed_ << ".  Extruded " << extruder_current.e_relative << "mm over " << movement_length_mm << "mm of travel (" << mm_extruded_per_mm_travel << "mm/mm).  Previous rate: " << previous_extrusion_rate_ << "mm/mm.";
+            p_logger_->log(logger_type_, log_levels::DEBUG, stream.str());
+          }
+          else
+          {
+            // Todo:  Add all the relevant values
+            p_logger_->log(logger_type_, log_levels::DEBUG, "There was an unknown issue preventing the current point from being added to the arc: " + cmd.gcode);
+          }
         }
       }
-    }
 
-    // Reset the previous extrusion rate
-    previous_extrusion_rate_ = 0;
-  }
+      // Reset the previous extrusion rate
+      previous_extrusion_rate_ = 0;
+    }
 
-  if (!arc_added && !(cmd.is_empty && cmd.comment.length() == 0))
-  {
-    if (current_arc_.get_num_segments() < current_arc_.get_min_segments()) {
-      if (debug_logging_enabled_ && !cmd.is_empty)
+    if (!arc_added && (is_end || !(cmd.is_empty && cmd.comment.length() == 0)))
+    {
+      if (lookahead_window_ > 0 && waiting_for_arc_)
       {
-        if (current_arc_.get_num_segments() != 0)
+        // The run of points has ended, write it out and reprocess this line as a possible start of the next run.
+        write_lookahead_gcodes(true);
+        waiting_for_arc_ = false;
+        if (!is_end)
         {
-          p_logger_->log(logger_type_, log_levels::DEBUG, "Not enough segments, resetting. Gcode:" + cmd.gcode);
+          continue;
         }
-
+        return 0;
       }
-      waiting_for_arc_ = false;
-      current_arc_.clear();
-    }
-    else if (waiting_for_arc_)
-    {
-
-      if (current_arc_.is_shape())
+      if (
+        waiting_for_arc_ && current_bezier_.is_shape() &&
+        (!current_arc_.is_shape() || current_bezier_.get_num_segments() > current_arc_.get_num_segments())
+      )
       {
-        // update our statistics
-        points_compressed_ += current_arc_.get_num_segments() - 1;
-        arcs_created_++; // increment the number of generated arcs
-        write_arc_gcodes(p_pre_pos->f);
-        // Now clear the arc and flag the processor as not waiting for an arc
+        // The bezier curve covers more of the run than the arc
+        points_compressed_ += current_bezier_.get_num_segments() - 1;
+        beziers_created_++;
+        write_bezier_gcodes();
         waiting_for_arc_ = false;
         current_arc_.clear();
-        p_cur_pos = NULL;
-        p_pre_pos = NULL;
-
-        // Reprocess this line
+        current_bezier_.clear();
         if (!is_end)
         {
-          return process_gcode(cmd, false, true);
+          continue;
         }
-        else
+        return 0;
+      }
+      current_bezier_.clear();
+      if (current_arc_.get_num_segments() < current_arc_.get_min_segments()) {
+        if (debug_logging_enabled_ && !cmd.is_empty)
         {
-          if (debug_logging_enabled_)
+          if (current_arc_.get_num_segments() != 0)
           {
-            p_logger_->log(logger_type_, log_levels::DEBUG, "Final arc created, exiting.");
+            p_logger_->log(logger_type_, log_levels::DEBUG, "Not enough segments, resetting. Gcode:" + cmd.gcode);
           }
-          return 0;
-        }
 
+        }
+        waiting_for_arc_ = false;
+        current_arc_.clear();
       }
-      else
+      else if (waiting_for_arc_)
       {
-        if (debug_logging_enabled_)
+
+        if (current_arc_.is_shape())
+        {
+          // update our statistics
+          points_compressed_ += current_arc_.get_num_segments() - 1;
+          arcs_created_++; // increment the number of generated arcs
+          write_arc_gcodes(is_end ? p_cur_pos->f : p_pre_pos->f);
+          // Now clear the arc and flag the processor as not waiting for an arc
+          waiting_for_arc_ = false;
+          current_arc_.clear();
+
+          // Reprocess this line
+          if (!is_end)
+          {
+            continue;
+          }
+          else
+          {
+            if (debug_logging_enabled_)
+            {
+              p_logger_->log(logger_type_, log_levels::DEBUG, "Final arc created, exiting.");
+            }
+            return 0;
+          }
+
+        }
+        else
         {
-          p_logger_->log(logger_type_, log_levels::DEBUG, "The current arc is not a valid arc, resetting.");
+          if (debug_logging_enabled_)
+          {
+            p_logger_->log(logger_type_, log_levels::DEBUG, "The current arc is not a valid arc, resetting.");
+          }
+          current_arc_.clear();
+          waiting_for_arc_ = false;
         }
-        current_arc_.clear();
-        waiting_for_arc_ = false;
       }
-    }
-    else if (debug_logging_enabled_)
-    {
-      p_logger_->log(logger_type_, log_levels::DEBUG, "Could not add point to arc from gcode:" + cmd.gcode);
-    }
+      else if (debug_logging_enabled_)
+      {
+        p_logger_->log(logger_type_, log_levels::DEBUG, "Could not add point to arc from gcode:" + cmd.gcode);
+      }
 
-  }
+    }
 
-  if (waiting_for_arc_ || !arc_added)
-  {
-    // This might not work....
-    //position* cur_pos = p_source_position_->get_current_position_ptr();
-    unwritten_commands_.push_back(unwritten_command(cmd, is_previous_extruder_relative, is_extrusion, is_retraction, is_travel, movement_length_mm));
+    if (waiting_for_arc_ || !arc_added)
+    {
+      // This might not work....
+      //position* cur_pos = p_source_position_->get_current_position_ptr();
+      printer_point start_point(p_pre_pos->get_gcode_x(), p_pre_pos->get_gcode_y(), p_pre_pos->get_gcode_z(), previous_extruder.get_offset_e(), previous_extruder.e_relative, p_pre_pos->f, 0, p_pre_pos->is_extruder_relative, p_pre_pos->is_relative);
+      printer_point end_point(p_cur_pos->get_gcode_x(), p_cur_pos->get_gcode_y(), p_cur_pos->get_gcode_z(), extruder_current.get_offset_e(), extruder_current.e_relative, p_cur_pos->f, movement_length_mm, p_pre_pos->is_extruder_relative, p_cur_pos->is_relative);
+      unwritten_commands_.push_back(unwritten_command(cmd, is_previous_extruder_relative, is_extrusion, is_retraction, is_travel, is_z_unchanged, is_f_unchanged, movement_length_mm, start_point, end_point, p_cur_pos->feature_type_tag));
 
+    }
+    else if (!waiting_for_arc_)
+    {
+      write_unwritten_gcodes_to_file();
+      current_arc_.clear();
+    }
+    return lines_written;
   }
-  else if (!waiting_for_arc_)
-  {
-    write_unwritten_gcodes_to_file();
-    current_arc_.clear();
-  }
-  return lines_written;
 }
 
 void arc_welder::write_arc_gcodes(double current_feedrate)
 {
 
-  std::string comment = get_comment_for_arc();
   // remove the same number of unwritten gcodes as there are arc segments, minus 1 for the start point
   // Which isn't a movement
   // note, skip the first point, it is the starting point
   int num_segments = current_arc_.get_num_segments() - 1;
-  for (int index = 0; index < num_segments; index++)
-  {
-    while (!unwritten_commands_.pop_back().is_g0_g1);
-  }
-
-  // Undo the current command, since it isn't included in the arc
-  p_source_position_->undo_update();
+  std::string comment = get_comment_for_arc(get_shape_start_index(num_segments), unwritten_commands_.count());
+  remove_shape_moves(num_segments);
 
   // Set the current feedrate if it is different, else set to 0 to indicate that no feedrate should be included
   if (previous_feedrate_ > 0 && previous_feedrate_ == current_feedrate) {
     current_feedrate = 0;
   }
 
-  // Craete the arc gcode
-  std::string gcode = get_arc_gcode(comment);
-
+  // Write everything that hasn't yet been written	
+  write_unwritten_gcodes_to_file();
+
+  write_current_arc_gcode(comment);
+  restore_trailing_commands();
+}
+
+void arc_welder::write_current_arc_gcode(const std::string& comment)
+{
+  // Craete the arc gcode
+  gcode_buffer_.clear();
+  append_arc_gcode(comment, gcode_buffer_);
+  const std::string& gcode = gcode_buffer_;
+
   if (debug_logging_enabled_)
   {
     char buffer[20];
@@ -845,38 +1225,319 @@ void arc_welder::write_arc_gcodes(double current_feedrate)
     p_logger_->log(logger_type_, log_levels::DEBUG, message);
   }
 
-  // Write everything that hasn't yet been written	
+  if (current_arc_.is_precision_reduced())
+  {
+    num_precision_reductions_++;
+  }
+  // Update the current extrusion statistics for the current arc gcode
+  update_shape_statistics(current_arc_);
+  // now write the current arc to the file 
+  write_gcode_to_file(gcode);
+}
+
+void arc_welder::write_bezier_gcodes()
+{
+  // remove the same number of unwritten gcodes as there are curve segments, just like write_arc_gcodes
+  int num_segments = current_bezier_.get_num_segments() - 1;
+  std::string comment = get_comment_for_arc(get_shape_start_index(num_segments), unwritten_commands_.count());
+  remove_shape_moves(num_segments);
   write_unwritten_gcodes_to_file();
 
-  // Update the current extrusion statistics for the current arc gcode
-  double shape_e_relative = current_arc_.get_shape_e_relative();
+  gcode_buffer_.clear();
+  current_bezier_.append_shape_gcode(gcode_buffer_);
+  if (compact_output_ || strip_comments_)
+  {
+    int compact_length = static_cast<int>(gcode_buffer_.length());
+    add_shape_bytes_saved(current_bezier_.get_standard_shape_gcode_length(), compact_length, comment);
+  }
+  if (comment.length() > 0 && !strip_comments_)
+  {
+    gcode_buffer_ += ';';
+    gcode_buffer_ += comment;
+  }
+  const std::string& gcode = gcode_buffer_;
+  if (debug_logging_enabled_)
+  {
+    char buffer[20];
+    std::string message = "Bezier curve created with ";
+    sprintf(buffer, "%d", current_bezier_.get_num_segments());
+    message += buffer;
+    message += " segments: ";
+    message += gcode;
+    p_logger_->log(logger_type_, log_levels::DEBUG, message);
+  }
+  update_shape_statistics(current_bezier_);
+  write_gcode_to_file(gcode);
+  restore_trailing_commands();
+}
+
+void arc_welder::update_shape_statistics(segmented_shape& shape)
+{
+  double shape_e_relative = shape.get_shape_e_relative();
   bool is_retraction = shape_e_relative < 0;
   bool is_extrusion = shape_e_relative > 0;
   if (is_extrusion)
   {
-    segment_statistics_.update(current_arc_.get_shape_length(), false);
+    segment_statistics_.update(shape.get_shape_length(), false);
 
   }
   else if (is_retraction)
   {
-      segment_retraction_statistics_.update(current_arc_.get_shape_length(), false);
+      segment_retraction_statistics_.update(shape.get_shape_length(), false);
   }
   else if (allow_travel_arcs_ ) {
-    travel_statistics_.update(current_arc_.get_shape_length(), false);
+    travel_statistics_.update(shape.get_shape_length(), false);
   }
-  // now write the current arc to the file 
-  write_gcode_to_file(gcode);
 }
 
-std::string arc_welder::get_comment_for_arc()
+bool arc_welder::try_build_lookahead_arc(int start_index, int refit_index, int end_index)
 {
-  // build a comment string from the commands making up the arc
-        // We need to start with the first command entered.
-  int comment_index = unwritten_commands_.count() - (current_arc_.get_num_segments() - 1);
+  // Rebuilds an arc chosen by write_lookahead_gcodes the same way it was built there.
+  int index;
+  if (refit_index < 0)
+  {
+    current_arc_.clear();
+    printer_point start_point = lookahead_points_[start_index];
+    start_point.distance = 0;
+    current_arc_.try_add_point(start_point);
+    index = start_index + 1;
+  }
+  else
+  {
+    if (!current_arc_.try_set_points(lookahead_points_, start_index, refit_index))
+    {
+      return false;
+    }
+    index = refit_index + 1;
+  }
+  for (; index <= end_index; index++)
+  {
+    if (!current_arc_.try_add_point(lookahead_points_[index]) || current_arc_.get_num_segments() != index - start_index + 1)
+    {
+      return false;
+    }
+  }
+  return current_arc_.is_shape();
+}
+
+static void update_lookahead_cost(std::vector<int>& best_commands, std::vector<int>& best_bytes, std::vector<int>& best_start, int start_index, int end_index, int command_bytes, bool minimize_bytes)
+{
+  int commands = best_commands[start_index] + 1;
+  int bytes = best_bytes[start_index] + command_bytes;
+  bool is_cheaper;
+  if (best_start[end_index] < 0)
+  {
+    is_cheaper = true;
+  }
+  else if (minimize_bytes)
+  {
+    is_cheaper = bytes < best_bytes[end_index] || (bytes == best_bytes[end_index] && commands < best_commands[end_index]);
+  }
+  else
+  {
+    is_cheaper = commands < best_commands[end_index] || (commands == best_commands[end_index] && bytes < best_bytes[end_index]);
+  }
+  if (is_cheaper)
+  {
+    best_commands[end_index] = commands;
+    best_bytes[end_index] = bytes;
+    best_start[end_index] = start_index;
+  }
+}
+
+void arc_welder::write_lookahead_gcodes(bool write_all)
+{
+  // Chooses which of the buffered points start and end arcs, minimizing the number of commands (or bytes) written.
+  // best_start[i] holds the point where the last command of the cheapest way to reach point i starts, which is i - 1
+  // when the original move is kept.  Arcs starting where the greedy welder would start one are grown exactly as it
+  // does.  Arcs from the other points start by checking the rest of the previous point's arc as a whole, and are then
+  // grown from there.  Either way every arc passes the usual resolution and path tolerance checks, and refit_index
+  // records how each was built so that it can be rebuilt when it is written.  Moving an arc's start only helps near
+  // the end of the greedy arc it falls in, so starts further than lookahead_window_ points from that end are skipped,
+  // which keeps long arcs from taking quadratic time.
+  int num_points = lookahead_points_.count();
+  if (num_points < 2)
+  {
+    if (write_all)
+    {
+      lookahead_points_.clear();
+    }
+    return;
+  }
+
+  // The length of the original move that ends at each point, including the newline.
+  std::vector<int> move_bytes(num_points, 0);
+  int move_index = 1;
+  for (int index = 0; index < unwritten_commands_.count() && move_index < num_points; index++)
+  {
+    if (unwritten_commands_[index].is_g0_g1)
+    {
+      move_bytes[move_index++] = static_cast<int>(unwritten_commands_[index].gcode.length()) + 1;
+    }
+  }
+
+  std::vector<int> best_commands(num_points, 0);
+  std::vector<int> best_bytes(num_points, 0);
+  std::vector<int> best_start(num_points, -1);
+  std::vector<int> refit_index(num_points, -1);
+  int greedy_start_index = 0;
+  int greedy_reach_index = 0;
+  // The last point where a command of the greedy welder is known to end
+  int greedy_end_index = 0;
+  int previous_reach_index = -1;
+  for (int start_index = 0; start_index < num_points - 1; start_index++)
+  {
+    update_lookahead_cost(best_commands, best_bytes, best_start, start_index, start_index + 1, move_bytes[start_index + 1], lookahead_minimize_bytes_);
+    if (start_index != greedy_start_index && greedy_reach_index - start_index > lookahead_window_)
+    {
+      continue;
+    }
+
+    int reach_index = start_index;
+    if (
+      start_index != greedy_start_index &&
+      previous_reach_index - start_index + 1 >= current_arc_.get_min_segments() &&
+      current_arc_.try_set_points(lookahead_points_, start_index, previous_reach_index)
+    )
+    {
+      refit_index[start_index] = previous_reach_index;
+      reach_index = previous_reach_index;
+      update_lookahead_cost(best_commands, best_bytes, best_start, start_index, reach_index, current_arc_.get_shape_gcode_length() + 1, lookahead_minimize_bytes_);
+    }
+    else
+    {
+      current_arc_.clear();
+      printer_point start_point = lookahead_points_[start_index];
+      // The start point is not part of the arc's length
+      start_point.distance = 0;
+      current_arc_.try_add_point(start_point);
+    }
+
+    for (int end_index = reach_index + 1; end_index < num_points; end_index++)
+    {
+      // Stop once the point is rejected, or if the arc had to drop its start point to accept it.
+      if (!current_arc_.try_add_point(lookahead_points_[end_index]) || current_arc_.get_num_segments() != end_index - start_index + 1)
+      {
+        break;
+      }
+      reach_index = end_index;
+      if (current_arc_.is_shape())
+      {
+        update_lookahead_cost(best_commands, best_bytes, best_start, start_index, end_index, current_arc_.get_shape_gcode_length() + 1, lookahead_minimize_bytes_);
+      }
+    }
+
+    previous_reach_index = current_arc_.is_shape() ? reach_index : -1;
+    if (start_index == greedy_start_index)
+    {
+      greedy_reach_index = reach_index;
+      greedy_start_index = current_arc_.is_shape() ? reach_index : start_index + 1;
+      // If the arc reached the end of the window, more points could still be added to it.
+      if (reach_index < num_points - 1)
+      {
+        greedy_end_index = greedy_start_index;
+      }
+      else
+      {
+        greedy_start_index = -1;
+      }
+    }
+  }
+  current_arc_.clear();
+
+  // Unless the run has ended, later points could still change the best commands near the end of the window.  Only
+  // write up to the last point where the greedy welder would end a command.  From there on, processing continues
+  // exactly like the greedy welder would, and the best commands up to that point are never worse than its commands.
+  int end_index = num_points - 1;
+  if (!write_all)
+  {
+    end_index = greedy_end_index;
+    if (end_index == 0)
+    {
+      // A single arc spans the window, wait for more points.
+      lookahead_limit_ = num_points + (num_points > lookahead_window_ ? num_points : lookahead_window_);
+      return;
+    }
+  }
+
+  std::vector<int> breakpoints;
+  for (int index = end_index; index > 0; index = best_start[index])
+  {
+    breakpoints.push_back(index);
+  }
+
+  int start_index = 0;
+  // Consecutive line commands are written together so that they can be simplified together.
+  int num_line_commands = 0;
+  for (int breakpoint_index = static_cast<int>(breakpoints.size()) - 1; breakpoint_index >= 0; breakpoint_index--)
+  {
+    int next_index = breakpoints[breakpoint_index];
+    int num_moves = next_index - start_index;
+    // Find the unwritten commands holding the moves.  Blank lines before the first move are kept.
+    int first_move = num_line_commands;
+    while (!unwritten_commands_[first_move].is_g0_g1)
+    {
+      first_move++;
+    }
+    int command_count = first_move + 1;
+    for (int moves_found = 1; moves_found < num_moves; command_count++)
+    {
+      if (unwritten_commands_[command_count].is_g0_g1)
+      {
+        moves_found++;
+      }
+    }
+
+    if (num_moves > 1 && try_build_lookahead_arc(start_index, refit_index[start_index], next_index))
+    {
+      write_unwritten_gcodes_to_file(first_move);
+      command_count -= first_move;
+      std::string comment = get_comment_for_arc(0, command_count);
+      for (int index = 0; index < command_count; index++)
+      {
+        unwritten_commands_.pop_front();
+      }
+      points_compressed_ += current_arc_.get_num_segments() - 1;
+      arcs_created_++;
+      write_current_arc_gcode(comment);
+      num_line_commands = 0;
+    }
+    else
+    {
+      num_line_commands = command_count;
+    }
+    current_arc_.clear();
+    start_index = next_index;
+  }
+  write_unwritten_gcodes_to_file(num_line_commands);
+
+  if (write_all)
+  {
+    lookahead_points_.clear();
+    return;
+  }
+  // The last written point starts the rest of the window.
+  for (int index = 0; index < end_index; index++)
+  {
+    lookahead_points_.pop_front();
+  }
+  int num_remaining = lookahead_points_.count();
+  lookahead_limit_ = num_remaining + (num_remaining > lookahead_window_ ? num_remaining : lookahead_window_);
+}
+
+std::string arc_welder::get_comment_for_arc(int start_index, int end_index)
+{
+  // build a comment string from the unwritten commands making up the arc
+  // We need to start with the first command entered.
+  // Lines carried across the arc keep their own comments.
   std::string comment;
-  for (; comment_index < unwritten_commands_.count(); comment_index++)
+  for (int comment_index = start_index; comment_index < end_index; comment_index++)
   {
-    std::string old_comment = unwritten_commands_[comment_index].comment;
+    if (!unwritten_commands_[comment_index].is_shape_move())
+    {
+      continue;
+    }
+    const std::string& old_comment = unwritten_commands_[comment_index].comment;
     if (old_comment != comment && old_comment.length() > 0)
     {
       if (comment.length() > 0)
@@ -889,6 +1550,114 @@ std::string arc_welder::get_comment_for_arc()
   return comment;
 }
 
+int arc_welder::get_shape_start_index(int num_moves)
+{
+  // Finds the first of the last num_moves moves in the unwritten commands.
+  int start_index = unwritten_commands_.count();
+  while (num_moves > 0 && start_index > 0)
+  {
+    if (unwritten_commands_[--start_index].is_shape_move())
+    {
+      num_moves--;
+    }
+  }
+  return start_index;
+}
+
+void arc_welder::remove_shape_moves(int num_moves)
+{
+  // Removes the last num_moves moves, which are replaced by a shape.  The lines carried between the moves are put back,
+  // so that they are written just before the shape.  The lines carried after the last move are kept aside until
+  // restore_trailing_commands is called, so that they stay after the shape.  Blank lines are dropped.
+  carried_commands_.clear();
+  trailing_commands_.clear();
+  while (unwritten_commands_.count() > 0 && !unwritten_commands_[unwritten_commands_.count() - 1].is_shape_move())
+  {
+    unwritten_command& command = unwritten_commands_.pop_back();
+    if (command.gcode.length() > 0 || command.comment.length() > 0)
+    {
+      trailing_commands_.push_back(std::move(command));
+    }
+  }
+  while (num_moves > 0)
+  {
+    unwritten_command& command = unwritten_commands_.pop_back();
+    if (command.is_shape_move())
+    {
+      num_moves--;
+    }
+    else if (command.gcode.length() > 0 || command.comment.length() > 0)
+    {
+      carried_commands_.push_back(std::move(command));
+    }
+  }
+  for (std::vector<unwritten_command>::reverse_iterator it = carried_commands_.rbegin(); it != carried_commands_.rend(); ++it)
+  {
+    unwritten_commands_.push_back(std::move(*it));
+  }
+}
+
+void arc_welder::restore_trailing_commands()
+{
+  // Puts back the lines that were carried after the last move of the shape that was just written.
+  for (std::vector<unwritten_command>::reverse_iterator it = trailing_commands_.rbegin(); it != trailing_commands_.rend(); ++it)
+  {
+    unwritten_commands_.push_back(std::move(*it));
+  }
+  trailing_commands_.clear();
+}
+
+bool arc_welder::is_carried_line(const parsed_command& cmd) const
+{
+  // Comment-only lines, and commands that only show or report progress, don't change the printer's state.  Layer change
+  // comments are not carried, since scripts and hosts act on them, and they must stay after the last move of a layer.
+  // Feature comments aren't carried either, since they describe the moves that follow them.
+  if (cmd.is_empty)
+  {
+    return cmd.comment.length() > 0 && !is_layer_change_comment(cmd.comment) && !is_feature_comment(cmd.comment);
+  }
+  return cmd.command == "M73" || cmd.command == "M117" || cmd.command == "M118";
+}
+
+bool arc_welder::is_layer_change_comment(const std::string& comment)
+{
+  // Cura and ideaMaker write ';LAYER:<n>', PrusaSlicer writes ';LAYER_CHANGE' and Simplify3D writes '; layer <n>, Z = <z>'.
+  size_t start = comment.find_first_not_of(' ');
+  if (start == std::string::npos || comment.length() - start < 5)
+  {
+    return false;
+  }
+  for (int index = 0; index < 5; index++)
+  {
+    if (std::tolower(static_cast<unsigned char>(comment[start + index])) != "layer"[index])
+    {
+      return false;
+    }
+  }
+  return comment.length() == start + 5 || comment[start + 5] == ':' || comment[start + 5] == ' ' || comment[start + 5] == '_';
+}
+
+bool arc_welder::is_feature_comment(const std::string& comment)
+{
+  // Cura, ideaMaker and PrusaSlicer write ';TYPE:<feature>', PrusaSlicer also writes ';WIDTH:<w>' and ';HEIGHT:<h>' when
+  // the extrusion changes, Cura writes ';MESH:<name>' and Simplify3D writes '; feature <feature>'.  A marker for the
+  // same feature still starts a new extrusion, so the feature type tag alone can't be trusted to end the shape.
+  static const std::string prefixes[] = { "TYPE:", "WIDTH:", "HEIGHT:", "MESH:", "feature " };
+  size_t start = comment.find_first_not_of(' ');
+  if (start == std::string::npos)
+  {
+    return false;
+  }
+  for (size_t index = 0; index < sizeof(prefixes) / sizeof(prefixes[0]); index++)
+  {
+    if (comment.compare(start, prefixes[index].length(), prefixes[index]) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
 std::string arc_welder::create_g92_e(double absolute_e)
 {
   std::stringstream stream;
@@ -897,21 +1666,157 @@ std::string arc_welder::create_g92_e(double absolute_e)
   return stream.str();
 }
 
-int arc_welder::write_gcode_to_file(std::string gcode)
+int arc_welder::write_gcode_to_file(const std::string& gcode)
 {
+  if (line_numbers_)
+  {
+    numbered_buffer_.clear();
+    line_number_encoder_.append_numbered_line(gcode, numbered_buffer_);
+    write_encoded_to_target(numbered_buffer_);
+    return 1;
+  }
+  if (is_bgcode_)
+  {
+    packed_buffer_.clear();
+    bgcode_writer_.append_gcode(gcode, packed_buffer_);
+    bgcode_writer_.append_gcode("\n", 1, packed_buffer_);
+    output_file_ << packed_buffer_;
+    return 1;
+  }
+  if (meatpack_output_)
+  {
+    packed_buffer_.clear();
+    meatpack_encoder_.append_packed(gcode, packed_buffer_);
+    meatpack_encoder_.append_packed("\n", 1, packed_buffer_);
+    output_file_ << packed_buffer_;
+    return 1;
+  }
   output_file_ << gcode << "\n";
   return 1;
 }
 
+void arc_welder::write_to_target(const std::string& text)
+{
+  if (line_numbers_)
+  {
+    numbered_buffer_.clear();
+    line_number_encoder_.append_numbered(text, numbered_buffer_);
+    write_encoded_to_target(numbered_buffer_);
+    return;
+  }
+  write_encoded_to_target(text);
+}
+
+void arc_welder::write_encoded_to_target(const std::string& text)
+{
+  if (is_bgcode_)
+  {
+    packed_buffer_.clear();
+    bgcode_writer_.append_gcode(text, packed_buffer_);
+    output_file_ << packed_buffer_;
+    return;
+  }
+  if (meatpack_output_)
+  {
+    packed_buffer_.clear();
+    meatpack_encoder_.append_packed(text, packed_buffer_);
+    output_file_ << packed_buffer_;
+    return;
+  }
+  output_file_ << text;
+}
+
+bool arc_welder::start_bgcode(std::istream& source)
+{
+  // Copy the metadata and thumbnail blocks, which come first, and load the first gcode block.  The gcode blocks that
+  // are written are encoded and compressed the same way as the first one that was read.
+  bgcode_gcode_.clear();
+  bgcode_gcode_position_ = 0;
+  if (!bgcode_reader_.read_file_header(source))
+  {
+    return false;
+  }
+  packed_buffer_.clear();
+  bgcode_writer_.set_checksum_type(bgcode_reader_.get_checksum_type());
+  bgcode_writer_.append_file_header(packed_buffer_);
+  while (bgcode_reader_.read_block(source, bgcode_block_))
+  {
+    if (bgcode_block_.type == bgcode_block_gcode)
+    {
+      bgcode_writer_.set_gcode_format(bgcode_block_.compression, bgcode_block_.get_encoding());
+      output_file_ << packed_buffer_;
+      return bgcode_reader_.append_gcode(bgcode_block_, bgcode_gcode_);
+    }
+    bgcode_writer_.append_block(bgcode_block_, packed_buffer_);
+  }
+  output_file_ << packed_buffer_;
+  return bgcode_reader_.get_error().empty();
+}
+
+bool arc_welder::read_source_line(std::istream& source, std::string& line)
+{
+  if (!is_bgcode_)
+  {
+    return static_cast<bool>(std::getline(source, line));
+  }
+  while (true)
+  {
+    size_t end = bgcode_gcode_.find('\n', bgcode_gcode_position_);
+    if (end != std::string::npos)
+    {
+      line.assign(bgcode_gcode_, bgcode_gcode_position_, end - bgcode_gcode_position_);
+      bgcode_gcode_position_ = end + 1;
+      return true;
+    }
+    // Keep the start of a line that continues in the next block
+    bgcode_gcode_.erase(0, bgcode_gcode_position_);
+    bgcode_gcode_position_ = 0;
+    if (!bgcode_reader_.read_block(source, bgcode_block_))
+    {
+      if (bgcode_gcode_.length() == 0 || !bgcode_reader_.get_error().empty())
+      {
+        return false;
+      }
+      line = bgcode_gcode_;
+      bgcode_gcode_.clear();
+      return true;
+    }
+    if (bgcode_block_.type != bgcode_block_gcode)
+    {
+      packed_buffer_.clear();
+      bgcode_writer_.append_block(bgcode_block_, packed_buffer_);
+      output_file_ << packed_buffer_;
+    }
+    else if (!bgcode_reader_.append_gcode(bgcode_block_, bgcode_gcode_))
+    {
+      return false;
+    }
+  }
+}
+
 int arc_welder::write_unwritten_gcodes_to_file()
 {
-  int size = unwritten_commands_.count();
-  std::string lines_to_write;
+  return write_unwritten_gcodes_to_file(unwritten_commands_.count());
+}
+
+int arc_welder::write_unwritten_gcodes_to_file(int size)
+{
+  lines_to_write_.clear();
 
   for (int index = 0; index < size; index++)
   {
+    if (simplify_polylines_)
+    {
+      int polyline_length = get_polyline_length(size - index);
+      if (polyline_length > 1)
+      {
+        append_simplified_polyline(polyline_length, lines_to_write_);
+        index += polyline_length - 1;
+        continue;
+      }
+    }
     // The the current unwritten position and remove it from the list
-    unwritten_command p = unwritten_commands_.pop_front();
+    unwritten_command& p = unwritten_commands_.pop_front();
     if ((p.is_g0_g1 || p.is_g2_g3) && p.length > 0)
     {
 
@@ -927,26 +1832,312 @@ int arc_welder::write_unwritten_gcodes_to_file()
         travel_statistics_.update(p.length, false);
       }
     }
-    lines_to_write.append(p.to_string()).append("\n");
+    append_unwritten_command(p, lines_to_write_);
   }
 
-  output_file_ << lines_to_write;
+  write_to_target(lines_to_write_);
   return size;
 }
 
-std::string arc_welder::get_arc_gcode(const std::string comment)
+int arc_welder::get_polyline_length(int max_count)
+{
+  // Count the unwritten commands, starting with the first, that extrude along a single polyline at the same height,
+  // feedrate and extrusion rate.
+  const unwritten_command& first = unwritten_commands_[0];
+  if (!is_polyline_move(first))
+  {
+    return 0;
+  }
+  double first_extrusion_rate = first.end_point.e_relative / first.length;
+  int count = 1;
+  for (; count < max_count; count++)
+  {
+    const unwritten_command& command = unwritten_commands_[count];
+    if (
+      !is_polyline_move(command) ||
+      command.end_point.z != first.end_point.z ||
+      command.end_point.f != first.end_point.f ||
+      command.is_extruder_relative != first.is_extruder_relative ||
+      command.feature_type_tag != first.feature_type_tag ||
+      (
+        extrusion_rate_variance_percent_ != 0 &&
+        utilities::greater_than(utilities::abs(utilities::get_percent_change(first_extrusion_rate, command.end_point.e_relative / command.length)), extrusion_rate_variance_percent_)
+      )
+    )
+    {
+      break;
+    }
+  }
+  return count;
+}
+
+void arc_welder::append_simplified_polyline(int count, std::string& lines_to_write)
+{
+  // Simplify the polyline with the Douglas-Peucker algorithm.  Starting with a segment from the first to the last
+  // point, keep the point furthest from each segment, splitting it in two, until every point is within the resolution.
+  std::vector<point> points;
+  points.reserve(count + 1);
+  points.push_back(unwritten_commands_[0].start_point);
+  for (int index = 0; index < count; index++)
+  {
+    points.push_back(unwritten_commands_[index].end_point);
+  }
+  std::vector<bool> keep_point(count + 1, false);
+  keep_point[0] = true;
+  keep_point[count] = true;
+  std::vector<std::pair<int, int> > segments_to_check;
+  segments_to_check.push_back(std::make_pair(0, count));
+  int feature_type_tag = unwritten_commands_[0].feature_type_tag;
+  if (feature_type_tag < 0 || feature_type_tag >= NUM_FEATURE_TYPES)
+  {
+    feature_type_tag = feature_type_unknown_feature;
+  }
+  double tolerance = feature_tolerances_[feature_type_tag].resolution_mm / 2.0;
+  while (!segments_to_check.empty())
+  {
+    std::pair<int, int> segment_to_check = segments_to_check.back();
+    segments_to_check.pop_back();
+    int furthest_index = -1;
+    double max_distance = tolerance;
+    for (int index = segment_to_check.first + 1; index < segment_to_check.second; index++)
+    {
+      double distance = segment::get_distance(points[segment_to_check.first], points[segment_to_check.second], points[index]);
+      if (distance > max_distance)
+      {
+        max_distance = distance;
+        furthest_index = index;
+      }
+    }
+    if (furthest_index != -1)
+    {
+      keep_point[furthest_index] = true;
+      segments_to_check.push_back(std::make_pair(segment_to_check.first, furthest_index));
+      segments_to_check.push_back(std::make_pair(furthest_index, segment_to_check.second));
+    }
+  }
+
+  // Each new segment extrudes as much as the segments it replaces, so the E value at every kept point is unchanged.
+  const unwritten_command& first = unwritten_commands_[0];
+  bool has_f = first.start_point.f != first.end_point.f;
+  for (int index = 1, previous_index = 0; index <= count; index++)
+  {
+    if (!keep_point[index])
+    {
+      continue;
+    }
+    if (index == previous_index + 1)
+    {
+      // Nothing was removed, write the original command
+      unwritten_command& command = unwritten_commands_[previous_index];
+      segment_statistics_.update(command.length, false);
+      append_unwritten_command(command, lines_to_write);
+      previous_index = index;
+      continue;
+    }
+    const printer_point& end_point = unwritten_commands_[index - 1].end_point;
+    double e = end_point.e_offset;
+    if (end_point.is_extruder_relative)
+    {
+      e = 0;
+      for (int command_index = previous_index; command_index < index; command_index++)
+      {
+        e += unwritten_commands_[command_index].end_point.e_relative;
+      }
+    }
+    lines_to_write += "G1";
+    append_polyline_parameter(lines_to_write, 'X', end_point.x, current_arc_.get_xyz_precision());
+    append_polyline_parameter(lines_to_write, 'Y', end_point.y, current_arc_.get_xyz_precision());
+    append_polyline_parameter(lines_to_write, 'E', e, current_arc_.get_e_precision());
+    if (has_f && previous_index == 0)
+    {
+      append_polyline_parameter(lines_to_write, 'F', end_point.f, 0);
+    }
+    lines_to_write += '\n';
+    segment_statistics_.update(
+      utilities::get_cartesian_distance(points[previous_index].x, points[previous_index].y, end_point.x, end_point.y), false
+    );
+    points_simplified_ += index - previous_index - 1;
+    previous_index = index;
+  }
+  for (int index = 0; index < count; index++)
+  {
+    unwritten_commands_.pop_front();
+  }
+}
+
+void arc_welder::set_feature_type(int feature_type_tag)
 {
-  // Write gcode to file
-  std::string gcode;
+  if (feature_type_tag < 0 || feature_type_tag >= NUM_FEATURE_TYPES)
+  {
+    feature_type_tag = feature_type_unknown_feature;
+  }
+  const feature_tolerance& tolerance = feature_tolerances_[feature_type_tag];
+  current_arc_.set_resolution_mm(tolerance.resolution_mm);
+  current_arc_.set_path_tolerance_percent(tolerance.path_tolerance_percent);
+  current_arc_.set_max_radius(tolerance.max_radius_mm);
+  current_bezier_.set_resolution_mm(tolerance.resolution_mm);
+  current_bezier_.set_path_tolerance_percent(tolerance.path_tolerance_percent);
+}
 
-  gcode = current_arc_.get_shape_gcode();
+void arc_welder::append_arc_gcode(const std::string& comment, std::string& gcode)
+{
+  size_t start_length = gcode.length();
+  current_arc_.append_shape_gcode(gcode);
+  if (compact_output_ || strip_comments_)
+  {
+    add_shape_bytes_saved(current_arc_.get_standard_shape_gcode_length(), static_cast<int>(gcode.length() - start_length), comment);
+  }
+
+  if (comment.length() > 0 && !strip_comments_)
+  {
+    gcode += ';';
+    gcode += comment;
+  }
+}
+
+void arc_welder::add_shape_bytes_saved(int standard_length, int compact_length, const std::string& comment)
+{
+  bytes_saved_ += standard_length - compact_length;
+  if (strip_comments_ && comment.length() > 0)
+  {
+    // The comment and its semicolon
+    bytes_saved_ += static_cast<long>(comment.length()) + 1;
+  }
+}
+
+static bool is_gcode_whitespace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Writes a compacted copy of a G0-G3 command, leaving out the F or Z parameters if they would not change anything.
+// Returns false if the command isn't in the usual "<word><value> <word><value>" form, in which case nothing is written.
+static bool append_compact_motion_gcode(const std::string& gcode, bool drop_z, bool drop_f, std::string& lines)
+{
+  if (gcode.find('*') != std::string::npos)
+  {
+    // Changing a line with a checksum would invalidate it.
+    return false;
+  }
+  size_t start_length = lines.length();
+  char value[GCODE_CHAR_BUFFER_SIZE];
+  int words_written = 0;
+  int words_dropped = 0;
+  size_t index = 0;
+  while (index < gcode.length())
+  {
+    if (is_gcode_whitespace(gcode[index]))
+    {
+      index++;
+      continue;
+    }
+    size_t end = index;
+    while (end < gcode.length() && !is_gcode_whitespace(gcode[end]))
+    {
+      end++;
+    }
+    char word = static_cast<char>(std::toupper(static_cast<unsigned char>(gcode[index])));
+    int value_length = static_cast<int>(end - index - 1);
+    if (word < 'A' || word > 'Z' || value_length >= GCODE_CHAR_BUFFER_SIZE)
+    {
+      lines.resize(start_length);
+      return false;
+    }
+    if ((word == 'Z' && drop_z) || (word == 'F' && drop_f))
+    {
+      words_dropped++;
+      index = end;
+      continue;
+    }
+    if (words_written++ > 0)
+    {
+      lines += ' ';
+    }
+    lines += gcode[index];
+    switch (word)
+    {
+    case 'X':
+    case 'Y':
+    case 'Z':
+    case 'E':
+    case 'F':
+    case 'I':
+    case 'J':
+    case 'R':
+      gcode.copy(value, value_length, index + 1);
+      lines.append(value, utilities::compact_number(value, value_length));
+      break;
+    default:
+      lines.append(gcode, index + 1, value_length);
+      break;
+    }
+    index = end;
+  }
+  // Only the command is left, so the line does nothing
+  if (words_dropped > 0 && words_written == 1)
+  {
+    lines.resize(start_length);
+  }
+  return true;
+}
 
-  if (comment.length() > 0)
+void arc_welder::append_unwritten_command(const unwritten_command& command, std::string& lines)
+{
+  if (!compact_output_ && !strip_comments_)
+  {
+    command.append_to(lines);
+    lines += '\n';
+    return;
+  }
+  size_t start_length = lines.length();
+  if (
+    !compact_output_ ||
+    !(command.is_g0_g1 || command.is_g2_g3) ||
+    !append_compact_motion_gcode(command.gcode, command.is_z_unchanged, command.is_f_unchanged, lines)
+  )
   {
-    gcode += ";" + comment;
+    size_t first = 0;
+    size_t last = command.gcode.length();
+    while (first < last && is_gcode_whitespace(command.gcode[first]))
+    {
+      first++;
+    }
+    while (last > first && is_gcode_whitespace(command.gcode[last - 1]))
+    {
+      last--;
+    }
+    lines.append(command.gcode, first, last - first);
   }
-  return gcode;
+  if (command.comment.length() > 0 && !strip_comments_)
+  {
+    lines += ';';
+    lines += command.comment;
+  }
+  long standard_length = static_cast<long>(command.gcode.length()) + 1;
+  if (command.comment.length() > 0)
+  {
+    standard_length += static_cast<long>(command.comment.length()) + 1;
+  }
+  // Lines that are left empty are removed
+  if (lines.length() > start_length)
+  {
+    lines += '\n';
+  }
+  bytes_saved_ += standard_length - static_cast<long>(lines.length() - start_length);
+}
 
+void arc_welder::append_polyline_parameter(std::string& gcode, char word, double value, unsigned char precision)
+{
+  if (!compact_output_)
+  {
+    utilities::append_parameter(gcode, word, value, precision);
+    return;
+  }
+  char buffer[FPCONV_BUFFER_LENGTH];
+  int standard_length = utilities::dtos(value, precision, buffer);
+  size_t start_length = gcode.length();
+  utilities::append_compact_parameter(gcode, word, value, precision);
+  bytes_saved_ += standard_length + 2 - static_cast<long>(gcode.length() - start_length);
 }
 
 void arc_welder::add_arcwelder_comment_to_target()
@@ -960,6 +2151,19 @@ void arc_welder::add_arcwelder_comment_to_target()
   stream << "; resolution=" << std::setprecision(2) << resolution_mm_ << "mm\n";
   stream << "; path_tolerance=" << std::setprecision(1) << (current_arc_.get_path_tolerance_percent() * 100.0) << "%\n";
   stream << "; max_radius=" << std::setprecision(2) << (current_arc_.get_max_radius()) << "mm\n";
+  for (int feature_type = 0; feature_type < NUM_FEATURE_TYPES; feature_type++)
+  {
+    const feature_tolerance& tolerance = feature_tolerances_[feature_type];
+    if (
+      tolerance.resolution_mm != resolution_mm_ ||
+      tolerance.path_tolerance_percent != current_arc_.get_path_tolerance_percent() ||
+      tolerance.max_radius_mm != current_arc_.get_max_radius()
+    )
+    {
+      stream << "; " << feature_type_name[feature_type] << "_tolerance=" << std::setprecision(3) << tolerance.resolution_mm << "mm,";
+      stream << std::setprecision(1) << tolerance.path_tolerance_percent * 100.0 << "%," << std::setprecision(2) << tolerance.max_radius_mm << "mm\n";
+    }
+  }
   if (gcode_position_args_.g90_influences_extruder)
   {
     stream << "; g90_influences_extruder=True\n";
@@ -979,12 +2183,48 @@ void arc_welder::add_arcwelder_comment_to_target()
   {
     stream << "; allow_dynamic_precision=True\n";
   }
+  if (allow_bezier_curves_)
+  {
+    stream << "; allow_bezier_curves=True\n";
+  }
+  if (simplify_polylines_)
+  {
+    stream << "; simplify_polylines=True\n";
+  }
+  if (merge_arcs_)
+  {
+    stream << "; merge_arcs=True\n";
+  }
+  if (weld_through_comments_)
+  {
+    stream << "; weld_through_comments=True\n";
+  }
+  if (current_arc_.get_max_gcode_length() > 0 && current_arc_.get_reduce_precision_to_fit())
+  {
+    stream << "; reduce_precision_to_fit=True\n";
+  }
+  if (lookahead_window_ > 0)
+  {
+    stream << "; lookahead_window=" << std::setprecision(0) << lookahead_window_ << "\n";
+    if (lookahead_minimize_bytes_)
+    {
+      stream << "; lookahead_minimize_bytes=True\n";
+    }
+  }
+  if (compact_output_)
+  {
+    stream << "; compact_output=True\n";
+  }
+  if (strip_comments_)
+  {
+    stream << "; strip_comments=True\n";
+  }
   stream << "; default_xyz_precision=" << std::setprecision(0) << static_cast<int>(current_arc_.get_xyz_precision()) << "\n";
   stream << "; default_e_precision=" << std::setprecision(0) << static_cast<int>(current_arc_.get_e_precision()) << "\n";
   stream << "; extrusion_rate_variance_percent=" << std::setprecision(1) << (extrusion_rate_variance_percent_ * 100.0) << "%\n\n";
 
 
-  output_file_ << stream.str();
+  write_to_target(stream.str());
 }
 
 
@@ -31,11 +31,16 @@
 #include "position.h"
 #include "gcode_parser.h"
 #include "segmented_arc.h"
+#include "segmented_bezier.h"
 #include <iostream>
 #include <fstream>
 #include "array_list.h"
 #include "unwritten_command.h"
 #include "logger.h"
+#include "meatpack.h"
+#include "bgcode.h"
+#include "line_numbers.h"
+#include "compressed_file.h"
 #include <cmath>
 #include <iomanip>
 #include <sstream>
@@ -463,6 +468,11 @@ struct arc_welder_progress {
 		arcs_aborted_by_flow_rate = 0;
 		num_firmware_compensations = 0;
 		num_gcode_length_exceptions = 0;
+		num_prefilter_rejects = 0;
+		beziers_created = 0;
+		points_simplified = 0;
+		num_precision_reductions = 0;
+		bytes_saved = 0;
 		source_file_size = 0;
 		source_file_position = 0;
 		target_file_size = 0;
@@ -481,6 +491,11 @@ struct arc_welder_progress {
 	int arcs_aborted_by_flow_rate;
 	int num_firmware_compensations;
 	int num_gcode_length_exceptions;
+	int num_prefilter_rejects;
+	int beziers_created;
+	int points_simplified;
+	int num_precision_reductions;
+	long bytes_saved;
 	double compression_ratio;
 	double compression_percent;
 	long source_file_position;
@@ -522,6 +537,11 @@ struct arc_welder_progress {
 		stream << ", arcs_aborted_by_flowrate: " << arcs_aborted_by_flow_rate;
 		stream << ", num_firmware_compensations: " << num_firmware_compensations;
 		stream << ", num_gcode_length_exceptions: " << num_gcode_length_exceptions;
+		stream << ", num_prefilter_rejects: " << num_prefilter_rejects;
+		stream << ", beziers_created: " << beziers_created;
+		stream << ", points_simplified: " << points_simplified;
+		stream << ", num_precision_reductions: " << num_precision_reductions;
+		stream << ", bytes_saved: " << bytes_saved;
 		stream << ", compression_ratio: " << compression_ratio;
 		stream << ", size_reduction: " << compression_percent << "% " ;
 		return stream.str();
@@ -564,8 +584,48 @@ typedef bool(*progress_callback)(arc_welder_progress, logger* p_logger, int logg
 #define DEFAULT_G90_G91_INFLUENCES_EXTRUDER false
 #define DEFAULT_ALLOW_DYNAMIC_PRECISION false
 #define DEFAULT_ALLOW_TRAVEL_ARCS false
+#define DEFAULT_ALLOW_BEZIER_CURVES false
+#define DEFAULT_SIMPLIFY_POLYLINES false
+#define DEFAULT_MERGE_ARCS false
+#define DEFAULT_WELD_THROUGH_COMMENTS false
 #define DEFAULT_EXTRUSION_RATE_VARIANCE_PERCENT 0.05
 #define DEFAULT_NOTIFICATION_PERIOD_SECONDS 0.5
+#define DEFAULT_LOOKAHEAD_WINDOW 0 // the number of points to buffer before choosing arcs ( < 1 = disabled)
+#define DEFAULT_LOOKAHEAD_MINIMIZE_BYTES false
+#define DEFAULT_COMPACT_OUTPUT false
+#define DEFAULT_STRIP_COMMENTS false
+#define DEFAULT_MEATPACK_OUTPUT false
+#define DEFAULT_MEATPACK_NO_SPACES false
+#define DEFAULT_LINE_NUMBERS false
+
+// Overrides the resolution, path tolerance and maximum radius for a single feature type (see gcode_comment_processor.h).
+// Negative values are not overridden.
+struct feature_tolerance
+{
+	feature_tolerance() : resolution_mm(-1), path_tolerance_percent(-1), max_radius_mm(-1) {}
+	feature_tolerance(double resolution, double path_tolerance, double max_radius) :
+		resolution_mm(resolution), path_tolerance_percent(path_tolerance), max_radius_mm(max_radius) {}
+	double resolution_mm;
+	double path_tolerance_percent;
+	double max_radius_mm;
+	bool is_set() const
+	{
+		return resolution_mm >= 0 || path_tolerance_percent >= 0 || max_radius_mm >= 0;
+	}
+	// Returns the feature type with the given name, with or without the '_feature' suffix, or -1 if there is none.
+	static int get_feature_type(const std::string& name)
+	{
+		for (int feature_type = 0; feature_type < NUM_FEATURE_TYPES; feature_type++)
+		{
+			const std::string& feature_name = feature_type_name[feature_type];
+			if (name == feature_name || name + "_feature" == feature_name)
+			{
+				return feature_type;
+			}
+		}
+		return -1;
+	}
+};
 
 struct arc_welder_args
 {
@@ -593,11 +653,24 @@ struct arc_welder_args
 		bool allow_3d_arcs;
 		bool allow_travel_arcs;
 		bool allow_dynamic_precision;
+		bool allow_bezier_curves;
+		bool simplify_polylines;
+		bool merge_arcs;
+		bool weld_through_comments;
 		unsigned char default_xyz_precision;
 		unsigned char default_e_precision;
 		double extrusion_rate_variance_percent;
 		int buffer_size;
 		int max_gcode_length;
+		bool reduce_precision_to_fit;
+		int lookahead_window;
+		bool lookahead_minimize_bytes;
+		bool compact_output;
+		bool strip_comments;
+		bool meatpack_output;
+		bool meatpack_no_spaces;
+		bool line_numbers;
+		feature_tolerance feature_tolerances[NUM_FEATURE_TYPES];
 		double notification_period_seconds;
 		utilities::box_drawing::BoxEncodingEnum box_encoding;
 		
@@ -629,6 +702,10 @@ struct arc_welder_args
 			stream << "\tAllow 3D Arcs                : " << (allow_3d_arcs ? "True" : "False") << "\n";
 			stream << "\tAllow Travel Arcs            : " << (allow_travel_arcs ? "True" : "False") << "\n";
 			stream << "\tAllow Dynamic Precision      : " << (allow_dynamic_precision ? "True" : "False") << "\n";
+			stream << "\tAllow Bezier Curves (G5)     : " << (allow_bezier_curves ? "True" : "False") << "\n";
+			stream << "\tSimplify Polylines           : " << (simplify_polylines ? "True" : "False") << "\n";
+			stream << "\tMerge Existing Arcs          : " << (merge_arcs ? "True" : "False") << "\n";
+			stream << "\tWeld Through Comments        : " << (weld_through_comments ? "True" : "False") << "\n";
 			stream << "\tDefault XYZ Precision        : " << std::setprecision(0) << static_cast<int>(default_xyz_precision) << "\n";
 			stream << "\tDefault E Precision          : " << std::setprecision(0) << static_cast<int>(default_e_precision) << "\n";
 			stream << "\tExtrusion Rate Variance %    : " << std::setprecision(3) << extrusion_rate_variance_percent * 100.0 << "%\n";
@@ -639,6 +716,47 @@ struct arc_welder_args
 			}
 			else {
 				stream << "\tMax Gcode Length             : " << std::setprecision(0) << max_gcode_length << " characters\n";
+				stream << "\tReduce Precision To Fit      : " << (reduce_precision_to_fit ? "True" : "False") << "\n";
+			}
+			if (lookahead_window < 1)
+			{
+				stream << "\tLookahead Window             : Disabled\n";
+			}
+			else {
+				stream << "\tLookahead Window             : " << std::setprecision(0) << lookahead_window << " points\n";
+				stream << "\tLookahead Minimizes          : " << (lookahead_minimize_bytes ? "Bytes" : "Commands") << "\n";
+			}
+			stream << "\tCompact Output               : " << (compact_output ? "True" : "False") << "\n";
+			stream << "\tStrip Comments               : " << (strip_comments ? "True" : "False") << "\n";
+			if (!meatpack_output)
+			{
+				stream << "\tMeatPack Output              : Disabled\n";
+			}
+			else {
+				stream << "\tMeatPack Output              : " << (meatpack_no_spaces ? "Enabled, No Spaces" : "Enabled") << "\n";
+			}
+			stream << "\tLine Numbers                 : " << (line_numbers ? "True" : "False") << "\n";
+			for (int feature_type = 0; feature_type < NUM_FEATURE_TYPES; feature_type++)
+			{
+				const feature_tolerance& tolerance = feature_tolerances[feature_type];
+				if (!tolerance.is_set())
+				{
+					continue;
+				}
+				stream << "\tFeature Tolerance            : " << feature_type_name[feature_type] << " -";
+				if (tolerance.resolution_mm >= 0)
+				{
+					stream << " Resolution: " << std::setprecision(3) << tolerance.resolution_mm << "mm";
+				}
+				if (tolerance.path_tolerance_percent >= 0)
+				{
+					stream << " Path Tolerance: " << std::setprecision(3) << tolerance.path_tolerance_percent * 100.0 << "%";
+				}
+				if (tolerance.max_radius_mm >= 0)
+				{
+					stream << " Maximum Arc Radius: " << std::setprecision(0) << tolerance.max_radius_mm << "mm";
+				}
+				stream << "\n";
 			}
 			stream << "\tLog Level                    : " << log_level_name << "\n";
 			stream << "\tHide Progress Updates        : " << (callback == NULL ? "True" : "False") << "\n";
@@ -661,14 +779,30 @@ private:
 			allow_3d_arcs = DEFAULT_ALLOW_3D_ARCS,
 			allow_travel_arcs = DEFAULT_ALLOW_TRAVEL_ARCS,
 			allow_dynamic_precision = DEFAULT_ALLOW_DYNAMIC_PRECISION,
+			allow_bezier_curves = DEFAULT_ALLOW_BEZIER_CURVES,
+			simplify_polylines = DEFAULT_SIMPLIFY_POLYLINES,
+			merge_arcs = DEFAULT_MERGE_ARCS,
+			weld_through_comments = DEFAULT_WELD_THROUGH_COMMENTS,
 			default_xyz_precision = DEFAULT_XYZ_PRECISION,
 			default_e_precision = DEFAULT_E_PRECISION,
 			extrusion_rate_variance_percent = DEFAULT_EXTRUSION_RATE_VARIANCE_PERCENT,
 			max_gcode_length = DEFAULT_MAX_GCODE_LENGTH,
+			reduce_precision_to_fit = DEFAULT_REDUCE_PRECISION_TO_FIT,
+			lookahead_window = DEFAULT_LOOKAHEAD_WINDOW,
+			lookahead_minimize_bytes = DEFAULT_LOOKAHEAD_MINIMIZE_BYTES,
+			compact_output = DEFAULT_COMPACT_OUTPUT,
+			strip_comments = DEFAULT_STRIP_COMMENTS,
+			meatpack_output = DEFAULT_MEATPACK_OUTPUT,
+			meatpack_no_spaces = DEFAULT_MEATPACK_NO_SPACES,
+			line_numbers = DEFAULT_LINE_NUMBERS,
 			buffer_size = DEFAULT_GCODE_BUFFER_SIZE,
 			notification_period_seconds = DEFAULT_NOTIFICATION_PERIOD_SECONDS,
 			callback = NULL;
 			box_encoding = utilities::box_drawing::BoxEncodingEnum::ASCII;
+			for (int feature_type = 0; feature_type < NUM_FEATURE_TYPES; feature_type++)
+			{
+				feature_tolerances[feature_type] = feature_tolerance();
+			}
 	}
 
 };
@@ -706,26 +840,59 @@ private:
 	void reset();
 	static gcode_position_args get_args_(bool g90_g91_influences_extruder, int buffer_size);
 	progress_callback progress_callback_;
-	int process_gcode(parsed_command cmd, bool is_end, bool is_reprocess);
+	int process_gcode(parsed_command& cmd, bool is_end);
 	void write_arc_gcodes(double current_feedrate);
-	int write_gcode_to_file(std::string gcode);
-	std::string get_arc_gcode(const std::string comment);
-	std::string get_comment_for_arc();
+	void write_current_arc_gcode(const std::string& comment);
+	void write_bezier_gcodes();
+	void update_shape_statistics(segmented_shape& shape);
+	void write_lookahead_gcodes(bool write_all);
+	bool try_build_lookahead_arc(int start_index, int refit_index, int end_index);
+	int write_gcode_to_file(const std::string& gcode);
+	void write_to_target(const std::string& text);
+	void write_encoded_to_target(const std::string& text);
+	bool start_bgcode(std::istream& source);
+	bool read_source_line(std::istream& source, std::string& line);
+	void append_arc_gcode(const std::string& comment, std::string& gcode);
+	void append_unwritten_command(const unwritten_command& command, std::string& lines);
+	void append_polyline_parameter(std::string& gcode, char word, double value, unsigned char precision);
+	void add_shape_bytes_saved(int standard_length, int compact_length, const std::string& comment);
+	std::string get_comment_for_arc(int start_index, int end_index);
+	int get_shape_start_index(int num_moves);
+	void remove_shape_moves(int num_moves);
+	void restore_trailing_commands();
+	bool is_carried_line(const parsed_command& cmd) const;
+	static bool is_layer_change_comment(const std::string& comment);
+	static bool is_feature_comment(const std::string& comment);
 	int write_unwritten_gcodes_to_file();
+	int write_unwritten_gcodes_to_file(int count);
+	int get_polyline_length(int max_count);
+	void append_simplified_polyline(int count, std::string& lines_to_write);
+	void set_feature_type(int feature_type_tag);
 	std::string create_g92_e(double absolute_e);
 	std::string source_path_;
 	std::string target_path_;
 	double resolution_mm_;
+	// The tolerances used for each feature type, with any missing values filled in from the defaults.
+	feature_tolerance feature_tolerances_[NUM_FEATURE_TYPES];
 	gcode_position_args gcode_position_args_;
 	bool allow_dynamic_precision_;
 	bool allow_3d_arcs_;
 	bool allow_travel_arcs_;
+	bool allow_bezier_curves_;
+	bool simplify_polylines_;
+	// Existing G2/G3 moves that follow the same circle are combined into one arc.
+	bool merge_arcs_;
+	// Comment-only lines and motion-neutral commands don't end the current shape, and are written just before it.
+	bool weld_through_comments_;
 	long file_size_;
 	int lines_processed_;
 	int gcodes_processed_;
 	int last_gcode_line_written_;
 	int points_compressed_;
 	int arcs_created_;
+	int beziers_created_;
+	int points_simplified_;
+	int num_precision_reductions_;
 	int arcs_aborted_by_flow_rate_;
 	double notification_period_seconds_;
 	source_target_segment_statistics segment_statistics_;
@@ -737,7 +904,43 @@ private:
 	bool waiting_for_arc_;
 	array_list<unwritten_command> unwritten_commands_;
 	segmented_arc current_arc_;
-	std::ofstream output_file_;
+	// Fit alongside current_arc_ when bezier curves are allowed.  Whichever shape covers more points is written.
+	segmented_bezier current_bezier_;
+	// The points of the current run when the lookahead window is enabled.  The first point is the start of the run.
+	printer_point_list lookahead_points_;
+	int lookahead_window_;
+	int lookahead_limit_;
+	bool lookahead_minimize_bytes_;
+	// Drop redundant characters from the output and, optionally, all comments.
+	bool compact_output_;
+	bool strip_comments_;
+	long bytes_saved_;
+	// Marlin keeps a separate feedrate for G0, so F can only be dropped when the motion command didn't change.
+	bool previous_motion_was_g0_;
+	compressed_ofstream output_file_;
+	// Packs everything written to the target file when MeatPack output is enabled.
+	bool meatpack_output_;
+	meatpack_encoder meatpack_encoder_;
+	// Holds packed or binary output until it is written to the target file.
+	std::string packed_buffer_;
+	// Numbers every line and adds a checksum, before any packing or binary encoding.
+	bool line_numbers_;
+	line_number_encoder line_number_encoder_;
+	std::string numbered_buffer_;
+	// Binary gcode is read and written a block at a time, and the target has the same format as the source.
+	bool is_bgcode_;
+	bgcode_reader bgcode_reader_;
+	bgcode_writer bgcode_writer_;
+	bgcode_block bgcode_block_;
+	// The text of the current source gcode block, and the start of the next line in it.
+	std::string bgcode_gcode_;
+	size_t bgcode_gcode_position_;
+	// Reused for every line that is written so that formatting the output doesn't allocate.
+	std::string gcode_buffer_;
+	// The lines carried between and after the moves of the shape that is being written.
+	std::vector<unwritten_command> carried_commands_;
+	std::vector<unwritten_command> trailing_commands_;
+	std::string lines_to_write_;
 
 	// We don't care about the printer settings, except for g91 influences extruder.
 	gcode_position* p_source_position_;
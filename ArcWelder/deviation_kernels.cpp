@@ -0,0 +1,359 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Arc Welder: Anti-Stutter Library
+//
+// Compresses many G0/G1 commands into G2/G3(arc) commands where possible, ensuring the tool paths stay within the specified resolution.
+// This reduces file size and the number of gcodes per second.
+//
+// Uses the 'Gcode Processor Library' for gcode parsing, position processing, logging, and other various functionality.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address: 
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "deviation_kernels.h"
+#include "segmented_shape.h"
+#include "utilities.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+// SSE2 is part of x86-64, AVX2 is detected at runtime.
+#define DEVIATION_KERNELS_X86_64
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define DEVIATION_KERNELS_TARGET_AVX2
+#else
+#define DEVIATION_KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace deviation_kernels
+{
+	typedef bool(*deviation_kernel)(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation);
+
+#pragma region Scalar Kernels
+	static bool try_get_max_point_deviation_scalar(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation)
+	{
+		for (int index = 0; index < count; index++)
+		{
+			double deviation = utilities::abs(utilities::get_cartesian_distance(x[index], y[index], center_x, center_y) - radius);
+			if (deviation > resolution_mm)
+			{
+				return false;
+			}
+			if (deviation > max_deviation)
+			{
+				max_deviation = deviation;
+			}
+		}
+		return true;
+	}
+
+	static bool try_get_max_segment_deviation_scalar(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation)
+	{
+		point center(center_x, center_y, 0);
+		point point_to_test;
+		for (int index = 0; index < count - 1; index++)
+		{
+			if (segment::get_closest_perpendicular_point(point(x[index], y[index], 0), point(x[index + 1], y[index + 1], 0), center, point_to_test))
+			{
+				double deviation = utilities::abs(utilities::get_cartesian_distance(point_to_test.x, point_to_test.y, center_x, center_y) - radius);
+				if (deviation > resolution_mm)
+				{
+					return false;
+				}
+				if (deviation > max_deviation)
+				{
+					max_deviation = deviation;
+				}
+			}
+		}
+		return true;
+	}
+#pragma endregion Scalar Kernels
+
+#ifdef DEVIATION_KERNELS_X86_64
+	// Note:  _mm_max_pd(a, b) returns b if a is NaN, so the deviation is always the first operand.  A NaN deviation
+	// is then ignored, exactly as it is by the scalar comparisons.
+#pragma region SSE2 Kernels
+	static bool try_get_max_point_deviation_sse2(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation)
+	{
+		const __m128d sign_mask = _mm_set1_pd(-0.0);
+		const __m128d c_x = _mm_set1_pd(center_x);
+		const __m128d c_y = _mm_set1_pd(center_y);
+		const __m128d r = _mm_set1_pd(radius);
+		const __m128d resolution = _mm_set1_pd(resolution_mm);
+		__m128d max = _mm_set1_pd(max_deviation);
+		int index = 0;
+		for (; index + 2 <= count; index += 2)
+		{
+			__m128d x_dif = _mm_sub_pd(_mm_loadu_pd(x + index), c_x);
+			__m128d y_dif = _mm_sub_pd(_mm_loadu_pd(y + index), c_y);
+			__m128d distance = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(x_dif, x_dif), _mm_mul_pd(y_dif, y_dif)));
+			__m128d deviation = _mm_andnot_pd(sign_mask, _mm_sub_pd(distance, r));
+			if (_mm_movemask_pd(_mm_cmpgt_pd(deviation, resolution)) != 0)
+			{
+				return false;
+			}
+			max = _mm_max_pd(deviation, max);
+		}
+		double lanes[2];
+		_mm_storeu_pd(lanes, max);
+		max_deviation = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+		return try_get_max_point_deviation_scalar(x + index, y + index, count - index, center_x, center_y, radius, resolution_mm, max_deviation);
+	}
+
+	static bool try_get_max_segment_deviation_sse2(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation)
+	{
+		const __m128d sign_mask = _mm_set1_pd(-0.0);
+		const __m128d zero = _mm_setzero_pd();
+		const __m128d one = _mm_set1_pd(1.0);
+		const __m128d zero_tolerance = _mm_set1_pd(ZERO_TOLERANCE);
+		const __m128d c_x = _mm_set1_pd(center_x);
+		const __m128d c_y = _mm_set1_pd(center_y);
+		const __m128d r = _mm_set1_pd(radius);
+		const __m128d resolution = _mm_set1_pd(resolution_mm);
+		__m128d max = _mm_set1_pd(max_deviation);
+		int index = 0;
+		// Each iteration tests the segments starting at index and index + 1
+		for (; index + 3 <= count; index += 2)
+		{
+			__m128d x1 = _mm_loadu_pd(x + index);
+			__m128d y1 = _mm_loadu_pd(y + index);
+			__m128d x_dif = _mm_sub_pd(_mm_loadu_pd(x + index + 1), x1);
+			__m128d y_dif = _mm_sub_pd(_mm_loadu_pd(y + index + 1), y1);
+			__m128d num = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(c_x, x1), x_dif), _mm_mul_pd(_mm_sub_pd(c_y, y1), y_dif));
+			__m128d denom = _mm_add_pd(_mm_mul_pd(x_dif, x_dif), _mm_mul_pd(y_dif, y_dif));
+			__m128d t = _mm_div_pd(num, denom);
+			// There is no perpendicular point if t <= 0 or t >= 1 (within ZERO_TOLERANCE)
+			__m128d no_point = _mm_or_pd(
+				_mm_or_pd(_mm_cmplt_pd(t, zero), _mm_cmplt_pd(_mm_andnot_pd(sign_mask, t), zero_tolerance)),
+				_mm_or_pd(_mm_cmpgt_pd(t, one), _mm_cmplt_pd(_mm_andnot_pd(sign_mask, _mm_sub_pd(t, one)), zero_tolerance))
+			);
+			__m128d point_x_dif = _mm_sub_pd(_mm_add_pd(x1, _mm_mul_pd(t, x_dif)), c_x);
+			__m128d point_y_dif = _mm_sub_pd(_mm_add_pd(y1, _mm_mul_pd(t, y_dif)), c_y);
+			__m128d distance = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(point_x_dif, point_x_dif), _mm_mul_pd(point_y_dif, point_y_dif)));
+			__m128d deviation = _mm_andnot_pd(no_point, _mm_andnot_pd(sign_mask, _mm_sub_pd(distance, r)));
+			if (_mm_movemask_pd(_mm_cmpgt_pd(deviation, resolution)) != 0)
+			{
+				return false;
+			}
+			max = _mm_max_pd(deviation, max);
+		}
+		double lanes[2];
+		_mm_storeu_pd(lanes, max);
+		max_deviation = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+		return try_get_max_segment_deviation_scalar(x + index, y + index, count - index, center_x, center_y, radius, resolution_mm, max_deviation);
+	}
+#pragma endregion SSE2 Kernels
+
+#pragma region AVX2 Kernels
+	DEVIATION_KERNELS_TARGET_AVX2
+	static bool try_get_max_point_deviation_avx2(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation)
+	{
+		const __m256d sign_mask = _mm256_set1_pd(-0.0);
+		const __m256d c_x = _mm256_set1_pd(center_x);
+		const __m256d c_y = _mm256_set1_pd(center_y);
+		const __m256d r = _mm256_set1_pd(radius);
+		const __m256d resolution = _mm256_set1_pd(resolution_mm);
+		__m256d max = _mm256_set1_pd(max_deviation);
+		int index = 0;
+		for (; index + 4 <= count; index += 4)
+		{
+			__m256d x_dif = _mm256_sub_pd(_mm256_loadu_pd(x + index), c_x);
+			__m256d y_dif = _mm256_sub_pd(_mm256_loadu_pd(y + index), c_y);
+			__m256d distance = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(x_dif, x_dif), _mm256_mul_pd(y_dif, y_dif)));
+			__m256d deviation = _mm256_andnot_pd(sign_mask, _mm256_sub_pd(distance, r));
+			if (_mm256_movemask_pd(_mm256_cmp_pd(deviation, resolution, _CMP_GT_OQ)) != 0)
+			{
+				return false;
+			}
+			max = _mm256_max_pd(deviation, max);
+		}
+		double lanes[4];
+		_mm256_storeu_pd(lanes, max);
+		max_deviation = lanes[0];
+		for (int lane = 1; lane < 4; lane++)
+		{
+			if (lanes[lane] > max_deviation)
+			{
+				max_deviation = lanes[lane];
+			}
+		}
+		return try_get_max_point_deviation_scalar(x + index, y + index, count - index, center_x, center_y, radius, resolution_mm, max_deviation);
+	}
+
+	DEVIATION_KERNELS_TARGET_AVX2
+	static bool try_get_max_segment_deviation_avx2(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation)
+	{
+		const __m256d sign_mask = _mm256_set1_pd(-0.0);
+		const __m256d zero = _mm256_setzero_pd();
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d zero_tolerance = _mm256_set1_pd(ZERO_TOLERANCE);
+		const __m256d c_x = _mm256_set1_pd(center_x);
+		const __m256d c_y = _mm256_set1_pd(center_y);
+		const __m256d r = _mm256_set1_pd(radius);
+		const __m256d resolution = _mm256_set1_pd(resolution_mm);
+		__m256d max = _mm256_set1_pd(max_deviation);
+		int index = 0;
+		// Each iteration tests the four segments starting at index through index + 3
+		for (; index + 5 <= count; index += 4)
+		{
+			__m256d x1 = _mm256_loadu_pd(x + index);
+			__m256d y1 = _mm256_loadu_pd(y + index);
+			__m256d x_dif = _mm256_sub_pd(_mm256_loadu_pd(x + index + 1), x1);
+			__m256d y_dif = _mm256_sub_pd(_mm256_loadu_pd(y + index + 1), y1);
+			__m256d num = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(c_x, x1), x_dif), _mm256_mul_pd(_mm256_sub_pd(c_y, y1), y_dif));
+			__m256d denom = _mm256_add_pd(_mm256_mul_pd(x_dif, x_dif), _mm256_mul_pd(y_dif, y_dif));
+			__m256d t = _mm256_div_pd(num, denom);
+			// There is no perpendicular point if t <= 0 or t >= 1 (within ZERO_TOLERANCE)
+			__m256d no_point = _mm256_or_pd(
+				_mm256_or_pd(_mm256_cmp_pd(t, zero, _CMP_LT_OQ), _mm256_cmp_pd(_mm256_andnot_pd(sign_mask, t), zero_tolerance, _CMP_LT_OQ)),
+				_mm256_or_pd(_mm256_cmp_pd(t, one, _CMP_GT_OQ), _mm256_cmp_pd(_mm256_andnot_pd(sign_mask, _mm256_sub_pd(t, one)), zero_tolerance, _CMP_LT_OQ))
+			);
+			__m256d point_x_dif = _mm256_sub_pd(_mm256_add_pd(x1, _mm256_mul_pd(t, x_dif)), c_x);
+			__m256d point_y_dif = _mm256_sub_pd(_mm256_add_pd(y1, _mm256_mul_pd(t, y_dif)), c_y);
+			__m256d distance = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(point_x_dif, point_x_dif), _mm256_mul_pd(point_y_dif, point_y_dif)));
+			__m256d deviation = _mm256_andnot_pd(no_point, _mm256_andnot_pd(sign_mask, _mm256_sub_pd(distance, r)));
+			if (_mm256_movemask_pd(_mm256_cmp_pd(deviation, resolution, _CMP_GT_OQ)) != 0)
+			{
+				return false;
+			}
+			max = _mm256_max_pd(deviation, max);
+		}
+		double lanes[4];
+		_mm256_storeu_pd(lanes, max);
+		max_deviation = lanes[0];
+		for (int lane = 1; lane < 4; lane++)
+		{
+			if (lanes[lane] > max_deviation)
+			{
+				max_deviation = lanes[lane];
+			}
+		}
+		return try_get_max_segment_deviation_scalar(x + index, y + index, count - index, center_x, center_y, radius, resolution_mm, max_deviation);
+	}
+#pragma endregion AVX2 Kernels
+
+	static bool cpu_supports_avx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(info, 1);
+		// The OS must save the AVX registers (OSXSAVE and XCR0), and the CPU must support AVX
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+#endif
+
+	struct kernel_set
+	{
+		deviation_instruction_set instruction_set;
+		deviation_kernel point_kernel;
+		deviation_kernel segment_kernel;
+	};
+
+	static kernel_set get_kernel_set(deviation_instruction_set instruction_set)
+	{
+		kernel_set kernels;
+		kernels.instruction_set = instruction_set;
+		switch (instruction_set)
+		{
+#ifdef DEVIATION_KERNELS_X86_64
+		case deviation_instruction_set_avx2:
+			kernels.point_kernel = try_get_max_point_deviation_avx2;
+			kernels.segment_kernel = try_get_max_segment_deviation_avx2;
+			break;
+		case deviation_instruction_set_sse2:
+			kernels.point_kernel = try_get_max_point_deviation_sse2;
+			kernels.segment_kernel = try_get_max_segment_deviation_sse2;
+			break;
+#endif
+		default:
+			kernels.instruction_set = deviation_instruction_set_scalar;
+			kernels.point_kernel = try_get_max_point_deviation_scalar;
+			kernels.segment_kernel = try_get_max_segment_deviation_scalar;
+			break;
+		}
+		return kernels;
+	}
+
+	deviation_instruction_set get_supported_instruction_set()
+	{
+#ifdef DEVIATION_KERNELS_X86_64
+		static const deviation_instruction_set supported = cpu_supports_avx2() ? deviation_instruction_set_avx2 : deviation_instruction_set_sse2;
+		return supported;
+#else
+		return deviation_instruction_set_scalar;
+#endif
+	}
+
+	static kernel_set& get_current_kernel_set()
+	{
+		static kernel_set current = get_kernel_set(get_supported_instruction_set());
+		return current;
+	}
+
+	deviation_instruction_set get_instruction_set()
+	{
+		return get_current_kernel_set().instruction_set;
+	}
+
+	bool set_instruction_set(deviation_instruction_set instruction_set)
+	{
+		if (instruction_set > get_supported_instruction_set())
+		{
+			return false;
+		}
+		get_current_kernel_set() = get_kernel_set(instruction_set);
+		return true;
+	}
+
+	const char* get_instruction_set_name(deviation_instruction_set instruction_set)
+	{
+		switch (instruction_set)
+		{
+		case deviation_instruction_set_avx2:
+			return "AVX2";
+		case deviation_instruction_set_sse2:
+			return "SSE2";
+		default:
+			return "scalar";
+		}
+	}
+
+	bool try_get_max_point_deviation(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation)
+	{
+		return get_current_kernel_set().point_kernel(x, y, count, center_x, center_y, radius, resolution_mm, max_deviation);
+	}
+
+	bool try_get_max_segment_deviation(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation)
+	{
+		return get_current_kernel_set().segment_kernel(x, y, count, center_x, center_y, radius, resolution_mm, max_deviation);
+	}
+}
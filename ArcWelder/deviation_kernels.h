@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Arc Welder: Anti-Stutter Library
+//
+// Compresses many G0/G1 commands into G2/G3(arc) commands where possible, ensuring the tool paths stay within the specified resolution.
+// This reduces file size and the number of gcodes per second.
+//
+// Uses the 'Gcode Processor Library' for gcode parsing, position processing, logging, and other various functionality.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address: 
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+// Deviation checks for circle validation.  These are the hot loops of arc welding, so they are vectorized with AVX2 or
+// SSE2 when the CPU supports it, with a scalar fallback everywhere else.  Every implementation performs the same
+// floating point operations in the same order as the scalar code, so pass/fail and the deviations are identical as long
+// as the compiler doesn't fuse the scalar multiplies and adds.  GCC and Clang do that by default for FMA targets
+// (-march=native, for example), so the CMake build compiles the scalar code with -ffp-contract=off.
+enum deviation_instruction_set { deviation_instruction_set_scalar = 0, deviation_instruction_set_sse2 = 1, deviation_instruction_set_avx2 = 2 };
+
+namespace deviation_kernels
+{
+	// Returns false if any of the count points is over resolution_mm from the circle.  Otherwise returns true, and
+	// raises max_deviation to the largest deviation found.
+	bool try_get_max_point_deviation(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation);
+
+	// The same as above, but for the point perpendicular from each of the count - 1 segments between consecutive points
+	// to the center, if any such point exists (see segment::get_closest_perpendicular_point).
+	bool try_get_max_segment_deviation(const double* x, const double* y, int count, double center_x, double center_y, double radius, double resolution_mm, double& max_deviation);
+
+	// The best instruction set supported by this CPU, which is used by default
+	deviation_instruction_set get_supported_instruction_set();
+	deviation_instruction_set get_instruction_set();
+	// Overrides the instruction set, for testing and benchmarking.  Returns false if the CPU doesn't support it.
+	bool set_instruction_set(deviation_instruction_set instruction_set);
+	const char* get_instruction_set_name(deviation_instruction_set instruction_set);
+}
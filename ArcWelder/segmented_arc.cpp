@@ -29,6 +29,8 @@
 #include <iostream>
 #include <stdio.h>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 segmented_arc::segmented_arc() : segmented_shape(DEFAULT_MIN_SEGMENTS, DEFAULT_MAX_SEGMENTS, DEFAULT_RESOLUTION_MM, ARC_LENGTH_PERCENT_TOLERANCE_DEFAULT)
 {
@@ -38,8 +40,12 @@ segmented_arc::segmented_arc() : segmented_shape(DEFAULT_MIN_SEGMENTS, DEFAULT_M
   allow_3d_arcs_ = DEFAULT_ALLOW_3D_ARCS;
   max_gcode_length_ = DEFAULT_MAX_GCODE_LENGTH;
   num_gcode_length_exceptions_ = 0;
+  reduce_precision_to_fit_ = DEFAULT_REDUCE_PRECISION_TO_FIT;
+  arc_xyz_precision_ = 0;
+  arc_e_precision_ = 0;
   num_firmware_compensations_ = 0;
-  
+  num_prefilter_rejects_ = 0;
+  is_arc_span_ = false;
 }
 
 segmented_arc::segmented_arc(
@@ -53,7 +59,8 @@ segmented_arc::segmented_arc(
   bool allow_3d_arcs,
   unsigned char default_xyz_precision,
   unsigned char default_e_precision,
-  int max_gcode_length
+  int max_gcode_length,
+  bool reduce_precision_to_fit
 ) : segmented_shape(min_segments, max_segments, resolution_mm, path_tolerance_percent, default_xyz_precision, default_e_precision)
 {
   max_radius_mm_ = max_radius_mm;
@@ -76,19 +83,32 @@ segmented_arc::segmented_arc(
   {
     max_gcode_length_ = 0;
   }
+  reduce_precision_to_fit_ = reduce_precision_to_fit;
+  arc_xyz_precision_ = 0;
+  arc_e_precision_ = 0;
   num_firmware_compensations_ = 0;
   num_gcode_length_exceptions_ = 0;
-  
-
+  num_prefilter_rejects_ = 0;
+  is_arc_span_ = false;
 }
 
 segmented_arc::~segmented_arc()
 {
 }
 
+void segmented_arc::clear()
+{
+  segmented_shape::clear();
+  deviation_cache_.clear();
+  arc_xyz_precision_ = 0;
+  arc_e_precision_ = 0;
+  is_arc_span_ = false;
+}
+
 printer_point segmented_arc::pop_front(double e_relative)
 {
   e_relative_ -= e_relative;
+  deviation_cache_.clear();
   if (points_.count() == get_min_segments())
   {
     set_is_shape(false);
@@ -98,6 +118,7 @@ printer_point segmented_arc::pop_front(double e_relative)
 printer_point segmented_arc::pop_back(double e_relative)
 {
   e_relative_ -= e_relative;
+  deviation_cache_.clear();
   return points_.pop_back();
   if (points_.count() == get_min_segments())
   {
@@ -109,6 +130,14 @@ double segmented_arc::get_max_radius() const
   return max_radius_mm_;
 }
 
+void segmented_arc::set_max_radius(double max_radius_mm)
+{
+  max_radius_mm_ = max_radius_mm;
+  if (max_radius_mm > DEFAULT_MAX_RADIUS_MM) {
+    max_radius_mm_ = DEFAULT_MAX_RADIUS_MM;
+  }
+}
+
 int segmented_arc::get_min_arc_segments() const
 {
   return min_arc_segments_;
@@ -122,6 +151,30 @@ int segmented_arc::get_num_gcode_length_exceptions() const
 {
   return num_gcode_length_exceptions_;
 }
+int segmented_arc::get_num_prefilter_rejects() const
+{
+  return num_prefilter_rejects_;
+}
+int segmented_arc::get_max_gcode_length() const
+{
+  return max_gcode_length_;
+}
+bool segmented_arc::get_reduce_precision_to_fit() const
+{
+  return reduce_precision_to_fit_;
+}
+bool segmented_arc::is_precision_reduced() const
+{
+  return arc_xyz_precision_ > 0 || arc_e_precision_ > 0;
+}
+unsigned char segmented_arc::get_arc_xyz_precision() const
+{
+  return arc_xyz_precision_ > 0 ? arc_xyz_precision_ : get_xyz_precision();
+}
+unsigned char segmented_arc::get_arc_e_precision() const
+{
+  return arc_e_precision_ > 0 ? arc_e_precision_ : get_e_precision();
+}
 double segmented_arc::get_mm_per_arc_segment() const
 {
   return mm_per_arc_segment_;
@@ -131,6 +184,10 @@ bool segmented_arc::is_shape() const
 {
   return is_shape_;
 }
+bool segmented_arc::is_arc_span() const
+{
+  return is_arc_span_;
+}
 double segmented_arc::get_shape_length()
 {
   return current_arc_.length;
@@ -139,6 +196,11 @@ bool segmented_arc::try_add_point(printer_point p)
 {
 
   bool point_added = false;
+  if (is_arc_span_)
+  {
+    // The arc follows existing G2/G3 moves exactly, and a point can't be added to it.
+    return false;
+  }
   // if we don't have enough segnemts to check the shape, just add
     
   if (points_.count() == points_.get_max_size())
@@ -155,6 +217,12 @@ bool segmented_arc::try_add_point(printer_point p)
       return false;
     }
 
+    if (p1.is_xyz_relative != p.is_xyz_relative)
+    {
+      // The XYZ axis mode must be the same for every point in the arc
+      return false;
+    }
+
     // If we have more than 2 points, we need to make sure the current and previous moves are all of the same type.
     if (points_.count() > 2)
     {
@@ -206,6 +274,7 @@ bool segmented_arc::try_add_point(printer_point p)
     // If we haven't added a point, and we have exactly min_segments_,
     // pull off the initial arc point and try again
     points_.pop_front();
+    deviation_cache_.clear();
     // Get the new initial point
     printer_point new_initial_point = points_[0];
     // The length and e_relative distance of the arc has been reduced 
@@ -218,61 +287,113 @@ bool segmented_arc::try_add_point(printer_point p)
   return point_added;
 }
 
+bool segmented_arc::try_set_points(const printer_point_list& points, int start_index, int end_index)
+{
+  // Replaces the shape with points[start_index] through points[end_index], checking that they form an arc as a whole
+  // rather than one point at a time.  Neighboring points must already be compatible, for example by being part of
+  // another arc, since only the final point goes through the checks in try_add_point.
+  clear();
+  int num_points = end_index - start_index + 1;
+  if (num_points < get_min_segments())
+    return false;
+  if (points_.get_max_size() < num_points)
+  {
+    points_.resize(num_points * 2);
+  }
+  // The start point's distance and extrusion come before the shape, so they aren't included.
+  points_.push_back(points[start_index]);
+  for (int index = start_index + 1; index < end_index; index++)
+  {
+    printer_point p = points[index];
+    points_.push_back(p);
+    original_shape_length_ += p.distance;
+    e_relative_ += p.e_relative;
+  }
+  printer_point end_point = points[end_index];
+  if (!try_add_point_internal_(end_point))
+  {
+    clear();
+    return false;
+  }
+  e_relative_ += end_point.e_relative;
+  return true;
+}
+
+bool segmented_arc::can_point_be_on_arc_(const printer_point& p) const
+{
+  // A cheap test of the turn at the current end point.  It only rejects points that no circle could accept, so it never
+  // changes which arcs are created, it just skips building a circle and running the deviation checks for them.
+  int num_points = points_.count();
+  if (num_points < 2)
+    return true;
+
+  double ax = points_.get_x()[num_points - 2], ay = points_.get_y()[num_points - 2];
+  double bx = points_.get_x()[num_points - 1], by = points_.get_y()[num_points - 1];
+  double ux = bx - ax, uy = by - ay;
+  double vx = p.x - bx, vy = p.y - by;
+  double length_1 = utilities::sqrt(ux * ux + uy * uy);
+  double length_2 = utilities::sqrt(vx * vx + vy * vy);
+  if (length_1 == 0 || length_2 == 0)
+    return true;
+
+  // Every segment of an arc lies within resolution_mm_ of its circle, and the longest segment that fits inside that
+  // band is 4 * sqrt(radius * resolution_mm_) long, which gives us a minimum radius.
+  double resolution = resolution_mm_ + ARC_PREFILTER_MARGIN_MM;
+  double max_length = length_1 > length_2 ? length_1 : length_2;
+  double min_radius = (max_length * max_length) / (16.0 * resolution);
+  if (min_radius <= resolution)
+    return true;
+
+  // Both ends of a segment of length l are within the band, so the segment can lean away from the tangent at B by at
+  // most asin((4 * r * resolution + l^2) / (2 * l * (r - resolution))), which shrinks as r grows.
+  double max_lean_1 = (4.0 * min_radius * resolution + length_1 * length_1) / (2.0 * length_1 * (min_radius - resolution));
+  double max_lean_2 = (4.0 * min_radius * resolution + length_2 * length_2) / (2.0 * length_2 * (min_radius - resolution));
+  if (max_lean_1 >= 1.0 || max_lean_2 >= 1.0)
+    return true;
+  double max_turn = std::asin(max_lean_1) + std::asin(max_lean_2);
+  if (max_turn >= PI_DOUBLE / 2.0)
+    return true;
+
+  // Both segments are nearly tangent at B, so the path must either continue (a small turn) or double back.  Anything
+  // in between is a corner.
+  double turn = utilities::atan2(utilities::abs(ux * vy - uy * vx), ux * vx + uy * vy);
+  return turn <= max_turn || turn >= PI_DOUBLE - max_turn;
+}
+
 bool segmented_arc::try_add_point_internal_(printer_point p)
 {
   // If we don't have enough points (at least min_segments) return false
   if (points_.count() < get_min_segments() - 1)
     return false;
 
-  // the circle is new..  we have to test it now, which is expensive :(
+  if (!can_point_be_on_arc_(p))
+  {
+    num_prefilter_rejects_++;
+    return false;
+  }
+
+  // Note:  Points are tested one at a time on purpose, and there is no galloping (2, 4, 8... points) lookahead mode.
+  // Whether a prefix of the upcoming points fits is not monotone, since each prefix is tested against its own
+  // start/mid/end circle, so extending by 2, 4, 8... points and searching back could accept arcs that the per point
+  // test would have ended earlier.  Thanks to deviation_cache_, each test only has to check the new point and segment
+  // until the circle moves, so a long arc is still built in linear time.
   points_.push_back(p);
   double previous_shape_length = original_shape_length_;
   original_shape_length_ += p.distance;
   arc original_arc = current_arc_;
-  if (arc::try_create_arc(points_, current_arc_, original_shape_length_, max_radius_mm_, resolution_mm_, path_tolerance_percent_, min_arc_segments_, mm_per_arc_segment_, get_xyz_tolerance(), allow_3d_arcs_))
+  unsigned char original_xyz_precision = arc_xyz_precision_;
+  unsigned char original_e_precision = arc_e_precision_;
+  // Only keep the updated deviation cache if the point is added.
+  circle_deviation_cache deviation_cache = deviation_cache_;
+  if (arc::try_create_arc(points_, current_arc_, original_shape_length_, max_radius_mm_, resolution_mm_, path_tolerance_percent_, min_arc_segments_, mm_per_arc_segment_, get_xyz_tolerance(), allow_3d_arcs_, &deviation_cache, &least_squares_buffers_))
   {
-    bool abort_arc = false;
-    if (max_gcode_length_ > 0 && get_shape_gcode_length() > max_gcode_length_)
-    {
-      abort_arc = true;
-      num_gcode_length_exceptions_++;
-    }
-    if (min_arc_segments_ > 0 && mm_per_arc_segment_ > 0)
-    {
-      // Apply firmware compensation
-      // See how many arcs will be interpolated
-      double circumference = 2.0 * PI_DOUBLE * current_arc_.radius;
-      // TODO: Should this be ceil?
-      int num_segments = (int)utilities::floor(circumference / min_arc_segments_);
-      if (num_segments < min_arc_segments_) {
-        //num_segments = (int)std::ceil(circumference/approximate_length) * (int)std::ceil(approximate_length / mm_per_arc_segment);
-        // TODO: Should this be ceil?
-        num_segments = (int)utilities::floor(circumference / original_shape_length_);
-        if (num_segments < min_arc_segments_) {
-          abort_arc = true;
-          num_firmware_compensations_++; 
-        }
-      }
-    }
-    if (!abort_arc)
-    {
-      if (utilities::is_zero(current_arc_.get_i(), get_xyz_tolerance()) && utilities::is_zero(current_arc_.get_j(), get_xyz_tolerance()))
-      {
-        // I and J are both 0, which is invalid!  Abort!
-        abort_arc = true;
-      }
-      else if (current_arc_.length < get_xyz_tolerance())
-      {
-        // the arc length is below our tolerance, abort!
-        abort_arc = true;
-      }
-    }
-    
-    if (abort_arc)
+    if (!is_arc_within_limits_())
     {
       // This arc has been cancelled either due to firmware correction,
       // or because both I and J == 0
       current_arc_ = original_arc;
+      arc_xyz_precision_ = original_xyz_precision;
+      arc_e_precision_ = original_e_precision;
     }
     else
     {
@@ -280,6 +401,7 @@ bool segmented_arc::try_add_point_internal_(printer_point p)
       {
         set_is_shape(true);
       }
+      deviation_cache_ = deviation_cache;
       return true;
     }
   }
@@ -289,9 +411,197 @@ bool segmented_arc::try_add_point_internal_(printer_point p)
   return false;
 }
 
+bool segmented_arc::is_arc_within_limits_()
+{
+  // Checks current_arc_ against the gcode length and firmware compensation limits, lowering its precision to fit if
+  // that is allowed.
+  bool abort_arc = false;
+  arc_xyz_precision_ = 0;
+  arc_e_precision_ = 0;
+  if (max_gcode_length_ > 0 && get_shape_gcode_length() > max_gcode_length_)
+  {
+    if (!reduce_precision_to_fit_ || !try_reduce_precision_())
+    {
+      abort_arc = true;
+      num_gcode_length_exceptions_++;
+    }
+  }
+  if (min_arc_segments_ > 0 && mm_per_arc_segment_ > 0)
+  {
+    // Apply firmware compensation
+    // See how many arcs will be interpolated
+    double circumference = 2.0 * PI_DOUBLE * current_arc_.radius;
+    // TODO: Should this be ceil?
+    int num_segments = (int)utilities::floor(circumference / min_arc_segments_);
+    if (num_segments < min_arc_segments_) {
+      //num_segments = (int)std::ceil(circumference/approximate_length) * (int)std::ceil(approximate_length / mm_per_arc_segment);
+      // TODO: Should this be ceil?
+      num_segments = (int)utilities::floor(circumference / original_shape_length_);
+      if (num_segments < min_arc_segments_) {
+        abort_arc = true;
+        num_firmware_compensations_++; 
+      }
+    }
+  }
+  if (!abort_arc)
+  {
+    if (utilities::is_zero(current_arc_.get_i(), get_xyz_tolerance()) && utilities::is_zero(current_arc_.get_j(), get_xyz_tolerance()))
+    {
+      // I and J are both 0, which is invalid!  Abort!
+      abort_arc = true;
+    }
+    else if (current_arc_.length < get_xyz_tolerance())
+    {
+      // the arc length is below our tolerance, abort!
+      abort_arc = true;
+    }
+  }
+  return !abort_arc;
+}
+
+bool segmented_arc::try_add_arc_span(printer_point p, double i, double j, bool is_clockwise)
+{
+  if (points_.count() == 0 || (points_.count() > 1 && !is_arc_span_))
+  {
+    return false;
+  }
+  if (points_.count() == points_.get_max_size())
+  {
+    points_.resize(points_.get_max_size() * 2);
+  }
+  const printer_point start_point = points_[points_.count() - 1];
+  if (!utilities::is_equal(start_point.z, p.z) || start_point.is_xyz_relative != p.is_xyz_relative || utilities::is_zero(p.distance))
+  {
+    // Helical moves and changes of the XYZ axis mode aren't combined.
+    return false;
+  }
+  if (points_.count() == 1)
+  {
+    return try_start_arc_span_(p, i, j, is_clockwise);
+  }
+
+  // The start point holds the extrusion of the previous move, which must be of the same type.
+  bool is_compatible = (
+    (start_point.e_relative > 0 && p.e_relative > 0) ||
+    (start_point.e_relative < 0 && p.e_relative < 0) ||
+    (start_point.e_relative == 0 && p.e_relative == 0)
+  ) && (current_arc_.angle_radians < 0) == is_clockwise;
+  double radius = utilities::hypot(i, j);
+  double angle_radians = 0;
+  if (is_compatible && !utilities::is_zero(radius, get_xyz_tolerance()))
+  {
+    // The move will be drawn around the center of the first one.  Moving a circle's center by d and changing its radius
+    // by r moves every point on it by at most d + r, which must be within the resolution.
+    double center_offset = utilities::get_cartesian_distance(start_point.x + i, start_point.y + j, current_arc_.center.x, current_arc_.center.y);
+    double end_offset = utilities::abs(utilities::get_cartesian_distance(p.x, p.y, current_arc_.center.x, current_arc_.center.y) - current_arc_.radius);
+    angle_radians = utilities::get_arc_distance(start_point.x, start_point.y, 0, p.x, p.y, 0, i, j, 0, is_clockwise) / radius;
+    // The combined arc must also stay below a full circle, since G2/G3 can't turn any further.
+    is_compatible = (
+      utilities::less_than_or_equal(center_offset + utilities::abs(radius - current_arc_.radius), resolution_mm_) &&
+      utilities::less_than_or_equal(end_offset, resolution_mm_) &&
+      utilities::abs(current_arc_.angle_radians) + angle_radians < 2.0 * PI_DOUBLE - ARC_SPAN_MIN_GAP_RADIANS
+    );
+  }
+  else
+  {
+    is_compatible = false;
+  }
+  if (!is_compatible)
+  {
+    if (points_.count() < get_min_segments())
+    {
+      // The shape is still too short to write, so start again from the end of the previous move.
+      printer_point new_start_point = start_point;
+      clear();
+      points_.push_back(new_start_point);
+      return try_start_arc_span_(p, i, j, is_clockwise);
+    }
+    return false;
+  }
+
+  arc original_arc = current_arc_;
+  unsigned char original_xyz_precision = arc_xyz_precision_;
+  unsigned char original_e_precision = arc_e_precision_;
+  current_arc_.end_point = p;
+  current_arc_.angle_radians += is_clockwise ? -angle_radians : angle_radians;
+  current_arc_.length = current_arc_.radius * utilities::abs(current_arc_.angle_radians);
+  current_arc_.polar_end_theta = current_arc_.get_polar_radians(p);
+  points_.push_back(p);
+  original_shape_length_ += p.distance;
+  e_relative_ += p.e_relative;
+  if (!is_arc_within_limits_())
+  {
+    points_.pop_back();
+    original_shape_length_ -= p.distance;
+    e_relative_ -= p.e_relative;
+    current_arc_ = original_arc;
+    arc_xyz_precision_ = original_xyz_precision;
+    arc_e_precision_ = original_e_precision;
+    return false;
+  }
+  if (points_.count() >= get_min_segments())
+  {
+    set_is_shape(true);
+  }
+  return true;
+}
+
+bool segmented_arc::try_start_arc_span_(const printer_point& p, double i, double j, bool is_clockwise)
+{
+  // The first move of a run only has to be a valid arc, since it is written as it is unless another move is added.
+  const printer_point& start_point = points_[0];
+  double radius = utilities::hypot(i, j);
+  if (utilities::is_zero(radius, get_xyz_tolerance()) || radius > max_radius_mm_)
+  {
+    return false;
+  }
+  arc span;
+  span.center.x = start_point.x + i;
+  span.center.y = start_point.y + j;
+  span.center.z = start_point.z;
+  span.radius = radius;
+  if (utilities::greater_than(utilities::abs(utilities::get_cartesian_distance(p.x, p.y, span.center.x, span.center.y) - radius), resolution_mm_))
+  {
+    // The end point isn't on the circle
+    return false;
+  }
+  double angle_radians = utilities::get_arc_distance(start_point.x, start_point.y, 0, p.x, p.y, 0, i, j, 0, is_clockwise) / radius;
+  if (angle_radians >= 2.0 * PI_DOUBLE - ARC_SPAN_MIN_GAP_RADIANS)
+  {
+    return false;
+  }
+  span.is_arc = true;
+  span.direction = is_clockwise ? DirectionEnum::CLOCKWISE : DirectionEnum::COUNTERCLOCKWISE;
+  span.angle_radians = is_clockwise ? -angle_radians : angle_radians;
+  span.length = radius * angle_radians;
+  span.start_point = start_point;
+  span.end_point = p;
+  span.polar_start_theta = span.get_polar_radians(start_point);
+  span.polar_end_theta = span.get_polar_radians(p);
+  current_arc_ = span;
+  is_arc_span_ = true;
+  points_.push_back(p);
+  original_shape_length_ += p.distance;
+  e_relative_ += p.e_relative;
+  return true;
+}
+
 std::string segmented_arc::get_shape_gcode() const
 {
   std::string gcode;
+  gcode.reserve(96);
+  append_shape_gcode(gcode);
+  return gcode;
+}
+
+void segmented_arc::append_shape_gcode(std::string& gcode) const
+{
+  if (compact_output_)
+  {
+    char compact_gcode[GCODE_CHAR_BUFFER_SIZE];
+    gcode.append(compact_gcode, write_compact_shape_gcode_(compact_gcode, get_arc_xyz_precision(), get_arc_e_precision()));
+    return;
+  }
   double e = current_arc_.end_point.is_extruder_relative ? e_relative_ : current_arc_.end_point.e_offset;
   double f = current_arc_.start_point.f == current_arc_.end_point.f ? 0 : current_arc_.end_point.f;
   bool has_e = e_relative_ != 0;
@@ -299,7 +609,9 @@ std::string segmented_arc::get_shape_gcode() const
   bool has_z = allow_3d_arcs_ && !utilities::is_equal(
     current_arc_.start_point.z, current_arc_.end_point.z, get_xyz_tolerance()
   );
-  gcode.reserve(96);
+  // In relative XYZ mode (G91) the endpoint is relative to the arc's starting point, just like I and J.
+  double x, y, z;
+  get_shape_gcode_endpoint(x, y, z);
 
   if (current_arc_.angle_radians < 0)
   {
@@ -310,52 +622,256 @@ std::string segmented_arc::get_shape_gcode() const
     gcode += "G3";
 
   }
-  // TODO: Limit Gcode Precision based on max_gcode_length
-
+  unsigned char xyz_precision = get_arc_xyz_precision();
+  unsigned char e_precision = get_arc_e_precision();
 
   // Add X, Y, I and J
-  gcode += " X";
-  gcode += utilities::dtos(current_arc_.end_point.x, get_xyz_precision());
-  
-  gcode += " Y";
-  gcode += utilities::dtos(current_arc_.end_point.y, get_xyz_precision());
+  utilities::append_parameter(gcode, 'X', x, xyz_precision);
+  utilities::append_parameter(gcode, 'Y', y, xyz_precision);
   
   if (has_z)
   {
-    gcode += " Z";
-    gcode += utilities::dtos(current_arc_.end_point.z, get_xyz_precision());
+    utilities::append_parameter(gcode, 'Z', z, xyz_precision);
   }
 
   // Output I and J, but do NOT check for 0.  
   // Simplify 3d has issues visualizing G2/G3 with 0 for I or J
   // and until it is fixed, it is not worth the hassle.
-  double i = current_arc_.get_i();
-  gcode += " I";
-  gcode += utilities::dtos(i, get_xyz_precision());
-
-  double j = current_arc_.get_j();
-  gcode += " J";
-  gcode += utilities::dtos(j, get_xyz_precision());
+  utilities::append_parameter(gcode, 'I', current_arc_.get_i(), xyz_precision);
+  utilities::append_parameter(gcode, 'J', current_arc_.get_j(), xyz_precision);
 
   // Add E if it appears
   if (has_e)
   {
-    gcode += " E";
-    gcode += utilities::dtos(e, get_e_precision());
+    utilities::append_parameter(gcode, 'E', e, e_precision);
   }
 
   // Add F if it appears
   if (has_f)
   {
-    gcode += " F";
-    gcode += utilities::dtos(f, 0);
+    utilities::append_parameter(gcode, 'F', f, 0);
   }
+}
 
-  return gcode;
+void segmented_arc::get_shape_gcode_endpoint(double& x, double& y, double& z) const
+{
+  if (current_arc_.end_point.is_xyz_relative)
+  {
+    x = current_arc_.end_point.x - current_arc_.start_point.x;
+    y = current_arc_.end_point.y - current_arc_.start_point.y;
+    z = current_arc_.end_point.z - current_arc_.start_point.z;
+  }
+  else
+  {
+    x = current_arc_.end_point.x;
+    y = current_arc_.end_point.y;
+    z = current_arc_.end_point.z;
+  }
+}
+
+// Returns the value as it will be written with the given precision
+static double round_to_precision(double value, unsigned char precision)
+{
+  char buffer[FPCONV_BUFFER_LENGTH];
+  utilities::dtos(value, precision, buffer);
+  return std::atof(buffer);
+}
 
+// Writes " <word><value>" with the value compacted, and returns the number of characters written
+static int write_compact_parameter(char* gcode, char word, double value, unsigned char precision)
+{
+  gcode[0] = ' ';
+  gcode[1] = word;
+  return 2 + utilities::dtos_compact(value, precision, gcode + 2);
+}
+
+int segmented_arc::write_compact_shape_gcode_(char* gcode, unsigned char xyz_precision, unsigned char e_precision) const
+{
+  double e = current_arc_.end_point.is_extruder_relative ? e_relative_ : current_arc_.end_point.e_offset;
+  double f = current_arc_.start_point.f == current_arc_.end_point.f ? 0 : current_arc_.end_point.f;
+  bool has_e = e_relative_ != 0;
+  bool has_f = utilities::greater_than_or_equal(f, 1);
+  bool has_z = allow_3d_arcs_ && !utilities::is_equal(
+    current_arc_.start_point.z, current_arc_.end_point.z, get_xyz_tolerance()
+  );
+  double x, y, z;
+  get_shape_gcode_endpoint(x, y, z);
+
+  int length = 0;
+  gcode[length++] = 'G';
+  gcode[length++] = current_arc_.angle_radians < 0 ? '2' : '3';
+  length += write_compact_parameter(gcode + length, 'X', x, xyz_precision);
+  length += write_compact_parameter(gcode + length, 'Y', y, xyz_precision);
+  if (has_z)
+  {
+    length += write_compact_parameter(gcode + length, 'Z', z, xyz_precision);
+  }
+
+  // Use R instead of I and J if it is shorter and safe
+  int center_start = length;
+  length += write_compact_parameter(gcode + length, 'I', current_arc_.get_i(), xyz_precision);
+  length += write_compact_parameter(gcode + length, 'J', current_arc_.get_j(), xyz_precision);
+  double r;
+  if (try_get_compact_radius_(xyz_precision, r))
+  {
+    char radius[FPCONV_BUFFER_LENGTH + 2];
+    int radius_length = write_compact_parameter(radius, 'R', r, xyz_precision);
+    if (radius_length < length - center_start)
+    {
+      std::memcpy(gcode + center_start, radius, radius_length);
+      length = center_start + radius_length;
+    }
+  }
+
+  if (has_e)
+  {
+    length += write_compact_parameter(gcode + length, 'E', e, e_precision);
+  }
+  if (has_f)
+  {
+    length += write_compact_parameter(gcode + length, 'F', f, 0);
+  }
+  gcode[length] = '\0';
+  return length;
+}
+
+bool segmented_arc::try_get_compact_radius_(unsigned char xyz_precision, double& r) const
+{
+  // The firmware finds the center from the start point, the rounded end point and the radius, which is negative for
+  // arcs over 180 degrees.  Near a half circle that is very sensitive to rounding, so only use the radius if the
+  // center the firmware will find is within half of the last written decimal of the real center.
+  const printer_point& start_point = current_arc_.start_point;
+  double x, y, z;
+  get_shape_gcode_endpoint(x, y, z);
+  x = round_to_precision(x, xyz_precision);
+  y = round_to_precision(y, xyz_precision);
+  if (current_arc_.end_point.is_xyz_relative)
+  {
+    x += start_point.x;
+    y += start_point.y;
+  }
+  double dx = x - start_point.x;
+  double dy = y - start_point.y;
+  double d = utilities::hypot(dx, dy);
+  if (d == 0)
+  {
+    // A full circle can't be described by a radius
+    return false;
+  }
+  r = round_to_precision(
+    utilities::abs(current_arc_.angle_radians) > PI_DOUBLE ? -current_arc_.radius : current_arc_.radius, xyz_precision
+  );
+  if (r == 0)
+  {
+    return false;
+  }
+  // This is the same calculation Marlin uses
+  bool is_clockwise = current_arc_.angle_radians < 0;
+  double direction = is_clockwise != (r < 0) ? -1 : 1;
+  double h2 = (r - 0.5 * d) * (r + 0.5 * d);
+  double h = h2 >= 0 ? std::sqrt(h2) : 0;
+  double center_x = (start_point.x + x) * 0.5 - direction * h * dy / d;
+  double center_y = (start_point.y + y) * 0.5 + direction * h * dx / d;
+  double max_error = 0.5 * std::pow(10.0, -static_cast<int>(xyz_precision));
+  return utilities::get_cartesian_distance(center_x, center_y, current_arc_.center.x, current_arc_.center.y) <= max_error;
+}
+
+bool segmented_arc::try_reduce_precision_()
+{
+  // Lower the precision one decimal at a time until the gcode fits, E first since it doesn't move the path.  Relative
+  // values are never rounded further, since the error would add up over the print.
+  unsigned char xyz_precision = get_xyz_precision();
+  unsigned char e_precision = get_e_precision();
+  bool can_reduce_e = !current_arc_.end_point.is_extruder_relative;
+  bool can_reduce_xyz = !current_arc_.end_point.is_xyz_relative;
+  for (;;)
+  {
+    if (can_reduce_e && e_precision > MIN_REDUCED_E_PRECISION)
+    {
+      e_precision--;
+    }
+    else if (can_reduce_xyz && xyz_precision > MIN_REDUCED_XYZ_PRECISION)
+    {
+      xyz_precision--;
+    }
+    else
+    {
+      return false;
+    }
+    if (get_shape_gcode_length(xyz_precision, e_precision) > max_gcode_length_)
+    {
+      continue;
+    }
+    // Rounding to fewer decimals will only move the path further, so there is no point in trying a lower precision.
+    if (xyz_precision != get_xyz_precision() && !is_within_resolution_when_rounded_(xyz_precision))
+    {
+      return false;
+    }
+    arc_xyz_precision_ = xyz_precision;
+    arc_e_precision_ = e_precision;
+    return true;
+  }
+}
+
+bool segmented_arc::is_within_resolution_when_rounded_(unsigned char xyz_precision) const
+{
+  // The printer will draw the arc from the start point around the rounded center, so the radius is the distance between
+  // them, and then finish at the rounded end point.
+  const printer_point& start_point = current_arc_.start_point;
+  double i = round_to_precision(current_arc_.get_i(), xyz_precision);
+  double j = round_to_precision(current_arc_.get_j(), xyz_precision);
+  if (i == 0 && j == 0)
+  {
+    return false;
+  }
+  circle rounded_circle(point(start_point.x + i, start_point.y + j, start_point.z), 0);
+  rounded_circle.radius = utilities::get_cartesian_distance(start_point.x, start_point.y, rounded_circle.center.x, rounded_circle.center.y);
+
+  double x, y, z;
+  get_shape_gcode_endpoint(x, y, z);
+  x = round_to_precision(x, xyz_precision);
+  y = round_to_precision(y, xyz_precision);
+  z = round_to_precision(z, xyz_precision);
+  // Both the start (the previous command's end) and the end of the arc may be shifted by rounding, so the rounded
+  // circle only gets whatever is left of the resolution after the worst case shift.
+  double max_rounding_shift = 0.5 * std::pow(10.0, -static_cast<int>(xyz_precision)) * std::sqrt(2.0);
+  double remaining_resolution_mm = resolution_mm_ - max_rounding_shift;
+  if (remaining_resolution_mm <= 0)
+  {
+    return false;
+  }
+  const printer_point& end_point = current_arc_.end_point;
+  if (
+    (allow_3d_arcs_ && utilities::abs(z - end_point.z) > remaining_resolution_mm) ||
+    utilities::abs(utilities::get_cartesian_distance(x, y, rounded_circle.center.x, rounded_circle.center.y) - rounded_circle.radius) > remaining_resolution_mm
+  )
+  {
+    return false;
+  }
+  return !rounded_circle.is_over_deviation(points_, remaining_resolution_mm, get_xyz_tolerance(), allow_3d_arcs_);
 }
 
 int segmented_arc::get_shape_gcode_length()
+{
+  return get_shape_gcode_length(get_arc_xyz_precision(), get_arc_e_precision());
+}
+
+int segmented_arc::get_shape_gcode_length(unsigned char xyz_precision, unsigned char e_precision) const
+{
+  if (compact_output_)
+  {
+    char compact_gcode[GCODE_CHAR_BUFFER_SIZE];
+    return write_compact_shape_gcode_(compact_gcode, xyz_precision, e_precision);
+  }
+  return get_standard_shape_gcode_length(xyz_precision, e_precision);
+}
+
+int segmented_arc::get_standard_shape_gcode_length() const
+{
+  return get_standard_shape_gcode_length(get_arc_xyz_precision(), get_arc_e_precision());
+}
+
+int segmented_arc::get_standard_shape_gcode_length(unsigned char xyz_precision, unsigned char e_precision) const
 {
   double e = current_arc_.end_point.is_extruder_relative ? e_relative_ : current_arc_.end_point.e_offset;
   double f = current_arc_.start_point.f == current_arc_.end_point.f ? 0 : current_arc_.end_point.f;
@@ -364,33 +880,31 @@ int segmented_arc::get_shape_gcode_length()
   bool has_z = allow_3d_arcs_ && !utilities::is_equal(
     current_arc_.start_point.z, current_arc_.end_point.z, get_xyz_tolerance()
   );
-  
-  int xyz_precision = get_xyz_precision();
-  int e_precision = get_e_precision();
 
   double i = current_arc_.get_i();
   double j = current_arc_.get_j();
-
+  double x, y, z;
+  get_shape_gcode_endpoint(x, y, z);
 
   int num_spaces = 4 + (has_z ? 1 : 0) + (has_e ? 1 : 0) + (has_f ? 1 : 0);
   int num_decimal_points = 4 + (has_z ? 1 : 0) + (has_e ? 1 : 0);  // note f has no decimal point
   int num_decimals = xyz_precision * (4 + (has_z ? 1 : 0)) + e_precision * (has_e ? 1 : 0); // Note f is an int
   int num_digits = (
-    utilities::get_num_digits(current_arc_.end_point.x, xyz_precision) +
-    utilities::get_num_digits(current_arc_.end_point.y, xyz_precision) +
-    (has_z ? utilities::get_num_digits(current_arc_.end_point.z, xyz_precision) : 0) +
+    utilities::get_num_digits(x, xyz_precision) +
+    utilities::get_num_digits(y, xyz_precision) +
+    (has_z ? utilities::get_num_digits(z, xyz_precision) : 0) +
     (has_e ? utilities::get_num_digits(e, e_precision) : 0) +
     utilities::get_num_digits(i, xyz_precision) +
     utilities::get_num_digits(j, xyz_precision) +
     (has_f ? utilities::get_num_digits(f,0) : 0)
   );
   int num_minus_signs = (
-    (current_arc_.end_point.x < 0 ? 1 : 0) + 
-    (current_arc_.end_point.y < 0 ? 1 : 0) +
+    (x < 0 ? 1 : 0) + 
+    (y < 0 ? 1 : 0) +
     (i < 0 ? 1 : 0) +
     (j < 0 ? 1 : 0) +
     (has_e && e < 0 ? 1 : 0) +
-    (has_z && current_arc_.end_point.z < 0 ? 1 : 0)
+    (has_z && z < 0 ? 1 : 0)
   );
 
   int num_parameters = 4 + (has_e ? 1 : 0) + (has_z ? 1: 0) + (has_f ? 1: 0);
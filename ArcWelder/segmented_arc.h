@@ -26,6 +26,13 @@
 #pragma once
 #include "segmented_shape.h"
 #define GCODE_CHAR_BUFFER_SIZE 1000
+// Extra room given to the resolution by the curvature prefilter so that floating point error can never make it reject a valid arc
+#define ARC_PREFILTER_MARGIN_MM 0.000001
+// The lowest precisions that an arc may be reduced to in order to fit within the maximum gcode length
+#define MIN_REDUCED_XYZ_PRECISION 1
+#define MIN_REDUCED_E_PRECISION 3
+// Combined G2/G3 moves must end at least this far short of a full circle, so that the end point can't be confused with the start point.
+#define ARC_SPAN_MIN_GAP_RADIANS 0.01
 
 class segmented_arc :
 	public segmented_shape
@@ -43,24 +50,57 @@ public:
 		bool allow_3d_arcs = DEFAULT_ALLOW_3D_ARCS,
 		unsigned char default_xyz_precision = DEFAULT_XYZ_PRECISION,
 		unsigned char default_e_precision = DEFAULT_E_PRECISION,
-		int max_gcode_length = DEFAULT_MAX_GCODE_LENGTH
+		int max_gcode_length = DEFAULT_MAX_GCODE_LENGTH,
+		bool reduce_precision_to_fit = DEFAULT_REDUCE_PRECISION_TO_FIT
 	);
 	virtual ~segmented_arc();
 	virtual bool try_add_point(printer_point p);
+	bool try_set_points(const printer_point_list& points, int start_index, int end_index);
+	// Adds an existing G2/G3 move from the last point to p, with I and J relative to the last point.  Consecutive moves
+	// are combined if they follow the same circle within the resolution, in the same direction, and turn less than a
+	// full circle in total.  The moves are added exactly, so they can't be mixed with points from G0/G1 moves.
+	bool try_add_arc_span(printer_point p, double i, double j, bool is_clockwise);
+	// Returns true if the shape is made of G2/G3 moves added with try_add_arc_span.
+	bool is_arc_span() const;
 	virtual double get_shape_length();
 	std::string get_shape_gcode() const;
+	// Appends the arc's gcode to the end of the supplied buffer, so that a single buffer can be reused for every arc.
+	void append_shape_gcode(std::string& gcode) const;
 	int get_shape_gcode_length();
+	// The length of the arc's gcode without compaction, used to report the bytes saved by compact output.
+	int get_standard_shape_gcode_length() const;
 	virtual bool is_shape() const;
+	virtual void clear();
 	printer_point pop_front(double e_relative);
 	printer_point pop_back(double e_relative);
 	double get_max_radius() const;
+	void set_max_radius(double max_radius_mm);
 	int get_min_arc_segments() const;
 	double get_mm_per_arc_segment() const;
 	int get_num_firmware_compensations() const;
 	int get_num_gcode_length_exceptions() const;
+	// Returns true if the precision of the current arc was lowered to fit within the maximum gcode length.
+	bool is_precision_reduced() const;
+	int get_max_gcode_length() const;
+	bool get_reduce_precision_to_fit() const;
+	int get_num_prefilter_rejects() const;
 private:
 	bool try_add_point_internal_(printer_point p);
+	bool try_start_arc_span_(const printer_point& p, double i, double j, bool is_clockwise);
+	bool is_arc_within_limits_();
+	bool can_point_be_on_arc_(const printer_point& p) const;
+	void get_shape_gcode_endpoint(double& x, double& y, double& z) const;
+	int get_shape_gcode_length(unsigned char xyz_precision, unsigned char e_precision) const;
+	int get_standard_shape_gcode_length(unsigned char xyz_precision, unsigned char e_precision) const;
+	int write_compact_shape_gcode_(char* gcode, unsigned char xyz_precision, unsigned char e_precision) const;
+	bool try_get_compact_radius_(unsigned char xyz_precision, double& r) const;
+	bool try_reduce_precision_();
+	bool is_within_resolution_when_rounded_(unsigned char xyz_precision) const;
+	unsigned char get_arc_xyz_precision() const;
+	unsigned char get_arc_e_precision() const;
 	arc current_arc_;
+	circle_deviation_cache deviation_cache_;
+	circle_least_squares_buffers least_squares_buffers_;
 	double max_radius_mm_;
 	int min_arc_segments_;
 	double mm_per_arc_segment_;
@@ -68,5 +108,11 @@ private:
 	bool allow_3d_arcs_;
 	int max_gcode_length_;
 	int num_gcode_length_exceptions_;
+	bool reduce_precision_to_fit_;
+	// The precision of the current arc if it had to be reduced to fit within max_gcode_length_, else 0.
+	unsigned char arc_xyz_precision_;
+	unsigned char arc_e_precision_;
+	int num_prefilter_rejects_;
+	bool is_arc_span_;
 };															
 
@@ -0,0 +1,250 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Arc Welder: Anti-Stutter Library
+//
+// Compresses many G0/G1 commands into G2/G3(arc) commands where possible, ensuring the tool paths stay within the specified resolution.
+// This reduces file size and the number of gcodes per second.
+//
+// Uses the 'Gcode Processor Library' for gcode parsing, position processing, logging, and other various functionality.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address: 
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "segmented_bezier.h"
+#include "utilities.h"
+
+segmented_bezier::segmented_bezier(
+  int min_segments,
+  int max_segments,
+  double resolution_mm,
+  double path_tolerance_percent,
+  unsigned char default_xyz_precision,
+  unsigned char default_e_precision,
+  int max_gcode_length
+) : segmented_shape(min_segments, max_segments, resolution_mm, path_tolerance_percent, default_xyz_precision, default_e_precision)
+{
+  max_gcode_length_ = max_gcode_length;
+  if (max_gcode_length_ < 1)
+  {
+    max_gcode_length_ = 0;
+  }
+  num_gcode_length_exceptions_ = 0;
+}
+
+segmented_bezier::~segmented_bezier()
+{
+}
+
+void segmented_bezier::clear()
+{
+  segmented_shape::clear();
+}
+
+bool segmented_bezier::is_shape() const
+{
+  return is_shape_;
+}
+
+double segmented_bezier::get_shape_length()
+{
+  return current_bezier_.length;
+}
+
+int segmented_bezier::get_num_gcode_length_exceptions() const
+{
+  return num_gcode_length_exceptions_;
+}
+
+bool segmented_bezier::try_add_point(printer_point p)
+{
+  bool point_added = false;
+  if (points_.count() == points_.get_max_size())
+  {
+    points_.resize(points_.get_max_size() * 2);
+  }
+  if (points_.count() > 0)
+  {
+    printer_point p1 = points_[points_.count() - 1];
+    if (!utilities::is_equal(p1.z, p.z))
+    {
+      // G5 only moves in the XY plane
+      return false;
+    }
+
+    if (p1.is_xyz_relative != p.is_xyz_relative)
+    {
+      // The XYZ axis mode must be the same for every point in the curve
+      return false;
+    }
+
+    // Make sure the current and previous moves are all of the same type.
+    if (points_.count() > 2)
+    {
+      if (!(
+        (p1.e_relative > 0 && p.e_relative > 0) // Extrusions 
+        || (p1.e_relative < 0 && p.e_relative < 0) // Retractions
+        || (p1.e_relative == 0 && p.e_relative == 0) // Travel
+        )
+        )
+      {
+        return false;
+      }
+    }
+
+    if (utilities::is_zero(p.distance))
+    {
+      // there must be some distance between the points
+      return false;
+    }
+  }
+
+  if (points_.count() < get_min_segments() - 1)
+  {
+    point_added = true;
+    points_.push_back(p);
+    original_shape_length_ += p.distance;
+  }
+  else
+  {
+    point_added = try_add_point_internal_(p);
+  }
+  if (point_added)
+  {
+    if (points_.count() > 1)
+    {
+      // Only add the relative distance to the second point on up.
+      e_relative_ += p.e_relative;
+    }
+  }
+  else if (points_.count() < get_min_segments() && points_.count() > 1)
+  {
+    // Just like an arc, pull off the initial point and try again
+    points_.pop_front();
+    printer_point new_initial_point = points_[0];
+    original_shape_length_ -= new_initial_point.distance;
+    e_relative_ -= new_initial_point.e_relative;
+    return try_add_point(p);
+  }
+
+  return point_added;
+}
+
+bool segmented_bezier::try_add_point_internal_(printer_point p)
+{
+  if (points_.count() < get_min_segments() - 1)
+    return false;
+
+  points_.push_back(p);
+  double previous_shape_length = original_shape_length_;
+  original_shape_length_ += p.distance;
+  bezier original_bezier = current_bezier_;
+  if (bezier::try_create_bezier(points_, current_bezier_, parameters_, original_shape_length_, resolution_mm_, path_tolerance_percent_, get_xyz_tolerance()))
+  {
+    if (max_gcode_length_ > 0 && get_shape_gcode_length() > max_gcode_length_)
+    {
+      num_gcode_length_exceptions_++;
+      current_bezier_ = original_bezier;
+    }
+    else
+    {
+      if (!is_shape())
+      {
+        set_is_shape(true);
+      }
+      return true;
+    }
+  }
+  // Can't create the curve.  Remove the point and remove the previous segment length.
+  points_.pop_back();
+  original_shape_length_ = previous_shape_length;
+  return false;
+}
+
+void segmented_bezier::get_shape_gcode_endpoint(double& x, double& y) const
+{
+  if (current_bezier_.end_point.is_xyz_relative)
+  {
+    x = current_bezier_.end_point.x - current_bezier_.start_point.x;
+    y = current_bezier_.end_point.y - current_bezier_.start_point.y;
+  }
+  else
+  {
+    x = current_bezier_.end_point.x;
+    y = current_bezier_.end_point.y;
+  }
+}
+
+std::string segmented_bezier::get_shape_gcode() const
+{
+  std::string gcode;
+  gcode.reserve(112);
+  append_shape_gcode(gcode);
+  return gcode;
+}
+
+void segmented_bezier::append_shape_gcode(std::string& gcode) const
+{
+  append_shape_gcode_(gcode, compact_output_);
+}
+
+void segmented_bezier::append_shape_gcode_(std::string& gcode, bool compact) const
+{
+  double e = current_bezier_.end_point.is_extruder_relative ? e_relative_ : current_bezier_.end_point.e_offset;
+  double f = current_bezier_.start_point.f == current_bezier_.end_point.f ? 0 : current_bezier_.end_point.f;
+  bool has_e = e_relative_ != 0;
+  bool has_f = utilities::greater_than_or_equal(f, 1);
+  // In relative XYZ mode (G91) the endpoint is relative to the curve's starting point.  The control points are
+  // always relative, I and J to the start point and P and Q to the end point.
+  double x, y;
+  get_shape_gcode_endpoint(x, y);
+
+  void (*append_parameter)(std::string&, char, double, unsigned char) = compact
+    ? utilities::append_compact_parameter
+    : utilities::append_parameter;
+  gcode += "G5";
+  append_parameter(gcode, 'X', x, get_xyz_precision());
+  append_parameter(gcode, 'Y', y, get_xyz_precision());
+  append_parameter(gcode, 'I', current_bezier_.get_i(), get_xyz_precision());
+  append_parameter(gcode, 'J', current_bezier_.get_j(), get_xyz_precision());
+  append_parameter(gcode, 'P', current_bezier_.get_p(), get_xyz_precision());
+  append_parameter(gcode, 'Q', current_bezier_.get_q(), get_xyz_precision());
+
+  // Add E if it appears
+  if (has_e)
+  {
+    append_parameter(gcode, 'E', e, get_e_precision());
+  }
+
+  // Add F if it appears
+  if (has_f)
+  {
+    append_parameter(gcode, 'F', f, 0);
+  }
+}
+
+int segmented_bezier::get_shape_gcode_length()
+{
+  gcode_buffer_.clear();
+  append_shape_gcode(gcode_buffer_);
+  return static_cast<int>(gcode_buffer_.length());
+}
+
+int segmented_bezier::get_standard_shape_gcode_length()
+{
+  gcode_buffer_.clear();
+  append_shape_gcode_(gcode_buffer_, false);
+  return static_cast<int>(gcode_buffer_.length());
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Arc Welder: Anti-Stutter Library
+//
+// Compresses many G0/G1 commands into G2/G3(arc) commands where possible, ensuring the tool paths stay within the specified resolution.
+// This reduces file size and the number of gcodes per second.
+//
+// Uses the 'Gcode Processor Library' for gcode parsing, position processing, logging, and other various functionality.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address: 
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "segmented_shape.h"
+
+// A run of points replaced by a single cubic bezier curve (G5).
+class segmented_bezier :
+	public segmented_shape
+{
+public:
+	segmented_bezier(
+		int min_segments = DEFAULT_MIN_SEGMENTS,
+		int max_segments = DEFAULT_MAX_SEGMENTS,
+		double resolution_mm = DEFAULT_RESOLUTION_MM,
+		double path_tolerance_percent = ARC_LENGTH_PERCENT_TOLERANCE_DEFAULT,
+		unsigned char default_xyz_precision = DEFAULT_XYZ_PRECISION,
+		unsigned char default_e_precision = DEFAULT_E_PRECISION,
+		int max_gcode_length = DEFAULT_MAX_GCODE_LENGTH
+	);
+	virtual ~segmented_bezier();
+	virtual bool try_add_point(printer_point p);
+	virtual double get_shape_length();
+	std::string get_shape_gcode() const;
+	// Appends the curve's gcode to the end of the supplied buffer, so that a single buffer can be reused for every curve.
+	void append_shape_gcode(std::string& gcode) const;
+	int get_shape_gcode_length();
+	// The length of the curve's gcode without compaction, used to report the bytes saved by compact output.
+	int get_standard_shape_gcode_length();
+	virtual bool is_shape() const;
+	virtual void clear();
+	int get_num_gcode_length_exceptions() const;
+private:
+	bool try_add_point_internal_(printer_point p);
+	void get_shape_gcode_endpoint(double& x, double& y) const;
+	void append_shape_gcode_(std::string& gcode, bool compact) const;
+	bezier current_bezier_;
+	// The parameter of each point along the curve, kept to avoid reallocating it for every point.
+	std::vector<double> parameters_;
+	// Reused when measuring the gcode length of each candidate curve.
+	std::string gcode_buffer_;
+	int max_gcode_length_;
+	int num_gcode_length_exceptions_;
+};
@@ -24,10 +24,12 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "segmented_shape.h"
+#include "deviation_kernels.h"
 #include <stdio.h>
 #include "utilities.h"
 #include <cmath>
 #include <iostream>
+#include <vector>
 #pragma region Operators for Vector and Point
 
 point operator +(point lhs, const vector rhs) {
@@ -93,6 +95,198 @@ double point::cartesian_distance(const point& p1, const point& p2)
 
 #pragma endregion Point Functions
 
+#pragma region Printer Point List Functions
+printer_point_list::printer_point_list(int max_size)
+{
+  allocate(max_size);
+}
+
+printer_point_list::printer_point_list(const printer_point_list& source)
+{
+  allocate(source.max_size_);
+  copy(source);
+}
+
+printer_point_list::~printer_point_list()
+{
+  release();
+}
+
+printer_point_list& printer_point_list::operator=(const printer_point_list& source)
+{
+  if (this != &source)
+  {
+    copy(source);
+  }
+  return *this;
+}
+
+void printer_point_list::allocate(int max_size)
+{
+  x_ = new double[max_size];
+  y_ = new double[max_size];
+  z_ = new double[max_size];
+  extrusion_ = new extrusion_data[max_size];
+  max_size_ = max_size;
+  front_index_ = 0;
+  count_ = 0;
+}
+
+void printer_point_list::release()
+{
+  delete[] x_;
+  delete[] y_;
+  delete[] z_;
+  delete[] extrusion_;
+}
+
+int printer_point_list::count() const
+{
+  return count_;
+}
+
+int printer_point_list::get_max_size() const
+{
+  return max_size_;
+}
+
+void printer_point_list::resize(int max_size)
+{
+  double* old_x = x_;
+  double* old_y = y_;
+  double* old_z = z_;
+  extrusion_data* old_extrusion = extrusion_;
+  int old_front_index = front_index_;
+  int old_count = count_;
+  allocate(max_size);
+  for (int index = 0; index < old_count; index++)
+  {
+    x_[index] = old_x[old_front_index + index];
+    y_[index] = old_y[old_front_index + index];
+    z_[index] = old_z[old_front_index + index];
+    extrusion_[index] = old_extrusion[old_front_index + index];
+  }
+  count_ = old_count;
+  delete[] old_x;
+  delete[] old_y;
+  delete[] old_z;
+  delete[] old_extrusion;
+}
+
+void printer_point_list::clear()
+{
+  front_index_ = 0;
+  count_ = 0;
+}
+
+void printer_point_list::copy(const printer_point_list& source)
+{
+  if (max_size_ < source.count_)
+  {
+    resize(source.max_size_);
+  }
+  clear();
+  for (int index = 0; index < source.count_; index++)
+  {
+    x_[index] = source.x_[source.front_index_ + index];
+    y_[index] = source.y_[source.front_index_ + index];
+    z_[index] = source.z_[source.front_index_ + index];
+    extrusion_[index] = source.extrusion_[source.front_index_ + index];
+  }
+  count_ = source.count_;
+}
+
+void printer_point_list::compact()
+{
+  for (int index = 0; index < count_; index++)
+  {
+    x_[index] = x_[front_index_ + index];
+    y_[index] = y_[front_index_ + index];
+    z_[index] = z_[front_index_ + index];
+    extrusion_[index] = extrusion_[front_index_ + index];
+  }
+  front_index_ = 0;
+}
+
+void printer_point_list::push_back(const printer_point& p)
+{
+  if (count_ == max_size_)
+  {
+    throw std::exception();
+  }
+  if (front_index_ + count_ == max_size_)
+  {
+    // Points were removed from the front, and there is no more room at the back.
+    compact();
+  }
+  int index = front_index_ + count_;
+  x_[index] = p.x;
+  y_[index] = p.y;
+  z_[index] = p.z;
+  extrusion_data& extrusion = extrusion_[index];
+  extrusion.e_offset = p.e_offset;
+  extrusion.e_relative = p.e_relative;
+  extrusion.f = p.f;
+  extrusion.distance = p.distance;
+  extrusion.is_extruder_relative = p.is_extruder_relative;
+  extrusion.is_xyz_relative = p.is_xyz_relative;
+  count_++;
+}
+
+printer_point printer_point_list::pop_front()
+{
+  if (count_ == 0)
+  {
+    throw std::exception();
+  }
+  printer_point p = (*this)[0];
+  front_index_++;
+  count_--;
+  if (count_ == 0)
+  {
+    front_index_ = 0;
+  }
+  return p;
+}
+
+printer_point printer_point_list::pop_back()
+{
+  if (count_ == 0)
+  {
+    throw std::exception();
+  }
+  printer_point p = (*this)[count_ - 1];
+  count_--;
+  if (count_ == 0)
+  {
+    front_index_ = 0;
+  }
+  return p;
+}
+
+printer_point printer_point_list::operator[](int index) const
+{
+  int position = front_index_ + index;
+  const extrusion_data& extrusion = extrusion_[position];
+  return printer_point(x_[position], y_[position], z_[position], extrusion.e_offset, extrusion.e_relative, extrusion.f, extrusion.distance, extrusion.is_extruder_relative, extrusion.is_xyz_relative);
+}
+
+const double* printer_point_list::get_x() const
+{
+  return x_ + front_index_;
+}
+
+const double* printer_point_list::get_y() const
+{
+  return y_ + front_index_;
+}
+
+const double* printer_point_list::get_z() const
+{
+  return z_ + front_index_;
+}
+#pragma endregion Printer Point List Functions
+
 #pragma region Segment Functions
 bool segment::get_closest_perpendicular_point(point c, point& d)
 {
@@ -119,6 +313,21 @@ bool segment::get_closest_perpendicular_point(const point& p1, const point& p2,
   return true;
 }
 
+double segment::get_distance(const point& p1, const point& p2, const point& c)
+{
+  double x_dif = p2.x - p1.x;
+  double y_dif = p2.y - p1.y;
+  double denom = (x_dif * x_dif) + (y_dif * y_dif);
+  double t = 0;
+  if (denom > 0)
+  {
+    t = ((c.x - p1.x) * x_dif + (c.y - p1.y) * y_dif) / denom;
+    if (t < 0) t = 0;
+    else if (t > 1) t = 1;
+  }
+  return utilities::get_cartesian_distance(c.x, c.y, p1.x + t * x_dif, p1.y + t * y_dif);
+}
+
 #pragma endregion
 
 #pragma region Vector Functions
@@ -195,7 +404,7 @@ bool circle::try_create_circle(const point& p1, const point& p2, const point& p3
   return true;
 }
 
-bool circle::try_create_circle(const array_list<printer_point>& points, const double max_radius, const double resolution_mm, const double xyz_tolerance, bool allow_3d_arcs, circle& new_circle)
+bool circle::try_create_circle(const printer_point_list& points, const double max_radius, const double resolution_mm, const double xyz_tolerance, bool allow_3d_arcs, circle& new_circle, circle_deviation_cache* p_deviation_cache, circle_least_squares_buffers* p_buffers)
 {
   int count = points.count();
   int middle_index = count / 2;
@@ -203,58 +412,117 @@ bool circle::try_create_circle(const array_list<printer_point>& points, const do
   
 
   
-  if (circle::try_create_circle(points[0], points[middle_index], points[end_index], max_radius, new_circle) && !new_circle.is_over_deviation(points, resolution_mm, xyz_tolerance, allow_3d_arcs))
+  if (circle::try_create_circle(points[0], points[middle_index], points[end_index], max_radius, new_circle) && !new_circle.is_over_deviation(points, resolution_mm, xyz_tolerance, allow_3d_arcs, p_deviation_cache))
   {
     return true;
   }
   
-       /*
-  // This could be a near complete circle.  In that case, the endpoints might be too close together to generate an accurate circle with the 
-  // precision we have to work with.  Let's adjust our circle into thirds and test those points as a last ditch effort.
-  if (count > 5)
-  {
-    middle_index = count / 3;
-    end_index = middle_index + middle_index;
-    if (circle::try_create_circle(points[0], points[middle_index], points[end_index], max_radius, test_circle) && !test_circle.is_over_deviation(points, resolution_mm, xyz_tolerance, allow_3d_arcs))
+  // The midpoint circle didn't fit.  Try the best fitting circle through the endpoints instead.
+  return circle::try_create_circle_least_squares(points, max_radius, resolution_mm, xyz_tolerance, allow_3d_arcs, new_circle, p_deviation_cache, p_buffers);
+}
+
+bool circle::try_create_circle_least_squares(const printer_point_list& points, const double max_radius, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs, circle& new_circle, circle_deviation_cache* p_deviation_cache, circle_least_squares_buffers* p_buffers)
+{
+  // Every circle through both endpoints has its center on the perpendicular bisector of the chord between them,
+  // at m + t * n, where m is the chord midpoint and n is the unit normal of the chord.  Relative to m, point q is on that
+  // circle when a - 2tb = 0, where a = |q|^2 - h^2, b = n.q and h is half of the chord length.  Minimizing the weighted
+  // sum of the squares of that (Kasa) residual gives t = sum(w * a * b) / (2 * sum(w * b * b)).
+  int count = points.count();
+  if (count < 3)
+  {
+    return false;
+  }
+  printer_point start_point = points[0];
+  printer_point end_point = points[count - 1];
+  double mid_x = (start_point.x + end_point.x) / 2.0;
+  double mid_y = (start_point.y + end_point.y) / 2.0;
+  double chord_x = end_point.x - start_point.x;
+  double chord_y = end_point.y - start_point.y;
+  double chord_length = utilities::sqrt(chord_x * chord_x + chord_y * chord_y);
+  if (utilities::is_zero(chord_length, 0.000000001))
+  {
+    // The endpoints are the same, so the bisector is undefined.
+    return false;
+  }
+  double normal_x = -chord_y / chord_length;
+  double normal_y = chord_x / chord_length;
+  double half_chord_squared = (chord_length * chord_length) / 4.0;
+
+  // The segments between the points are checked for deviation too, and on a coarse polygon their midpoints sag inside
+  // the circle through the points.  Fit the segment midpoints as well as the interior points, so the circle lies between the two.
+  int num_samples = (count - 1) + (count - 2);
+  circle_least_squares_buffers local_buffers;
+  circle_least_squares_buffers& buffers = p_buffers != NULL ? *p_buffers : local_buffers;
+  buffers.a.resize(num_samples);
+  buffers.b.resize(num_samples);
+  buffers.weights.assign(num_samples, 1.0);
+  double* a = buffers.a.data();
+  double* b = buffers.b.data();
+  double* weights = buffers.weights.data();
+  const double* x = points.get_x();
+  const double* y = points.get_y();
+  int sample_index = 0;
+  for (int index = 0; index < count - 1; index++)
+  {
+    double q_x = (x[index] + x[index + 1]) / 2.0 - mid_x;
+    double q_y = (y[index] + y[index + 1]) / 2.0 - mid_y;
+    a[sample_index] = q_x * q_x + q_y * q_y - half_chord_squared;
+    b[sample_index++] = normal_x * q_x + normal_y * q_y;
+    if (index > 0)
     {
-      new_circle = test_circle;
-      return true;
+      q_x = x[index] - mid_x;
+      q_y = y[index] - mid_y;
+      a[sample_index] = q_x * q_x + q_y * q_y - half_chord_squared;
+      b[sample_index++] = normal_x * q_x + normal_y * q_y;
     }
   }
-  return false;
-         */
-  
-  // Find the circle with the least deviation, if one exists.
-  // Note, this could possibly take a LONG time in the worst case, but it's a pretty unlikely.
-  // However, if the midpoint check doesn't pass, it's worth it to spend a bit more time 
-  // finding the best fit for the circle (least squares deviation) 
-  
-  double least_deviation;
-  bool found_circle=false;
 
-  for (int index = 1; index < count - 1; index++)
+  // If the least squares circle is over the deviation, move toward the minimax circle by reweighting each
+  // sample by its residual (Lawson's algorithm), since the resolution limits the largest deviation, not the sum.
+  for (int iteration = 0; iteration <= CIRCLE_LEAST_SQUARES_MAX_REWEIGHTS; iteration++)
   {
-    
-    if (index == middle_index)
+    double sum_ab = 0;
+    double sum_bb = 0;
+    for (int index = 0; index < num_samples; index++)
     {
-      // We already checked this one, and it failed, continue.
-      continue;
+      sum_ab += weights[index] * a[index] * b[index];
+      sum_bb += weights[index] * b[index] * b[index];
     }
-    circle test_circle;
-    double current_deviation;
-    if (circle::try_create_circle(points[0], points[index], points[count - 1], max_radius, test_circle) && test_circle.get_deviation_sum_squared(points, resolution_mm, xyz_tolerance, allow_3d_arcs, current_deviation))
+    if (utilities::is_zero(sum_bb, 0.000000001))
     {
-      
-      if (!found_circle || current_deviation < least_deviation)
-      {
-        found_circle = true;
-        least_deviation = current_deviation;
-        new_circle = test_circle;
-      }
+      // All of the points are on the chord
+      return false;
+    }
+    double t = sum_ab / (2.0 * sum_bb);
+    double radius = utilities::sqrt(t * t + half_chord_squared);
+    if (radius > max_radius)
+      return false;
+
+    new_circle.center.x = mid_x + t * normal_x;
+    new_circle.center.y = mid_y + t * normal_y;
+    new_circle.center.z = start_point.z;
+    new_circle.radius = radius;
+    if (!new_circle.is_over_deviation(points, resolution_mm, xyz_tolerance, allow_3d_arcs, p_deviation_cache))
+    {
+      return true;
+    }
+
+    double sum_weights = 0;
+    for (int index = 0; index < num_samples; index++)
+    {
+      weights[index] *= utilities::abs(a[index] - 2.0 * t * b[index]);
+      sum_weights += weights[index];
+    }
+    if (sum_weights == 0)
+    {
+      return false;
+    }
+    for (int index = 0; index < num_samples; index++)
+    {
+      weights[index] /= sum_weights;
     }
   }
-  return found_circle;
-  
+  return false;
 }
 
 double circle::get_polar_radians(const point& p1) const
@@ -265,8 +533,11 @@ double circle::get_polar_radians(const point& p1) const
   return polar_radians;
 }
 
-bool circle::get_deviation_sum_squared(const array_list<printer_point>& points, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs, double &total_deviation)
+bool circle::get_deviation_sum_squared(const printer_point_list& points, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs, double &total_deviation)
 {
+  const double* x = points.get_x();
+  const double* y = points.get_y();
+  const double* z = points.get_z();
   // We need to ensure that the Z steps are constand per linear travel unit
   double z_step_per_distance = 0;
   total_deviation = 0;
@@ -275,10 +546,10 @@ bool circle::get_deviation_sum_squared(const array_list<printer_point>& points,
   {
     // Make sure the length from the center of our circle to the test point is 
     // at or below our max distance.
-    double distance_from_center = utilities::get_cartesian_distance(points[index].x, points[index].y, center.x, center.y);
+    double distance_from_center = utilities::get_cartesian_distance(x[index], y[index], center.x, center.y);
     if (allow_3d_arcs) {
-      double z1 = points[index - 1].z;
-      double z2 = points[index].z;
+      double z1 = z[index - 1];
+      double z2 = z[index];
 
       double current_z_stepper_distance = (z2 - z1) / distance_from_center;
       if (index == 1) {
@@ -302,7 +573,7 @@ bool circle::get_deviation_sum_squared(const array_list<printer_point>& points,
   for (int index = 0; index < points.count() - 1; index++)
   {
     point point_to_test;
-    if (segment::get_closest_perpendicular_point(points[index], points[index + 1], center, point_to_test))
+    if (segment::get_closest_perpendicular_point(point(x[index], y[index], z[index]), point(x[index + 1], y[index + 1], z[index + 1]), center, point_to_test))
     {
       double distance = utilities::get_cartesian_distance(point_to_test.x, point_to_test.y, center.x, center.y);
       double deviation = utilities::abs(distance - radius);
@@ -316,8 +587,16 @@ bool circle::get_deviation_sum_squared(const array_list<printer_point>& points,
   return true;
 }
 
-bool circle::is_over_deviation(const array_list<printer_point>& points, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs)
+bool circle::is_over_deviation(const printer_point_list& points, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs)
 {
+  if (!allow_3d_arcs)
+  {
+    double max_deviation;
+    return !try_get_max_deviation(points, 0, resolution_mm, max_deviation);
+  }
+  const double* x = points.get_x();
+  const double* y = points.get_y();
+  const double* z = points.get_z();
   // We need to ensure that the Z steps are constand per linear travel unit
   double z_step_per_distance = 0;
   // shared point to test
@@ -326,14 +605,14 @@ bool circle::is_over_deviation(const array_list<printer_point>& points, const do
   // Skip the first and last points since they will fit perfectly.
   for (int index = 0; index < max_index; index++)
   {
-    point current_point(points[index]);
+    point current_point(x[index], y[index], z[index]);
     if (index != 0)
     {
       // Make sure the length from the center of our circle to the test point is 
       // at or below our max distance.
       double distance_from_center = utilities::get_cartesian_distance(current_point.x, current_point.y, center.x, center.y);
       if (allow_3d_arcs) {
-        double z1 = points[index - 1].z;
+        double z1 = z[index - 1];
         double z2 = current_point.z;
 
         double current_z_stepper_distance = (z2 - z1) / distance_from_center;
@@ -354,7 +633,7 @@ bool circle::is_over_deviation(const array_list<printer_point>& points, const do
     
     // Check the point perpendicular from the segment to the circle's center, if any such point exists
     
-    if (segment::get_closest_perpendicular_point(current_point, points[index + 1], center, point_to_test))
+    if (segment::get_closest_perpendicular_point(current_point, point(x[index + 1], y[index + 1], z[index + 1]), center, point_to_test))
     {
       double distance = utilities::get_cartesian_distance(point_to_test.x, point_to_test.y, center.x, center.y);
       if (utilities::abs(distance - radius) > resolution_mm)
@@ -365,6 +644,74 @@ bool circle::is_over_deviation(const array_list<printer_point>& points, const do
   }
   return false;
 }
+bool circle::is_over_deviation(const printer_point_list& points, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs, circle_deviation_cache* p_deviation_cache)
+{
+  if (p_deviation_cache == NULL)
+  {
+    return is_over_deviation(points, resolution_mm, xyz_tolerance, allow_3d_arcs);
+  }
+  circle_deviation_cache& cache = *p_deviation_cache;
+  if (allow_3d_arcs)
+  {
+    // The z step check depends on every point's distance from the center, so it can't be bounded.  Check everything.
+    cache.clear();
+    return is_over_deviation(points, resolution_mm, xyz_tolerance, allow_3d_arcs);
+  }
+
+  int count = points.count();
+  double max_deviation;
+  if (cache.is_valid && cache.point_count > 1 && cache.point_count <= count)
+  {
+    double shift = utilities::get_cartesian_distance(center.x, center.y, cache.checked_circle.center.x, cache.checked_circle.center.y)
+      + utilities::abs(radius - cache.checked_circle.radius);
+    if (cache.max_deviation + shift < resolution_mm - CIRCLE_DEVIATION_CACHE_MARGIN)
+    {
+      // Every point and segment that was checked is still within the resolution of this circle.  Only check the
+      // previous endpoint, which is now an interior point, and everything after it.
+      if (!try_get_max_deviation(points, cache.point_count - 1, resolution_mm, max_deviation))
+      {
+        return true;
+      }
+      // The new points are within max_deviation + shift of the cached circle
+      if (cache.max_deviation < max_deviation + shift)
+      {
+        cache.max_deviation = max_deviation + shift;
+      }
+      cache.point_count = count;
+      return false;
+    }
+  }
+
+  // The circle moved too far, check everything.
+  if (!try_get_max_deviation(points, 0, resolution_mm, max_deviation))
+  {
+    return true;
+  }
+  cache.is_valid = true;
+  cache.checked_circle = *this;
+  cache.max_deviation = max_deviation;
+  cache.point_count = count;
+  return false;
+}
+
+bool circle::try_get_max_deviation(const printer_point_list& points, int start_index, const double resolution_mm, double& max_deviation) const
+{
+  // This performs the same checks as is_over_deviation (without the z step check) on the points starting at
+  // start_index and the segments that follow them.
+  max_deviation = 0;
+  int max_index = points.count() - 1;
+  if (start_index >= max_index)
+  {
+    return true;
+  }
+  const double* x = points.get_x() + start_index;
+  const double* y = points.get_y() + start_index;
+  int num_points = max_index - start_index + 1;
+  // Skip the first point since it will fit perfectly.
+  int skip = start_index == 0 ? 1 : 0;
+  return deviation_kernels::try_get_max_point_deviation(x + skip, y + skip, num_points - 1 - skip, center.x, center.y, radius, resolution_mm, max_deviation)
+    && deviation_kernels::try_get_max_segment_deviation(x, y, num_points, center.x, center.y, radius, resolution_mm, max_deviation);
+}
 #pragma endregion Circle Functions
 
 #pragma region Arc Functions
@@ -508,7 +855,7 @@ bool arc::try_create_arc(
 }
 
 bool arc::try_create_arc(
-  const array_list<printer_point>& points,
+  const printer_point_list& points,
   arc& target_arc,
   double approximate_length,
   double max_radius_mm,
@@ -517,11 +864,13 @@ bool arc::try_create_arc(
   int min_arc_segments,
   double mm_per_arc_segment,
   double xyz_tolerance,
-  bool allow_3d_arcs)
+  bool allow_3d_arcs,
+  circle_deviation_cache* p_deviation_cache,
+  circle_least_squares_buffers* p_least_squares_buffers)
 {
   circle test_circle = (circle)target_arc;
 
-  if (!circle::try_create_circle(points, max_radius_mm, resolution_mm, xyz_tolerance, allow_3d_arcs, test_circle))
+  if (!circle::try_create_circle(points, max_radius_mm, resolution_mm, xyz_tolerance, allow_3d_arcs, test_circle, p_deviation_cache, p_least_squares_buffers))
   {
     return false;
   }
@@ -543,7 +892,7 @@ bool arc::try_create_arc(
   return false;
 }
 
-bool arc::are_points_within_slice(const arc& test_arc, const array_list<printer_point>& points)
+bool arc::are_points_within_slice(const arc& test_arc, const printer_point_list& points)
 {
 
 
@@ -680,6 +1029,280 @@ bool arc::ray_intersects_segment(const point rayOrigin, const point rayDirection
 
 #pragma endregion
 
+#pragma region Bezier Functions
+
+point bezier::get_point(double t) const
+{
+  double mt = 1.0 - t;
+  double b0 = mt * mt * mt;
+  double b1 = 3.0 * t * mt * mt;
+  double b2 = 3.0 * t * t * mt;
+  double b3 = t * t * t;
+  return point(
+    b0 * start_point.x + b1 * control_point_1.x + b2 * control_point_2.x + b3 * end_point.x,
+    b0 * start_point.y + b1 * control_point_1.y + b2 * control_point_2.y + b3 * end_point.y,
+    start_point.z
+  );
+}
+
+point bezier::get_first_derivative(double t) const
+{
+  double mt = 1.0 - t;
+  double d0 = 3.0 * mt * mt;
+  double d1 = 6.0 * mt * t;
+  double d2 = 3.0 * t * t;
+  return point(
+    d0 * (control_point_1.x - start_point.x) + d1 * (control_point_2.x - control_point_1.x) + d2 * (end_point.x - control_point_2.x),
+    d0 * (control_point_1.y - start_point.y) + d1 * (control_point_2.y - control_point_1.y) + d2 * (end_point.y - control_point_2.y),
+    0
+  );
+}
+
+point bezier::get_second_derivative(double t) const
+{
+  double d0 = 6.0 * (1.0 - t);
+  double d1 = 6.0 * t;
+  return point(
+    d0 * (control_point_2.x - 2.0 * control_point_1.x + start_point.x) + d1 * (end_point.x - 2.0 * control_point_2.x + control_point_1.x),
+    d0 * (control_point_2.y - 2.0 * control_point_1.y + start_point.y) + d1 * (end_point.y - 2.0 * control_point_2.y + control_point_1.y),
+    0
+  );
+}
+
+double bezier::get_i() const
+{
+  return control_point_1.x - start_point.x;
+}
+
+double bezier::get_j() const
+{
+  return control_point_1.y - start_point.y;
+}
+
+double bezier::get_p() const
+{
+  return control_point_2.x - end_point.x;
+}
+
+double bezier::get_q() const
+{
+  return control_point_2.y - end_point.y;
+}
+
+bool bezier::try_fit_control_points(const printer_point_list& points, const std::vector<double>& parameters, double xyz_tolerance, bezier& target_bezier)
+{
+  // The end points are fixed, so find the control points that minimize the squared distance between each point
+  // and the curve at its parameter.  x and y are independent, and each is a 2x2 linear system.
+  const double* x = points.get_x();
+  const double* y = points.get_y();
+  int end_index = points.count() - 1;
+  double x0 = x[0], y0 = y[0], x3 = x[end_index], y3 = y[end_index];
+  double a11 = 0, a12 = 0, a22 = 0, rx1 = 0, rx2 = 0, ry1 = 0, ry2 = 0;
+  for (int index = 1; index < end_index; index++)
+  {
+    double t = parameters[index];
+    double mt = 1.0 - t;
+    double b0 = mt * mt * mt;
+    double b1 = 3.0 * t * mt * mt;
+    double b2 = 3.0 * t * t * mt;
+    double b3 = t * t * t;
+    double ex = x[index] - b0 * x0 - b3 * x3;
+    double ey = y[index] - b0 * y0 - b3 * y3;
+    a11 += b1 * b1;
+    a12 += b1 * b2;
+    a22 += b2 * b2;
+    rx1 += b1 * ex;
+    rx2 += b2 * ex;
+    ry1 += b1 * ey;
+    ry2 += b2 * ey;
+  }
+  // Pull the control points very slightly toward those of a straight line, else a single interior point would
+  // leave the system without a unique solution.
+  double weight = BEZIER_REGULARIZATION * (a11 + a22);
+  a11 += weight;
+  a22 += weight;
+  rx1 += weight * (x0 + (x3 - x0) / 3.0);
+  rx2 += weight * (x0 + 2.0 * (x3 - x0) / 3.0);
+  ry1 += weight * (y0 + (y3 - y0) / 3.0);
+  ry2 += weight * (y0 + 2.0 * (y3 - y0) / 3.0);
+  double determinant = a11 * a22 - a12 * a12;
+  if (!(determinant > 0))
+  {
+    return false;
+  }
+  double c1x = (a22 * rx1 - a12 * rx2) / determinant;
+  double c1y = (a22 * ry1 - a12 * ry2) / determinant;
+  double c2x = (a11 * rx2 - a12 * rx1) / determinant;
+  double c2y = (a11 * ry2 - a12 * ry1) / determinant;
+
+  // The control points are written as offsets from the end points, so round them the same way here in order to
+  // check the curve that will actually be printed.
+  target_bezier.control_point_1.x = x0 + utilities::floor((c1x - x0) / xyz_tolerance + 0.5) * xyz_tolerance;
+  target_bezier.control_point_1.y = y0 + utilities::floor((c1y - y0) / xyz_tolerance + 0.5) * xyz_tolerance;
+  target_bezier.control_point_2.x = x3 + utilities::floor((c2x - x3) / xyz_tolerance + 0.5) * xyz_tolerance;
+  target_bezier.control_point_2.y = y3 + utilities::floor((c2y - y3) / xyz_tolerance + 0.5) * xyz_tolerance;
+  target_bezier.control_point_1.z = target_bezier.start_point.z;
+  target_bezier.control_point_2.z = target_bezier.start_point.z;
+  return true;
+}
+
+bool bezier::try_create_bezier(
+  const printer_point_list& points,
+  bezier& target_bezier,
+  std::vector<double>& parameters,
+  double approximate_length,
+  double resolution_mm,
+  double path_tolerance_percent,
+  double xyz_tolerance)
+{
+  int num_points = points.count();
+  if (num_points < 3)
+  {
+    return false;
+  }
+  const double* x = points.get_x();
+  const double* y = points.get_y();
+  int end_index = num_points - 1;
+
+  // Start by giving each point its share of the path length
+  if (static_cast<int>(parameters.size()) < num_points)
+  {
+    parameters.resize(num_points * 2);
+  }
+  double path_length = 0;
+  parameters[0] = 0;
+  for (int index = 1; index < num_points; index++)
+  {
+    path_length += utilities::get_cartesian_distance(x[index - 1], y[index - 1], x[index], y[index]);
+    parameters[index] = path_length;
+  }
+  if (utilities::is_zero(path_length))
+  {
+    return false;
+  }
+  for (int index = 1; index < end_index; index++)
+  {
+    parameters[index] /= path_length;
+  }
+  parameters[end_index] = 1.0;
+
+  bezier test_bezier;
+  test_bezier.start_point = points[0];
+  test_bezier.end_point = points[end_index];
+
+  for (int iteration = 0; ; iteration++)
+  {
+    if (!try_fit_control_points(points, parameters, xyz_tolerance, test_bezier))
+    {
+      return false;
+    }
+    // The distance from a point to the curve at its parameter is never less than the distance to the curve itself.
+    bool is_within_resolution = true;
+    for (int index = 1; index < end_index; index++)
+    {
+      point p = test_bezier.get_point(parameters[index]);
+      if (utilities::get_cartesian_distance(p.x, p.y, x[index], y[index]) > resolution_mm)
+      {
+        is_within_resolution = false;
+        break;
+      }
+    }
+    if (is_within_resolution)
+    {
+      break;
+    }
+    if (iteration == BEZIER_MAX_REPARAMETERIZATIONS)
+    {
+      return false;
+    }
+    // Move each parameter toward the closest point on the curve with a newton step, and fit again.
+    for (int index = 1; index < end_index; index++)
+    {
+      double t = parameters[index];
+      point p = test_bezier.get_point(t);
+      point d1 = test_bezier.get_first_derivative(t);
+      point d2 = test_bezier.get_second_derivative(t);
+      double dx = p.x - x[index];
+      double dy = p.y - y[index];
+      double denominator = d1.x * d1.x + d1.y * d1.y + dx * d2.x + dy * d2.y;
+      if (denominator > 0)
+      {
+        parameters[index] = t - (dx * d1.x + dy * d1.y) / denominator;
+      }
+    }
+    for (int index = 1; index < num_points; index++)
+    {
+      // The points must stay in order along the curve
+      if (!(parameters[index] > parameters[index - 1]))
+      {
+        return false;
+      }
+    }
+  }
+
+  // Check the curve between each pair of points against the segment joining them.  The second derivative of a cubic
+  // is linear, so between two samples h apart the curve can't stray more than max|B''| * h^2 / 8 from the line
+  // joining them, and that line is no further from the segment than the samples are.
+  double curve_length = 0;
+  point previous_sample = test_bezier.start_point;
+  for (int index = 0; index < end_index; index++)
+  {
+    double t_start = parameters[index];
+    double t_end = parameters[index + 1];
+    double step = (t_end - t_start) / (BEZIER_SAMPLES_PER_SEGMENT + 1);
+    point d2_start = test_bezier.get_second_derivative(t_start);
+    point d2_end = test_bezier.get_second_derivative(t_end);
+    double max_d2 = utilities::max(utilities::hypot(d2_start.x, d2_start.y), utilities::hypot(d2_end.x, d2_end.y));
+    point segment_start(x[index], y[index], 0);
+    point segment_end(x[index + 1], y[index + 1], 0);
+    double max_sample_deviation = segment::get_distance(segment_start, segment_end, previous_sample);
+    for (int sample_index = 1; sample_index <= BEZIER_SAMPLES_PER_SEGMENT + 1; sample_index++)
+    {
+      point sample = test_bezier.get_point(sample_index == BEZIER_SAMPLES_PER_SEGMENT + 1 ? t_end : t_start + step * sample_index);
+      double deviation = segment::get_distance(segment_start, segment_end, sample);
+      if (deviation > max_sample_deviation)
+      {
+        max_sample_deviation = deviation;
+      }
+      curve_length += utilities::get_cartesian_distance(previous_sample.x, previous_sample.y, sample.x, sample.y);
+      previous_sample = sample;
+    }
+    if (max_sample_deviation + max_d2 * step * step / 8.0 > resolution_mm)
+    {
+      return false;
+    }
+  }
+
+  double path_difference_percent = utilities::get_percent_change(curve_length, approximate_length);
+  if (!utilities::is_zero(path_difference_percent, path_tolerance_percent))
+  {
+    return false;
+  }
+
+  // Firmware spreads the extrusion evenly over the parameter of the curve rather than its length, so the speed
+  // along the curve must be nearly constant, else the extrusion rate would vary along it.
+  for (int index = 0; index < end_index; index++)
+  {
+    double t_start = parameters[index];
+    double step = (parameters[index + 1] - t_start) / (BEZIER_SAMPLES_PER_SEGMENT + 1);
+    for (int sample_index = 0; sample_index <= BEZIER_SAMPLES_PER_SEGMENT; sample_index++)
+    {
+      point d1 = test_bezier.get_first_derivative(t_start + step * sample_index);
+      double rate_change_percent = utilities::get_percent_change(curve_length, utilities::hypot(d1.x, d1.y));
+      if (!utilities::is_zero(rate_change_percent, path_tolerance_percent))
+      {
+        return false;
+      }
+    }
+  }
+
+  test_bezier.length = curve_length;
+  target_bezier = test_bezier;
+  return true;
+}
+
+#pragma endregion Bezier Functions
+
 segmented_shape::segmented_shape(int min_segments, int max_segments, double resolution_mm, double path_tolerance_percnet, unsigned char default_xyz_precision, unsigned char default_e_precision) : points_(max_segments)
 {
 
@@ -696,6 +1319,7 @@ segmented_shape::segmented_shape(int min_segments, int max_segments, double reso
 
   original_shape_length_ = 0;
   is_extruding_ = true;
+  compact_output_ = false;
 }
 
 segmented_shape::~segmented_shape()
@@ -773,6 +1397,7 @@ segmented_shape& segmented_shape::operator=(const segmented_shape& obj)
   is_shape_ = obj.is_shape_;
   max_segments_ = obj.max_segments_;
   resolution_mm_ = obj.resolution_mm_;
+  compact_output_ = obj.compact_output_;
   return *this;
 }
 
@@ -829,8 +1454,22 @@ double segmented_shape::get_path_tolerance_percent()
 
 void segmented_shape::set_resolution_mm(double resolution_mm)
 {
-  resolution_mm_ = resolution_mm;
+  resolution_mm_ = resolution_mm / 2.0; // divide by 2 because it is + or - 1/2 of the desired resolution.
+}
+
+void segmented_shape::set_path_tolerance_percent(double path_tolerance_percent)
+{
+  path_tolerance_percent_ = path_tolerance_percent;
+}
 
+void segmented_shape::set_compact_output(bool compact_output)
+{
+  compact_output_ = compact_output;
+}
+
+bool segmented_shape::get_compact_output() const
+{
+  return compact_output_;
 }
 printer_point segmented_shape::pop_front()
 {
@@ -27,6 +27,7 @@
 #include <limits>
 
 #include <list> 
+#include <vector>
 #include "utilities.h"
 #include "array_list.h"
 // The minimum theta value allowed between any two arc in order for an arc to be
@@ -36,6 +37,7 @@
 #define DEFAULT_E_PRECISION 5
 #define ARC_LENGTH_PERCENT_TOLERANCE_DEFAULT 0.05  // one percent
 #define DEFAULT_MAX_GCODE_LENGTH 0 // the maximum gcode length ( < 1 = unlimited)
+#define DEFAULT_REDUCE_PRECISION_TO_FIT false // lower the precision of arcs that are longer than the maximum gcode length
 struct point
 {
 public:
@@ -52,16 +54,65 @@ public:
 struct printer_point : point
 {
 public:
-	printer_point() :point(0, 0, 0), e_relative(0), distance(0), is_extruder_relative(false), e_offset(0), f(0) {}
-	printer_point(double x, double y, double z, double e_offset, double e_relative, double f, double distance, bool is_extruder_relative)
-		: point(x,y,z), e_offset(e_offset), e_relative(e_relative), f(f), distance(distance), is_extruder_relative(is_extruder_relative) {}
+	printer_point() :point(0, 0, 0), e_relative(0), distance(0), is_extruder_relative(false), is_xyz_relative(false), e_offset(0), f(0) {}
+	printer_point(double x, double y, double z, double e_offset, double e_relative, double f, double distance, bool is_extruder_relative, bool is_xyz_relative = false)
+		: point(x,y,z), e_offset(e_offset), e_relative(e_relative), f(f), distance(distance), is_extruder_relative(is_extruder_relative), is_xyz_relative(is_xyz_relative) {}
 	bool is_extruder_relative;
+	// If true, the XYZ axis is in relative mode (G91), and the shape endpoint must be written relative to the start point.
+	bool is_xyz_relative;
 	double e_offset;
 	double e_relative;
 	double f;
 	double distance;
 };
 
+// A list of printer points stored as a structure of arrays.  The coordinates are kept in separate contiguous arrays,
+// in order, so that the circle fitting and deviation checks can scan (and vectorize over) them directly.  The
+// extrusion data for each point is kept alongside.  Like array_list, points are added to the back and can be removed
+// from either end, and the list must be resized before it is full.
+class printer_point_list
+{
+public:
+	printer_point_list(int max_size);
+	printer_point_list(const printer_point_list& source);
+	virtual ~printer_point_list();
+	printer_point_list& operator=(const printer_point_list& source);
+	int count() const;
+	int get_max_size() const;
+	void resize(int max_size);
+	void clear();
+	void copy(const printer_point_list& source);
+	void push_back(const printer_point& p);
+	printer_point pop_front();
+	printer_point pop_back();
+	printer_point operator[](int index) const;
+	// The coordinates of the points in the list.  These are invalidated by any change to the list.
+	const double* get_x() const;
+	const double* get_y() const;
+	const double* get_z() const;
+private:
+	struct extrusion_data
+	{
+		double e_offset;
+		double e_relative;
+		double f;
+		double distance;
+		bool is_extruder_relative;
+		bool is_xyz_relative;
+	};
+	void allocate(int max_size);
+	void release();
+	// Moves the points to the start of the arrays
+	void compact();
+	double* x_;
+	double* y_;
+	double* z_;
+	extrusion_data* extrusion_;
+	int front_index_;
+	int count_;
+	int max_size_;
+};
+
 struct segment
 {
 	segment()
@@ -83,6 +134,8 @@ struct segment
 
 	bool get_closest_perpendicular_point(point c, point& d);
 	static bool get_closest_perpendicular_point(const point& p1, const point& p2, const point& c, point& d);
+	// Returns the XY distance from c to the closest point of the segment from p1 to p2
+	static double get_distance(const point& p1, const point& p2, const point& c);
 };
 
 struct vector : point
@@ -104,6 +157,13 @@ struct vector : point
 };
 
 #define DEFAULT_MAX_RADIUS_MM 9999.0 // 9.999m
+// Safety margin used when deciding if previously checked points can be skipped, so that rounding can never
+// let through a point that a full deviation check would reject.
+#define CIRCLE_DEVIATION_CACHE_MARGIN 0.000000001
+// The number of times the least squares circle is reweighted toward the minimax circle before giving up.
+#define CIRCLE_LEAST_SQUARES_MAX_REWEIGHTS 8
+struct circle_deviation_cache;
+struct circle_least_squares_buffers;
 struct circle {
 	circle() {
 		center.x = 0;
@@ -123,15 +183,54 @@ struct circle {
 
 	static bool try_create_circle(const point &p1, const point &p2, const point &p3, const double max_radius, circle& new_circle);
 	
-	static bool try_create_circle(const array_list<printer_point>& points, const double max_radius, const double resolutino_mm, const double xyz_tolerance, bool allow_3d_arcs, circle& new_circle);
+	static bool try_create_circle(const printer_point_list& points, const double max_radius, const double resolutino_mm, const double xyz_tolerance, bool allow_3d_arcs, circle& new_circle, circle_deviation_cache* p_deviation_cache = NULL, circle_least_squares_buffers* p_buffers = NULL);
+
+	// Finds the circle through the first and last points that best fits the points and segments in between, and is within the resolution.
+	// If p_buffers is NULL, temporary buffers are allocated.
+	static bool try_create_circle_least_squares(const printer_point_list& points, const double max_radius, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs, circle& new_circle, circle_deviation_cache* p_deviation_cache = NULL, circle_least_squares_buffers* p_buffers = NULL);
 
 	double get_polar_radians(const point& p1) const;
 
 	point get_closest_point(const point& p) const;
 
-	bool is_over_deviation(const array_list<printer_point>& points, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs);
+	bool is_over_deviation(const printer_point_list& points, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs);
+
+	// Same as above, but only checks the points that were added since the cached check if the circle has not moved too far.
+	// If p_deviation_cache is NULL, everything is checked.
+	bool is_over_deviation(const printer_point_list& points, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs, circle_deviation_cache* p_deviation_cache);
 	
-	bool get_deviation_sum_squared(const array_list<printer_point>& points, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs, double& sum_deviation);
+	bool get_deviation_sum_squared(const printer_point_list& points, const double resolution_mm, const double xyz_tolerance, const bool allow_3d_arcs, double& sum_deviation);
+private:
+	bool try_get_max_deviation(const printer_point_list& points, int start_index, const double resolution_mm, double& max_deviation) const;
+};
+
+// Remembers the circle the first point_count points of an arc were last fully checked against, and the largest
+// deviation found.  Moving the circle's center by d and changing its radius by r can change any of those deviations
+// by at most d + r, so a growing arc only needs to check its new points until that bound exceeds the resolution.
+struct circle_deviation_cache
+{
+	circle_deviation_cache() {
+		clear();
+	}
+	void clear()
+	{
+		is_valid = false;
+		max_deviation = 0;
+		point_count = 0;
+	}
+	bool is_valid;
+	circle checked_circle;
+	double max_deviation;
+	int point_count;
+};
+
+// The samples and weights used by circle::try_create_circle_least_squares.  Keep one of these between calls so the
+// buffers are only allocated when the point count grows.
+struct circle_least_squares_buffers
+{
+	std::vector<double> a;
+	std::vector<double> b;
+	std::vector<double> weights;
 };
 
 #define DEFAULT_RESOLUTION_MM 0.05
@@ -173,7 +272,7 @@ struct arc : circle
 	double get_i() const;
 	double get_j() const;
 	static bool try_create_arc(
-		const array_list<printer_point>& points, 
+		const printer_point_list& points, 
 		arc& target_arc, 
 		double approximate_length, 
 		double max_radius = DEFAULT_MAX_RADIUS_MM,
@@ -182,8 +281,10 @@ struct arc : circle
 		int min_arc_segments = DEFAULT_MIN_ARC_SEGMENTS,
 		double mm_per_arc_segment = DEFAULT_MM_PER_ARC_SEGMENT,
 		double xyz_tolerance = DEFAULT_XYZ_TOLERANCE,
-		bool allow_3d_arcs = DEFAULT_ALLOW_3D_ARCS);
-	static bool are_points_within_slice(const arc& test_arc, const array_list<printer_point>& points);
+		bool allow_3d_arcs = DEFAULT_ALLOW_3D_ARCS,
+		circle_deviation_cache* p_deviation_cache = NULL,
+		circle_least_squares_buffers* p_least_squares_buffers = NULL);
+	static bool are_points_within_slice(const arc& test_arc, const printer_point_list& points);
 	static bool ray_intersects_segment(const point rayOrigin, const point rayDirection, const printer_point point1, const printer_point point2);
 	private:
 		static bool try_create_arc(
@@ -198,6 +299,46 @@ struct arc : circle
 			bool allow_3d_arcs = DEFAULT_ALLOW_3D_ARCS);
 };
 
+// The number of times the parameters of the points are moved to their closest point on the curve before giving up.
+#define BEZIER_MAX_REPARAMETERIZATIONS 4
+// The number of points checked against each segment between the source points.
+#define BEZIER_SAMPLES_PER_SEGMENT 3
+// How strongly the control points are pulled toward those of a straight line, relative to the fit.
+#define BEZIER_REGULARIZATION 0.000001
+struct bezier
+{
+	bezier() {
+		length = 0;
+	}
+	// The start point, the two control points and the end point
+	printer_point start_point;
+	point control_point_1;
+	point control_point_2;
+	printer_point end_point;
+	double length;
+	point get_point(double t) const;
+	// The offset from the start point to the first control point
+	double get_i() const;
+	double get_j() const;
+	// The offset from the end point to the second control point
+	double get_p() const;
+	double get_q() const;
+	// Fits a cubic bezier curve to the points.  Every point and segment must be within the resolution of the curve,
+	// and the distance along the curve (which is how firmware spreads the extrusion) must match that of the path.
+	static bool try_create_bezier(
+		const printer_point_list& points,
+		bezier& target_bezier,
+		std::vector<double>& parameters,
+		double approximate_length,
+		double resolution = DEFAULT_RESOLUTION_MM,
+		double path_tolerance_percent = ARC_LENGTH_PERCENT_TOLERANCE_DEFAULT,
+		double xyz_tolerance = DEFAULT_XYZ_TOLERANCE);
+private:
+	static bool try_fit_control_points(const printer_point_list& points, const std::vector<double>& parameters, double xyz_tolerance, bezier& target_bezier);
+	point get_first_derivative(double t) const;
+	point get_second_derivative(double t) const;
+};
+
 #define DEFAULT_MIN_SEGMENTS 3
 #define DEFAULT_MAX_SEGMENTS 50
 
@@ -222,6 +363,10 @@ public:
 	virtual double get_shape_length();
 	double get_shape_e_relative();
 	void set_resolution_mm(double resolution_mm);
+	void set_path_tolerance_percent(double path_tolerance_percent);
+	// When enabled, numbers in the shape's gcode are written with as few characters as possible.
+	void set_compact_output(bool compact_output);
+	bool get_compact_output() const;
 	void reset_precision();
 	void update_xyz_precision(unsigned char precision);
 	void update_e_precision(unsigned char precision);
@@ -238,7 +383,7 @@ public:
 	unsigned char get_e_precision() const;
 	double get_xyz_tolerance() const;
 protected:
-	array_list<printer_point> points_;
+	printer_point_list points_;
 	void set_is_shape(bool value);
 	double original_shape_length_;	
 	double e_relative_;
@@ -246,6 +391,7 @@ protected:
 	double resolution_mm_;
 	bool is_shape_;
 	double path_tolerance_percent_;
+	bool compact_output_;
 private:
 	int min_segments_;
 	int max_segments_;
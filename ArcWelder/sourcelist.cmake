@@ -1,5 +1,7 @@
 set(ArcWelderSources ${ArcWelderSources}
     arc_welder.cpp
+    deviation_kernels.cpp
     segmented_arc.cpp
+    segmented_bezier.cpp
     segmented_shape.cpp
 )
\ No newline at end of file
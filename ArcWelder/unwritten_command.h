@@ -25,6 +25,7 @@
 #pragma once
 #include "parsed_command.h"
 #include "position.h"
+#include "segmented_shape.h"
 struct unwritten_command
 {
 	unwritten_command() {
@@ -35,11 +36,14 @@ struct unwritten_command
 		is_travel = false;
 		is_extrusion = false;
 		is_retraction = false;
+		is_z_unchanged = false;
+		is_f_unchanged = false;
+		feature_type_tag = 0;
 		gcode = "";
 		comment = "";
 	}
-	unwritten_command(parsed_command &cmd, bool is_relative, bool is_extrusion, bool is_retraction, bool is_travel, double command_length) 
-		: is_extruder_relative(is_relative), is_extrusion(is_extrusion), is_retraction(is_retraction), is_travel(is_travel), is_g0_g1(cmd.command == "G0" || cmd.command == "G1"), is_g2_g3(cmd.command == "G2" || cmd.command == "G3"), gcode(cmd.gcode), comment(cmd.comment), length(command_length)
+	unwritten_command(parsed_command &cmd, bool is_relative, bool is_extrusion, bool is_retraction, bool is_travel, bool z_unchanged, bool f_unchanged, double command_length, const printer_point& start, const printer_point& end, int feature_type) 
+		: is_extruder_relative(is_relative), is_extrusion(is_extrusion), is_retraction(is_retraction), is_travel(is_travel), is_z_unchanged(z_unchanged), is_f_unchanged(f_unchanged), is_g0_g1(cmd.command == "G0" || cmd.command == "G1"), is_g2_g3(cmd.command == "G2" || cmd.command == "G3"), gcode(cmd.gcode), comment(cmd.comment), length(command_length), start_point(start), end_point(end), feature_type_tag(feature_type)
 	{
 
 	}
@@ -49,17 +53,39 @@ struct unwritten_command
 	bool is_travel;
 	bool is_extrusion;
 	bool is_retraction;
+	// True if the command's Z or F parameters, if any, don't change the position, so compact output can leave them out.
+	bool is_z_unchanged;
+	bool is_f_unchanged;
 	double length;
 	std::string gcode;
 	std::string comment;
+	// The position before and after the command, used to simplify runs of moves that could not be converted to arcs.
+	printer_point start_point;
+	printer_point end_point;
+	int feature_type_tag;
 
-	std::string to_string()
+	// True for the moves that can be replaced by an arc or curve.
+	bool is_shape_move() const
 	{
+		return is_g0_g1 || is_g2_g3;
+	}
+
+	std::string to_string() const
+	{
+		std::string line;
+		append_to(line);
+		return line;
+	}
+
+	// Appends the command and its comment to the end of buffer without building a temporary string.
+	void append_to(std::string& buffer) const
+	{
+		buffer += gcode;
 		if (comment.size() > 0)
 		{
-			return gcode + ";" + comment;
+			buffer += ';';
+			buffer += comment;
 		}
-		return gcode;
 	}
 };
 
@@ -27,6 +27,7 @@
 #endif
 #include "ArcWelderConsole.h"
 #include <cstring>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -109,6 +110,30 @@ int main(int argc, char* argv[])
     arg_description_stream << "(experimental) - If supplied, travel arcs will be allowed.  Default Value: " << DEFAULT_ALLOW_TRAVEL_ARCS;
     TCLAP::SwitchArg allow_travel_arcs_arg("y", "allow-travel-arcs", arg_description_stream.str(), DEFAULT_ALLOW_TRAVEL_ARCS);
 
+    // -u --allow-bezier-curves
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "(experimental) - If supplied, runs of points that don't fit an arc may be replaced with cubic bezier curves (G5).  Your firmware must support G5 (Marlin's BEZIER_CURVE_SUPPORT).  Not used with the lookahead window.  Default Value: " << DEFAULT_ALLOW_BEZIER_CURVES;
+    TCLAP::SwitchArg allow_bezier_curves_arg("u", "allow-bezier-curves", arg_description_stream.str(), DEFAULT_ALLOW_BEZIER_CURVES);
+
+    // -o --simplify-polylines
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "If supplied, runs of extrusions that can't be converted to arcs will be simplified, removing points that are within half of the resolution of the simplified path.  The E value of every remaining point is unchanged.  Default Value: " << DEFAULT_SIMPLIFY_POLYLINES;
+    TCLAP::SwitchArg simplify_polylines_arg("o", "simplify-polylines", arg_description_stream.str(), DEFAULT_SIMPLIFY_POLYLINES);
+
+    // --merge-arcs
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "If supplied, consecutive G2/G3 commands in the source file that follow the same circle within the resolution are combined into a single arc, for example in files from slicers with their own arc fitting.  Not used with the lookahead window.  Default Value: " << DEFAULT_MERGE_ARCS;
+    TCLAP::SwitchArg merge_arcs_arg("", "merge-arcs", arg_description_stream.str(), DEFAULT_MERGE_ARCS);
+
+    // --weld-through-comments
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "If supplied, comment-only lines and M73, M117 and M118 commands don't end the current arc.  Lines between the moves of an arc are written just before it instead.  Layer change comments and feature comments, like ;TYPE: and ;WIDTH:, still end the arc.  Not used with the lookahead window.  Default Value: " << DEFAULT_WELD_THROUGH_COMMENTS;
+    TCLAP::SwitchArg weld_through_comments_arg("", "weld-through-comments", arg_description_stream.str(), DEFAULT_WELD_THROUGH_COMMENTS);
+
     // -d --allow-dynamic-precision
     arg_description_stream.clear();
     arg_description_stream.str("");
@@ -151,6 +176,64 @@ int main(int argc, char* argv[])
     arg_description_stream << "The maximum length allowed for a generated G2/G3 command, not including any comments.  0 = no limit.  Default Value: " << DEFAULT_MAX_GCODE_LENGTH;
     TCLAP::ValueArg<int> max_gcode_length_arg("c", "max-gcode-length", arg_description_stream.str(), false, DEFAULT_MAX_GCODE_LENGTH, "int");
 
+    // -n --reduce-precision-to-fit
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "If supplied, arcs that are longer than max-gcode-length are written with fewer decimal places instead of being aborted, as long as the rounded arc is still within the resolution.  Requires max-gcode-length.  Default Value: " << DEFAULT_REDUCE_PRECISION_TO_FIT;
+    TCLAP::SwitchArg reduce_precision_to_fit_arg("n", "reduce-precision-to-fit", arg_description_stream.str(), DEFAULT_REDUCE_PRECISION_TO_FIT);
+
+    // -w --lookahead-window
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "(experimental) - The number of points to buffer before choosing where arcs start and end, which can reduce the number of commands compared to creating each arc as soon as possible.  Around 50 works well.  0 = disabled.  Default Value: " << DEFAULT_LOOKAHEAD_WINDOW;
+    TCLAP::ValueArg<int> lookahead_window_arg("w", "lookahead-window", arg_description_stream.str(), false, DEFAULT_LOOKAHEAD_WINDOW, "int");
+
+    // -b --lookahead-minimize-bytes
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "(experimental) - If supplied, the lookahead window will minimize the number of bytes written instead of the number of commands.  Requires lookahead-window.  Default Value: " << DEFAULT_LOOKAHEAD_MINIMIZE_BYTES;
+    TCLAP::SwitchArg lookahead_minimize_bytes_arg("b", "lookahead-minimize-bytes", arg_description_stream.str(), DEFAULT_LOOKAHEAD_MINIMIZE_BYTES);
+
+    // -k --compact-output
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "If supplied, the output is written with as few bytes as possible:  numbers are written without trailing zeros or a leading zero (.5 instead of 0.500), Z and F are left out of moves when they don't change, and arcs use R instead of I and J when it is shorter and just as accurate.  Your firmware must support the R form of G2/G3 (Klipper does not).  Default Value: " << DEFAULT_COMPACT_OUTPUT;
+    TCLAP::SwitchArg compact_output_arg("k", "compact-output", arg_description_stream.str(), DEFAULT_COMPACT_OUTPUT);
+
+    // -q --strip-comments
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "If supplied, comments are removed from the output, except for the ArcWelder header.  Note that some printers and print monitors rely on slicer comments.  Default Value: " << DEFAULT_STRIP_COMMENTS;
+    TCLAP::SwitchArg strip_comments_arg("q", "strip-comments", arg_description_stream.str(), DEFAULT_STRIP_COMMENTS);
+
+    // -j --meatpack
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "If supplied, the target file is MeatPack encoded, which roughly halves the number of bytes a print host sends over a serial connection.  Comments and blank lines are removed.  The file must be sent as is by a host that doesn't change the lines, to firmware with MeatPack support (Marlin with MEATPACK_ON_SERIAL_PORT_1 or the Prusa firmware).  Default Value: " << DEFAULT_MEATPACK_OUTPUT;
+    TCLAP::SwitchArg meatpack_output_arg("j", "meatpack", arg_description_stream.str(), DEFAULT_MEATPACK_OUTPUT);
+
+    // --meatpack-no-spaces
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "If supplied, MeatPack output also removes the spaces from G commands, and packs E instead of the space character.  Requires meatpack.  Default Value: " << DEFAULT_MEATPACK_NO_SPACES;
+    TCLAP::SwitchArg meatpack_no_spaces_arg("", "meatpack-no-spaces", arg_description_stream.str(), DEFAULT_MEATPACK_NO_SPACES);
+
+    // --line-numbers
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "If supplied, every line of the target file is written with a line number and checksum (N<line> ... *<checksum>), so that a print host can send it to the printer as is.  Comments and blank lines are removed.  Default Value: " << DEFAULT_LINE_NUMBERS;
+    TCLAP::SwitchArg line_numbers_arg("", "line-numbers", arg_description_stream.str(), DEFAULT_LINE_NUMBERS);
+
+    // -f --feature-tolerance
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "Overrides the resolution, path tolerance percent and maximum arc radius for a single feature type, in the form feature:resolution_mm[,path_tolerance_percent[,max_radius_mm]].  Leave a value empty to keep the default, for example --feature-tolerance=infill:0.1,,5000.  May be supplied once per feature.  Feature types are only known if the slicer adds feature comments.  Features:";
+    for (int feature_type = 0; feature_type < NUM_FEATURE_TYPES; feature_type++)
+    {
+      arg_description_stream << " " << feature_type_name[feature_type].substr(0, feature_type_name[feature_type].length() - 8);
+    }
+    TCLAP::MultiArg<std::string> feature_tolerance_arg("f", "feature-tolerance", arg_description_stream.str(), false, "string");
+
     // -p --progress-type
     std::vector<std::string> progress_type_vector;
     std::string progress_type_default_string = PROGRESS_TYPE_SIMPLE;
@@ -190,11 +273,24 @@ int main(int argc, char* argv[])
     cmd.add(mm_per_arc_segment_arg);
     cmd.add(allow_3d_arcs_arg);
     cmd.add(allow_travel_arcs_arg);
+    cmd.add(allow_bezier_curves_arg);
+    cmd.add(simplify_polylines_arg);
+    cmd.add(merge_arcs_arg);
+    cmd.add(weld_through_comments_arg);
     cmd.add(allow_dynamic_precision_arg);
     cmd.add(default_xyz_precision_arg);
     cmd.add(default_e_precision_arg);
     cmd.add(extrusion_rate_variance_percent_arg);
     cmd.add(max_gcode_length_arg);
+    cmd.add(reduce_precision_to_fit_arg);
+    cmd.add(lookahead_window_arg);
+    cmd.add(lookahead_minimize_bytes_arg);
+    cmd.add(compact_output_arg);
+    cmd.add(strip_comments_arg);
+    cmd.add(meatpack_output_arg);
+    cmd.add(meatpack_no_spaces_arg);
+    cmd.add(line_numbers_arg);
+    cmd.add(feature_tolerance_arg);
     cmd.add(g90_arg);
     cmd.add(progress_type_arg);
     cmd.add(log_level_arg);
@@ -218,12 +314,25 @@ int main(int argc, char* argv[])
     args.path_tolerance_percent = path_tolerance_percent_arg.getValue();
     args.allow_3d_arcs = allow_3d_arcs_arg.getValue();
     args.allow_travel_arcs = allow_travel_arcs_arg.getValue();
+    args.allow_bezier_curves = allow_bezier_curves_arg.getValue();
+    args.simplify_polylines = simplify_polylines_arg.getValue();
+    args.merge_arcs = merge_arcs_arg.getValue();
+    args.weld_through_comments = weld_through_comments_arg.getValue();
     args.g90_g91_influences_extruder = g90_arg.getValue();
     args.allow_dynamic_precision = allow_dynamic_precision_arg.getValue();
     unsigned int xyz_precision = default_xyz_precision_arg.getValue();
     unsigned int e_precision = default_e_precision_arg.getValue();
     args.extrusion_rate_variance_percent = extrusion_rate_variance_percent_arg.getValue();
     args.max_gcode_length = max_gcode_length_arg.getValue();
+    args.reduce_precision_to_fit = reduce_precision_to_fit_arg.getValue();
+    args.lookahead_window = lookahead_window_arg.getValue();
+    args.lookahead_minimize_bytes = lookahead_minimize_bytes_arg.getValue();
+    args.compact_output = compact_output_arg.getValue();
+    args.strip_comments = strip_comments_arg.getValue();
+    args.meatpack_output = meatpack_output_arg.getValue();
+    args.meatpack_no_spaces = meatpack_no_spaces_arg.getValue();
+    args.line_numbers = line_numbers_arg.getValue();
+    std::vector<std::string> feature_tolerances = feature_tolerance_arg.getValue();
     progress_type = progress_type_arg.getValue();
     log_level_string = log_level_arg.getValue();
     log_level_value = -1;
@@ -319,6 +428,28 @@ int main(int argc, char* argv[])
       args.max_gcode_length = DEFAULT_MAX_GCODE_LENGTH;
     }
 
+    if (args.lookahead_window < 0)
+    {
+      // warning
+      std::cout << "warning: The provided lookahead_window " << args.lookahead_window << " is less than 0.  Setting to the default (disabled)." << std::endl;
+      args.lookahead_window = DEFAULT_LOOKAHEAD_WINDOW;
+    }
+
+    if (args.meatpack_no_spaces && !args.meatpack_output)
+    {
+      // warning
+      std::cout << "warning: meatpack-no-spaces has no effect unless meatpack is supplied." << std::endl;
+    }
+
+    for (std::vector<std::string>::const_iterator it = feature_tolerances.begin(); it != feature_tolerances.end(); it++)
+    {
+      if (!try_parse_feature_tolerance(*it, args))
+      {
+        std::cerr << "error: The provided feature tolerance '" << *it << "' is not valid.  Use feature:resolution_mm[,path_tolerance_percent[,max_radius_mm]] with a known feature and positive values." << std::endl;
+        has_error = true;
+      }
+    }
+
     if (has_error)
     {
       return 1;
@@ -449,3 +580,45 @@ bool on_progress_suppress(arc_welder_progress progress, logger* p_logger, int lo
   return true;
 }
 
+bool try_parse_feature_tolerance(const std::string& value, arc_welder_args& args)
+{
+  // feature:resolution_mm[,path_tolerance_percent[,max_radius_mm]], where empty values are not overridden
+  size_t separator_index = value.find(':');
+  if (separator_index == std::string::npos)
+  {
+    return false;
+  }
+  int feature_type = feature_tolerance::get_feature_type(value.substr(0, separator_index));
+  if (feature_type < 0)
+  {
+    return false;
+  }
+  double values[3] = { -1, -1, -1 };
+  size_t start_index = separator_index + 1;
+  for (int value_index = 0; value_index < 3; value_index++)
+  {
+    size_t end_index = value.find(',', start_index);
+    std::string text = value.substr(start_index, end_index == std::string::npos ? std::string::npos : end_index - start_index);
+    if (text.length() > 0)
+    {
+      char* p_end;
+      values[value_index] = std::strtod(text.c_str(), &p_end);
+      if (*p_end != '\0' || values[value_index] < 0 || (value_index != 1 && values[value_index] == 0))
+      {
+        return false;
+      }
+    }
+    if (end_index == std::string::npos)
+    {
+      break;
+    }
+    if (value_index == 2)
+    {
+      // Too many values
+      return false;
+    }
+    start_index = end_index + 1;
+  }
+  args.feature_tolerances[feature_type] = feature_tolerance(values[0], values[1], values[2]);
+  return true;
+}
@@ -28,5 +28,6 @@
 static bool on_progress_full(arc_welder_progress progress, logger* p_logger, int logger_type);
 static bool on_progress_simple(arc_welder_progress progress, logger* p_logger, int logger_type);
 static bool on_progress_suppress(arc_welder_progress progress, logger* p_logger, int logger_type);
+static bool try_parse_feature_tolerance(const std::string& value, arc_welder_args& args);
 
 
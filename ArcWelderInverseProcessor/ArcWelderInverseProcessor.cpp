@@ -139,6 +139,12 @@ int run_arc_straightener(int argc, char* argv[])
     arg_description_stream << "Sets the firmware's G90/G91 influences extruder axis behavior.  By default this is determined by the firmware's behavior.  Default Value: " << g90_g91_influences_extruder_default_value;
     TCLAP::ValueArg<std::string> g90_arg("g", "g90-influences-extruder", arg_description_stream.str(), false, g90_g91_influences_extruder_default_value, &g90_g91_influences_extruder_constraint);
 
+    // --line-numbers
+    arg_description_stream.clear();
+    arg_description_stream.str("");
+    arg_description_stream << "If supplied, every line of the target file is written with a line number and checksum (N<line> ... *<checksum>), so that a print host can send it to the printer as is.  Comments and blank lines are removed.";
+    TCLAP::SwitchArg line_numbers_arg("", "line-numbers", arg_description_stream.str());
+
     // -m --mm-per-arc-segment
     arg_description_stream.clear();
     arg_description_stream.str("");
@@ -228,6 +234,7 @@ int run_arc_straightener(int argc, char* argv[])
     cmd.add(min_arc_segment_mm_arg);
     cmd.add(max_arc_segment_mm_arg);
     cmd.add(print_firmware_defaults_arg);
+    cmd.add(line_numbers_arg);
 
     // First, we need to see if the user wants to print firmware defaults
     help_cmd.add(firmware_type_arg);
@@ -313,6 +320,7 @@ int run_arc_straightener(int argc, char* argv[])
     // Get the value parsed by each arg. 
     args.source_path = source_arg.getValue();
     args.target_path = target_arg.getValue();
+    args.line_numbers = line_numbers_arg.getValue();
     if (args.target_path.size() == 0)
     {
       args.target_path = args.source_path;
@@ -596,6 +604,7 @@ bool is_firmware_version_valid_for_type(std::string firmware_type_string, std::s
         }
         break;
     }
+    return true;
 }
 
 void print_firmware_defaults(std::string firmware_type_string, std::string firmware_version_string, std::string firmware_version_arg_name)
@@ -72,6 +72,8 @@ gcode_position_args arc_interpolation::get_args_(bool g90_g91_influences_extrude
   args.y_max = 9999;
   args.z_min = -9999;
   args.z_max = 9999;
+  // Only motion and extruder state are needed, skip layer, height, zhop and bounds tracking.
+  args.tracking_type = position_tracking_type_motion;
   return args;
 }
 
@@ -114,6 +116,20 @@ arc_interpolation::~arc_interpolation()
  
 }
 
+void arc_interpolation::write_gcode_(const std::string& gcode)
+{
+  if (args_.line_numbers)
+  {
+    // The interpolated segments are written as several lines at once
+    numbered_buffer_.clear();
+    line_number_encoder_.append_numbered(gcode, numbered_buffer_);
+    line_number_encoder_.append_numbered("\n", 1, numbered_buffer_);
+    output_file_ << numbered_buffer_;
+    return;
+  }
+  output_file_ << gcode << "\n";
+}
+
 void arc_interpolation::process()
 {
   // Create a stringstream we can use for messaging.
@@ -138,8 +154,9 @@ void arc_interpolation::process()
   std::cout << stream.str();
   const clock_t start_clock = clock();
 
-  // Create the source file read stream and target write stream
-  std::ifstream gcode_file;
+  // Create the source file read stream and target write stream.  Compressed sources are detected from their content,
+  // and the target is compressed according to its extension.
+  compressed_ifstream gcode_file;
   gcode_file.open(args_.source_path.c_str());
   output_file_.open(args_.target_path.c_str());
   std::string line;
@@ -153,6 +170,12 @@ void arc_interpolation::process()
     if (output_file_.is_open())
     {
       parsed_command cmd;
+      if (args_.line_numbers)
+      {
+        numbered_buffer_.clear();
+        line_number_encoder_.append_start(numbered_buffer_);
+        output_file_ << numbered_buffer_;
+      }
       // Communicate every second
       while (std::getline(gcode_file, line))
       {
@@ -206,7 +229,7 @@ void arc_interpolation::process()
           r = 0;
           for (unsigned int index = 0; index < cmd.parameters.size(); index++)
           {
-            parsed_command_parameter p = cmd.parameters[index];
+            const parsed_command_parameter& p = cmd.parameters[index];
             if (p.name == "I")
             {
               i = p.double_value;
@@ -232,32 +255,46 @@ void arc_interpolation::process()
           offset_absolute_e = p_pre_pos->get_current_extruder().get_offset_e();
 
           // run the callback and capture any created gcode commands
-          std::string gcodes = p_current_firmware_->interpolate_arc(target, i, j, r, is_clockwise);
+          const std::string& gcodes = p_current_firmware_->interpolate_arc(target, i, j, r, is_clockwise);
           if (gcodes.length() > 0)
           {
             // there are gcodes to write, write them!
-            output_file_ << gcodes << "\n";
+            write_gcode_(gcodes);
           }
         }
         else
         {
           // Nothing to do with the current line, just write it to disk.
-          output_file_ << line << "\n";
+          write_gcode_(line);
         }
 
       }
+      if (!gcode_file.get_error().empty())
+      {
+        std::cout << gcode_file.get_error() << "\n";
+      }
       output_file_.close();
     }
     else
     {
-      std::cout << "Unable to open the output file for writing.\n";
+      std::cout << "Unable to open the output file for writing.";
+      if (!output_file_.get_error().empty())
+      {
+        std::cout << "  " << output_file_.get_error();
+      }
+      std::cout << "\n";
     }
     std::cout << "Closing the input file.\n";
     gcode_file.close();
   }
   else
   {
-    std::cout << "Unable to open the gcode file for processing.\n";
+    std::cout << "Unable to open the gcode file for processing.";
+    if (!gcode_file.get_error().empty())
+    {
+      std::cout << "  " << gcode_file.get_error();
+    }
+    std::cout << "\n";
   }
 
   const clock_t end_clock = clock();
@@ -37,6 +37,8 @@
 #include <cstring>
 #include <fstream>
 #include "gcode_position.h"
+#include "line_numbers.h"
+#include "compressed_file.h"
 
 #define DEFAULT_GCODE_BUFFER_SIZE 50
 struct arc_interpolation_args
@@ -46,6 +48,7 @@ struct arc_interpolation_args
 		
 		source_path = "";
 		target_path = "";
+		line_numbers = false;
 	}
 	/// <summary>
 	/// Firmware arguments.  Not all options will apply to all firmware types.
@@ -59,6 +62,10 @@ struct arc_interpolation_args
 	/// Optional: the path to the target file.  If left blank the source file will be overwritten by the target.
 	/// </summary>
 	std::string target_path;
+	/// <summary>
+	/// Optional: write every line with a line number and checksum, so that a print host can send the file as is.
+	/// </summary>
+	bool line_numbers;
 	
 };
 
@@ -78,13 +85,16 @@ class arc_interpolation
 	private:
 			arc_interpolation_args args_;
 			gcode_position_args get_args_(bool g90_g91_influences_extruder, int buffer_size);
+			void write_gcode_(const std::string& gcode);
 			std::string source_path_;
 			std::string target_path_;
 			gcode_position* p_source_position_;
-			std::ofstream output_file_;
+			compressed_ofstream output_file_;
 			int lines_processed_ = 0;
 			firmware* p_current_firmware_;
 			int num_arc_commands_;
+			line_number_encoder line_number_encoder_;
+			std::string numbered_buffer_;
   
 };
 
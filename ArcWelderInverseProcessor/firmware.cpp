@@ -33,6 +33,7 @@
 
 #include "firmware.h"
 #include "utilities.h"
+#include <cmath>
 
 firmware::firmware() {
   version_index_ = -1;
@@ -44,7 +45,7 @@ firmware::firmware(firmware_arguments args) : args_(args) {
   num_arc_segments_generated_ = 0;
 };
 
-std::string firmware::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
+const std::string& firmware::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
 {
   throw "Function not yet implemented";
 }
@@ -69,53 +70,69 @@ int firmware::get_num_arc_segments_generated()
   return num_arc_segments_generated_;
 }
 
-std::string firmware::g1_command(firmware_position& target)
+void firmware::g1_command(firmware_position& target, std::string& gcode)
 {
   num_arc_segments_generated_++;
-  std::string gcode = "G1 ";
-  gcode.reserve(96);
+  gcode += "G1";
 
   bool has_x = position_.x != target.x;
   bool has_y = position_.y != target.y;
   bool has_z = position_.z != target.z;
   bool has_e = position_.e != target.e;
   bool has_f = position_.f != target.f;
-  bool is_first_parameter = true;
   if (has_x)
   {
-    gcode += is_first_parameter ? "X" : " X";
-    gcode += utilities::dtos(state_.is_relative ? target.x - position_.x : target.x, 3);
-    is_first_parameter = false;
+    append_axis_value(gcode, 'X', position_.x, target.x, state_.is_relative);
   }
 
   if (has_y)
   {
-    gcode += is_first_parameter ? "Y" : " Y";
-    gcode += utilities::dtos(state_.is_relative ? target.y - position_.y : target.y, 3);
-    is_first_parameter = false;
+    append_axis_value(gcode, 'Y', position_.y, target.y, state_.is_relative);
   }
 
   if (has_z)
   {
-    gcode += is_first_parameter ? "Z" : " Z";
-    gcode += utilities::dtos(state_.is_relative ? target.z - position_.z : target.z, 3);
-    is_first_parameter = false;
+    append_axis_value(gcode, 'Z', position_.z, target.z, state_.is_relative);
   }
 
   if (has_e)
   {
-    gcode += is_first_parameter ? "E" : " E";
-    gcode += utilities::dtos(state_.is_extruder_relative ? target.e - position_.e : target.e, 3);
-    is_first_parameter = false;
+    append_axis_value(gcode, 'E', position_.e, target.e, state_.is_extruder_relative);
   }
 
   if (has_f)
   {
-    gcode += is_first_parameter ? "F" : " F";
-    gcode += utilities::dtos(target.f, 0);
+    utilities::append_parameter(gcode, 'F', target.f, 0);
   }
-  
-  return gcode;
+}
+
+void firmware::append_axis_value(std::string& gcode, char word, double& current, double target, bool is_relative)
+{
+  if (!is_relative)
+  {
+    utilities::append_parameter(gcode, word, target, 3);
+    return;
+  }
+  // Relative values are written as the distance from the previous segment.  Round the distance to the written
+  // precision and advance the current position by that amount so that rounding errors do not accumulate over the arc.
+  double distance = std::floor((target - current) * 1000.0 + 0.5) / 1000.0;
+  current += distance;
+  utilities::append_parameter(gcode, word, distance, 3);
+}
+
+void firmware::update_current_position(const firmware_position& target)
+{
+  if (!state_.is_relative)
+  {
+    position_.x = target.x;
+    position_.y = target.y;
+    position_.z = target.z;
+  }
+  if (!state_.is_extruder_relative)
+  {
+    position_.e = target.e;
+  }
+  position_.f = target.f;
 }
 
 bool firmware::is_valid_version(std::string version)
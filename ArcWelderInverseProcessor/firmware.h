@@ -329,8 +329,8 @@ public:
   /// <param name="is_clockwise">If true, this is a G2 command.  If false, this is a G3 command.</param>
   /// <param name="is_relative">If this is true, the extruder is currently in relative mode.  Else it is in absolute mode.</param>
   /// <param name="offest_absolute_e">This is the absolute offset for absolute E coordinates if the extruder is not in relative mode.</param>
-  /// <returns></returns>
-  virtual std::string interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise);
+  /// <returns>The generated G1 commands, separated by newlines.  The buffer is reused by the next call.</returns>
+  virtual const std::string& interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise);
 
   /// <summary>
   /// Sets the current position.  Should be called before interpolate_arc.
@@ -344,11 +344,11 @@ public:
   /// <param name="state">The state to set</param>
   void set_current_state(firmware_state& state);
   /// <summary>
-  /// Create a G1 command from the current position and offsets.
+  /// Create a G1 command from the current position and offsets, and append it to the supplied buffer.
   /// </summary>
   /// <param name="target">The position of the printer after the G1 command is completed.</param>
-  /// <returns>The G1 command</returns>
-  virtual std::string g1_command(firmware_position& target);
+  /// <param name="gcode">The buffer the G1 command is appended to.</param>
+  virtual void g1_command(firmware_position& target, std::string& gcode);
 
   /// <summary>
   /// Checks a string to see if it is a valid version.
@@ -395,6 +395,25 @@ public:
   virtual void apply_arguments();
 
 protected:
+  /// <summary>
+  /// Appends an axis parameter to a G1 command.  For relative axes the distance from the current position is written,
+  /// and the current position is advanced by the written (rounded) distance.
+  /// </summary>
+  /// <param name="gcode">The buffer the parameter is appended to.</param>
+  /// <param name="word">The parameter word, for example 'X'.</param>
+  /// <param name="current">The current axis position.  Advanced by the written distance if the axis is relative.</param>
+  /// <param name="target">The target axis position.</param>
+  /// <param name="is_relative">True if the axis is in relative mode.</param>
+  static void append_axis_value(std::string& gcode, char word, double& current, double target, bool is_relative);
+  /// <summary>
+  /// Updates the current position after g1_command has written a move to target.  Absolute axes and the feedrate are
+  /// set to the target.  Relative axes were already advanced by the rounded distance that was written, so they are
+  /// left alone, which keeps rounding errors from accumulating.
+  /// </summary>
+  /// <param name="target">The target of the move that was written.</param>
+  void update_current_position(const firmware_position& target);
+  // The gcodes generated by the most recent interpolate_arc call.  Cleared and reused for every arc.
+  std::string gcodes_;
   firmware_position position_;
   firmware_state state_;
   firmware_arguments args_;
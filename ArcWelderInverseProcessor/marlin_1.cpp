@@ -92,7 +92,7 @@ firmware_arguments marlin_1::get_default_arguments_for_current_version() const
 	return default_args;
 }
 
-std::string marlin_1::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
+const std::string& marlin_1::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
 {
 	// Clear the current list of gcodes
 	gcodes_.clear();
@@ -321,12 +321,12 @@ bool marlin_1::buffer_line_kinematic(const float(&cart)[MARLIN_XYZE], double fr_
 	target.f = fr_mm_s;
 	if (gcodes_.size() > 0)
 	{
-		gcodes_ += "\n";
+		gcodes_ += '\n';
 	}
 	// Generate the gcode
-	gcodes_ += g1_command(target);
+	g1_command(target, gcodes_);
 
 	// update the current position
-	set_current_position(target);
+	update_current_position(target);
 	return true;
 }
@@ -104,7 +104,7 @@ firmware_arguments marlin_2::get_default_arguments_for_current_version() const
   return default_args;
 }
 
-std::string marlin_2::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
+const std::string& marlin_2::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
 {
   // Clear the current list of gcodes
   gcodes_.clear();
@@ -604,10 +604,10 @@ bool marlin_2::buffer_line(const float(&cart)[MARLIN_2_XYZE], double fr_mm_s, in
   target.f = fr_mm_s;
   if (gcodes_.size() > 0)
   {
-    gcodes_ += "\n";
+    gcodes_ += '\n';
   }
   // Generate the gcode
-  gcodes_ += g1_command(target);
+  g1_command(target, gcodes_);
 
   return true;
 }
@@ -103,7 +103,7 @@ firmware_arguments prusa::get_default_arguments_for_current_version() const
   return default_args;
 }
 
-std::string prusa::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
+const std::string& prusa::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
 {
   // Clear the current list of gcodes
   gcodes_.clear();
@@ -463,11 +463,11 @@ void prusa::plan_buffer_line(float x, float y, float z, const float& e, float fe
   target.f = feed_rate;
   if (gcodes_.size() > 0)
   {
-    gcodes_ += "\n";
+    gcodes_ += '\n';
   }
   // Generate the gcode
-  gcodes_ += g1_command(target);
+  g1_command(target, gcodes_);
 
   // update the current position
-  set_current_position(target);
+  update_current_position(target);
 }
@@ -68,11 +68,10 @@ public:
   typedef signed char int8_t;
   enum AxisEnum { X_AXIS = 0, Y_AXIS = 1, Z_AXIS = 2, E_AXIS = 3, X_HEAD = 4, Y_HEAD = 5 };
   prusa(firmware_arguments args);
-  virtual std::string interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise) override;
+  virtual const std::string& interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise) override;
   virtual firmware_arguments get_default_arguments_for_current_version() const override;
   virtual void apply_arguments() override;
 private:
-  std::string gcodes_;
   /// <summary>
   /// A struct representing the prusa configuration store.  Note:  I didn't add the trailing underscore so this variable name will match the original source algorithm name.
   /// </summary>
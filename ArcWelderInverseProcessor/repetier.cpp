@@ -104,7 +104,7 @@ repetier::~repetier()
 {
 }
 
-std::string repetier::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
+const std::string& repetier::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
 {
   // Clear the current list of gcodes
   gcodes_.clear();
@@ -464,11 +464,11 @@ void repetier::moveToReal(float x, float y, float z, float e)
   target.f = feedrate;
   if (gcodes_.size() > 0)
   {
-    gcodes_ += "\n";
+    gcodes_ += '\n';
   }
   // Generate the gcode
-  gcodes_ += g1_command(target);
+  g1_command(target, gcodes_);
 
   // update the current position
-  set_current_position(target);
+  update_current_position(target);
 }
@@ -45,12 +45,11 @@ public:
   
   repetier(firmware_arguments args);
   virtual ~repetier();
-  virtual std::string interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise) override;
+  virtual const std::string& interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise) override;
   virtual firmware_arguments get_default_arguments_for_current_version() const override;
   virtual void apply_arguments() override;
 private:
   repetier_firmware_versions repetier_version_;
-  std::string gcodes_;
   const static int REPETIER_XYZE = 4;
   enum AxisEnum { X_AXIS = 0, Y_AXIS = 1, Z_AXIS = 2, E_AXIS = 3};
   /// <summary>
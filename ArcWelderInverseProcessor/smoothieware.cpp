@@ -85,7 +85,7 @@ firmware_arguments smoothieware::get_default_arguments_for_current_version() con
   return default_args;
 }
 
-std::string smoothieware::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
+const std::string& smoothieware::interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise)
 {
   // Clear the current list of gcodes
   gcodes_.clear();
@@ -296,10 +296,10 @@ bool smoothieware::append_milestone(const float target[], double rate_mm_s)
   gcode_target.f = rate_mm_min;
   if (gcodes_.size() > 0)
   {
-    gcodes_ += "\n";
+    gcodes_ += '\n';
   }
   // Generate the gcode
-  gcodes_ += g1_command(gcode_target);
+  g1_command(gcode_target, gcodes_);
 
   return true;
   return true;
@@ -54,7 +54,7 @@ public:
   enum class smoothieware_firmware_versions { V2021_06_19 = 0 };
   smoothieware(firmware_arguments args);
   virtual ~smoothieware();
-  virtual std::string interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise) override;
+  virtual const std::string& interpolate_arc(firmware_position& target, double i, double j, double r, bool is_clockwise) override;
   virtual firmware_arguments get_default_arguments_for_current_version() const override;
   virtual void apply_arguments() override;
 private:
@@ -66,7 +66,6 @@ private:
     CW_ARC, // G2
     CCW_ARC // G3
   };
-  std::string gcodes_;
   const static int REPETIER_XYZE = 4;
   enum AxisEnum { X_AXIS = 0, Y_AXIS = 1, Z_AXIS = 2, E_AXIS = 3, A_AXIS = 3 };   // A axis is the same as the E axis.
   /// <summary>
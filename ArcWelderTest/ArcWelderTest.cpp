@@ -51,7 +51,84 @@ int run_tests(int argc, char* argv[])
 	for (unsigned int index = 0; index < num_runs; index++)
 	{
 		std::cout << "Processing test run " << index + 1 << " of " << num_runs << ".\r\n";
-		
+
+		// The self-contained tests run first, since the file based test below needs a local gcode file.
+		if (!TestDeviationKernels(100000))
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestMeatPack(10000))
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestBinaryGcode(100))
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestLineNumbers())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestCompressedFiles())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestMergeArcs())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestPushOwnItem())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestRelativeArcs())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestRelativeInterpolation())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestLeastSquaresCircle())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestFeatureTolerances())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestCurvaturePrefilter())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestLookahead())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestBezierCurves())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestSimplifyPolylines())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestReducePrecisionToFit())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestCompactOutput())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestWeldThroughComments())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
+		if (!TestBinaryGcodeFile())
+		{
+			std::cout << "Test Failed!" << std::endl;
+		}
 		TestAntiStutter(ANTI_STUTTER_TEST);
 		//TestParsingCase();
 		//TestDoubleToString();
@@ -402,4 +479,1191 @@ bool TestProblemDoubles()
 	
 	
 	return result;
-}
\ No newline at end of file
+}
+
+bool TestDeviationKernels(int num_runs)
+{
+	// Every vectorized deviation kernel must give exactly the same result as the scalar kernel.
+	bool all_success = true;
+	deviation_instruction_set supported = deviation_kernels::get_supported_instruction_set();
+	double x[40];
+	double y[40];
+	for (int run = 0; run < num_runs; run++)
+	{
+		int count = utilities::rand_range(1, 40);
+		double center_x = utilities::rand_range(-100.0, 100.0);
+		double center_y = utilities::rand_range(-100.0, 100.0);
+		double radius = utilities::rand_range(0.5, 60.0);
+		double noise = utilities::rand_range(0.0, 0.1);
+		double resolution_mm = utilities::rand_range(0.0001, 0.1);
+		double start_angle = utilities::rand_range(0.0, 2.0 * PI_DOUBLE);
+		double step_angle = utilities::rand_range(-0.2, 0.2);
+		for (int index = 0; index < count; index++)
+		{
+			double angle = start_angle + step_angle * index;
+			double point_radius = radius + utilities::rand_range(-noise, noise);
+			x[index] = center_x + point_radius * std::cos(angle);
+			y[index] = center_y + point_radius * std::sin(angle);
+		}
+		for (int kernel = 0; kernel < 2; kernel++)
+		{
+			deviation_kernels::set_instruction_set(deviation_instruction_set_scalar);
+			double scalar_max = 0;
+			bool scalar_result = kernel == 0
+				? deviation_kernels::try_get_max_point_deviation(x, y, count, center_x, center_y, radius, resolution_mm, scalar_max)
+				: deviation_kernels::try_get_max_segment_deviation(x, y, count, center_x, center_y, radius, resolution_mm, scalar_max);
+			for (int instruction_set = deviation_instruction_set_sse2; instruction_set <= supported; instruction_set++)
+			{
+				deviation_kernels::set_instruction_set(static_cast<deviation_instruction_set>(instruction_set));
+				double max = 0;
+				bool result = kernel == 0
+					? deviation_kernels::try_get_max_point_deviation(x, y, count, center_x, center_y, radius, resolution_mm, max)
+					: deviation_kernels::try_get_max_segment_deviation(x, y, count, center_x, center_y, radius, resolution_mm, max);
+				if (result != scalar_result || (result && max != scalar_max))
+				{
+					std::cout << "Deviation kernel mismatch for " << deviation_kernels::get_instruction_set_name(static_cast<deviation_instruction_set>(instruction_set)) << std::endl;
+					all_success = false;
+				}
+			}
+		}
+	}
+	deviation_kernels::set_instruction_set(supported);
+	return all_success;
+}
+
+bool TestMeatPack(int num_runs)
+{
+	// Packed gcode must unpack to the original lines, without blank lines, surrounding whitespace and, unless they are
+	// kept, comments.  The text is packed and unpacked in pieces of random length, since that is how it is written and
+	// received.
+	static const std::string lines[] = {
+		"G1 X10.123 Y-20.5 E1.23456 F1800",
+		"G0 X0 Y0 Z0.2",
+		"G3 X50.1 Y50.2 I-1.5 J2.25 E0.5",
+		"  G1 X1 Y2 ; with a comment  ",
+		"; a comment only line",
+		"",
+		"M117 Printing: 50% done",
+		"M104 S210",
+		"G92 E0",
+		"T1",
+		"G28 W\r",
+		"N123 G1 X1*12",
+		"G1 X.5 Y-.25 E.1",
+	};
+	const int num_lines = sizeof(lines) / sizeof(lines[0]);
+	bool all_success = true;
+	for (int run = 0; run < num_runs; run++)
+	{
+		bool no_spaces = run % 2 == 1;
+		bool keep_comments = run % 4 > 1;
+		std::string source;
+		std::string expected;
+		int count = utilities::rand_range(1, 50);
+		for (int index = 0; index < count; index++)
+		{
+			std::string line = lines[utilities::rand_range(0, num_lines) % num_lines];
+			source += line;
+			source += '\n';
+			if (!keep_comments)
+			{
+				line = line.substr(0, line.find(';'));
+			}
+			size_t start = line.find_first_not_of(" \t\r");
+			if (start == std::string::npos)
+			{
+				continue;
+			}
+			line = line.substr(start, line.find_last_not_of(" \t\r") - start + 1);
+			if (no_spaces && line[0] == 'G')
+			{
+				std::string::iterator comment = std::find(line.begin(), line.end(), ';');
+				line.erase(std::remove(line.begin(), comment, ' '), comment);
+			}
+			expected += line;
+			expected += '\n';
+		}
+
+		meatpack_encoder encoder(no_spaces, keep_comments);
+		std::string packed;
+		encoder.append_start(packed);
+		for (size_t index = 0; index < source.length();)
+		{
+			size_t length = std::min(source.length() - index, static_cast<size_t>(utilities::rand_range(1, 20)));
+			encoder.append_packed(source.c_str() + index, length, packed);
+			index += length;
+		}
+		encoder.append_end(packed);
+
+		meatpack_decoder decoder;
+		std::string unpacked;
+		for (size_t index = 0; index < packed.length();)
+		{
+			size_t length = std::min(packed.length() - index, static_cast<size_t>(utilities::rand_range(1, 20)));
+			decoder.append_unpacked(packed.c_str() + index, length, unpacked);
+			index += length;
+		}
+		if (unpacked != expected || decoder.is_packing())
+		{
+			std::cout << "MeatPack round trip failed for:\n" << source << std::endl;
+			all_success = false;
+		}
+	}
+	return all_success;
+}
+
+bool TestLineNumbers()
+{
+	// Comments, blank lines and old line numbers and checksums are removed, and the text may arrive in any pieces.
+	const std::string source = "G28 ; home\n\n  ; comment only\nN5 T0*1\nM117 Done\r\n";
+	const std::string expected = "N0 M110 N0*125\nN1 G28*18\nN2 T0*56\nN3 M117 Done*39\n";
+	bool all_success = true;
+	for (size_t split = 0; split <= source.length(); split++)
+	{
+		line_number_encoder encoder;
+		std::string numbered;
+		encoder.append_start(numbered);
+		encoder.append_numbered(source.c_str(), split, numbered);
+		encoder.append_numbered(source.c_str() + split, source.length() - split, numbered);
+		encoder.append_end(numbered);
+		if (numbered != expected)
+		{
+			std::cout << "Line numbers are wrong when split at " << split << ":\n" << numbered << std::endl;
+			all_success = false;
+		}
+	}
+	return all_success;
+}
+
+bool TestBinaryGcode(int num_runs)
+{
+	// Gcode written to binary gcode blocks, with every compression and encoding, must read back as the same lines.  The
+	// metadata block must be copied unchanged, before the gcode.
+	static const std::string lines[] = {
+		"G1 X10.123 Y-20.5 E1.23456 F1800",
+		"G0 X0 Y0 Z0.2",
+		"G3 X50.1 Y50.2 I-1.5 J2.25 E0.5",
+		"M117 Printing: 50% done",
+		"M104 S210",
+		"G92 E0",
+		"G1 X.5 Y-.25 E.1",
+	};
+	const int num_lines = sizeof(lines) / sizeof(lines[0]);
+	bool all_success = true;
+	for (int run = 0; run < num_runs; run++)
+	{
+		uint16_t compression = static_cast<uint16_t>(run % 4);
+		uint16_t encoding = static_cast<uint16_t>((run / 4) % 3);
+		std::string source;
+		std::string expected;
+		int count = utilities::rand_range(1, 20000);
+		for (int index = 0; index < count; index++)
+		{
+			std::string line = lines[utilities::rand_range(0, num_lines) % num_lines];
+			source += line;
+			source += '\n';
+			// MeatPack encoded blocks are written in no spaces mode
+			if (encoding != bgcode_gcode_encoding_none && line[0] == 'G')
+			{
+				line.erase(std::remove(line.begin(), line.end(), ' '), line.end());
+			}
+			expected += line;
+			expected += '\n';
+		}
+
+		bgcode_writer writer;
+		writer.set_gcode_format(compression, encoding);
+		std::string file;
+		writer.append_file_header(file);
+		bgcode_block metadata;
+		metadata.type = bgcode_block_printer_metadata;
+		metadata.parameters = std::string(2, '\0');
+		metadata.data = "printer_model=MK4\n";
+		metadata.uncompressed_size = static_cast<uint32_t>(metadata.data.length());
+		writer.append_block(metadata, file);
+		writer.append_gcode(source, file);
+		writer.append_end(file);
+
+		std::stringstream stream(file);
+		bgcode_reader reader;
+		bgcode_block block;
+		std::string unpacked;
+		bool success = reader.read_file_header(stream) && reader.read_block(stream, block) && block.data == metadata.data;
+		while (success && reader.read_block(stream, block))
+		{
+			success = block.type == bgcode_block_gcode && reader.append_gcode(block, unpacked);
+		}
+		if (!success || !reader.get_error().empty() || unpacked != expected)
+		{
+			std::cout << "Binary gcode round trip failed for compression " << compression << " and encoding " << encoding << ". " << reader.get_error() << std::endl;
+			all_success = false;
+		}
+	}
+	return all_success;
+}
+
+bool TestCompressedFiles()
+{
+	// Text written to a compressed file must be detected and read back unchanged, and the stream positions must be
+	// counted in compressed bytes.
+	static const char* paths[] = { "compressed_file_test.gcode.gz", "compressed_file_test.gcode.zst" };
+	std::string source;
+	for (int index = 0; index < 100000; index++)
+	{
+		source += "G1 X" + utilities::to_string(utilities::rand_range(0, 250)) + " Y" + utilities::to_string(utilities::rand_range(0, 210)) + " E0.0123\n";
+	}
+	bool all_success = true;
+	for (int index = 0; index < 2; index++)
+	{
+		compression_format format = compressed_file::get_format_from_path(paths[index]);
+		if (!compressed_file::is_format_supported(format))
+		{
+			continue;
+		}
+		compressed_ofstream output;
+		output.open(paths[index]);
+		output << source;
+		long long compressed_position = static_cast<long long>(output.tellp());
+		output.close();
+
+		compressed_ifstream input;
+		input.open(paths[index]);
+		std::string line;
+		std::string unpacked;
+		while (std::getline(input, line))
+		{
+			unpacked += line;
+			unpacked += '\n';
+		}
+		input.close();
+		std::remove(paths[index]);
+		if (input.get_format() != format || unpacked != source || !input.get_error().empty() || compressed_position <= 0 || compressed_position >= static_cast<long long>(source.length()))
+		{
+			std::cout << "Compressed file round trip failed for " << compressed_file::get_format_name(format) << ". " << input.get_error() << std::endl;
+			all_success = false;
+		}
+	}
+	return all_success;
+}
+
+bool TestMergeArcs()
+{
+	// Six G3 moves of 45 degrees around the same circle must become a single arc of 270 degrees, after which a move
+	// around a different circle must be refused.
+	const double radius = 10;
+	segmented_arc shape(DEFAULT_MIN_SEGMENTS, DEFAULT_MAX_SEGMENTS, DEFAULT_RESOLUTION_MM);
+	shape.try_add_point(printer_point(radius, 0, 0.2, 0, 0, 1800, 0, false));
+	double x = radius;
+	double y = 0;
+	bool all_success = true;
+	for (int index = 1; index <= 6; index++)
+	{
+		double angle = PI_DOUBLE * index / 4;
+		printer_point p(radius * std::cos(angle), radius * std::sin(angle), 0.2, 0.5 * index, 0.5, 1800, radius * PI_DOUBLE / 4, false);
+		if (!shape.try_add_arc_span(p, -x, -y, false))
+		{
+			std::cout << "Arc span " << index << " was not merged." << std::endl;
+			all_success = false;
+		}
+		x = p.x;
+		y = p.y;
+	}
+	std::string gcode = shape.get_shape_gcode();
+	if (!shape.is_shape() || !shape.is_arc_span() || gcode.find("G3 ") != 0 || gcode.find(" I-10") == std::string::npos
+		|| !utilities::is_equal(shape.get_shape_length(), radius * PI_DOUBLE * 1.5, 0.001))
+	{
+		std::cout << "The merged arc is wrong: " << gcode << std::endl;
+		all_success = false;
+	}
+	if (shape.try_add_arc_span(printer_point(x + 1, y + 1, 0.2, 3.5, 0.5, 1800, 1.5, false), -x + 1, -y, false))
+	{
+		std::cout << "An arc span around a different circle was merged." << std::endl;
+		all_success = false;
+	}
+	if (shape.try_add_point(printer_point(x + 1, y, 0.2, 3.5, 0.5, 1800, 1, false)))
+	{
+		std::cout << "A point was added to merged arc spans." << std::endl;
+		all_success = false;
+	}
+	return all_success;
+}
+
+static void WeldFile(arc_welder_args args, const std::string& source_path, const std::string& target_path)
+{
+	// Welds the source file into the target file with the given arguments, logging only critical errors.
+	std::vector<std::string> logger_names;
+	logger_names.push_back("arc_welder.gcode_conversion");
+	std::vector<int> logger_levels;
+	logger_levels.push_back((int)log_levels::CRITICAL);
+	logger* p_logger = new logger(logger_names, logger_levels);
+	p_logger->set_log_level(log_levels::CRITICAL);
+	args.source_path = source_path;
+	args.target_path = target_path;
+	args.log = p_logger;
+	{
+		arc_welder arc_welder_obj(args);
+		arc_welder_obj.process();
+	}
+	delete p_logger;
+}
+
+static std::string WeldGcode(arc_welder_args args, const std::string& source)
+{
+	// Welds the source gcode with the given arguments and returns the output without the arc welder header and blank
+	// lines.
+	static const char* source_path = "weld_test_source.gcode";
+	static const char* target_path = "weld_test_target.gcode";
+	std::ofstream source_file(source_path, std::ios::binary);
+	source_file << source;
+	source_file.close();
+
+	WeldFile(args, source_path, target_path);
+	std::string target;
+	std::ifstream target_file(target_path, std::ios::binary);
+	std::string line;
+	// The header comments end with a blank line
+	while (std::getline(target_file, line) && line.length() > 0)
+	{
+	}
+	while (std::getline(target_file, line))
+	{
+		if (line.length() == 0)
+		{
+			continue;
+		}
+		target += line;
+		target += '\n';
+	}
+	target_file.close();
+	std::remove(source_path);
+	std::remove(target_path);
+	return target;
+}
+
+static std::string GetCircleGcode(double radius, int segments, int first_segment, int last_segment, const std::string& prefix, bool is_relative)
+{
+	// G1 moves along a circle around (100, 100), counterclockwise, extruding 0.01mm per segment.  The points are rounded
+	// to 3 decimals first, so relative moves add up to exactly the same endpoints as absolute moves.
+	std::string gcode;
+	double previous_x = 0;
+	double previous_y = 0;
+	for (int index = first_segment; index <= last_segment; index++)
+	{
+		double angle = 2.0 * PI_DOUBLE * index / segments;
+		double x = std::floor((100 + radius * std::cos(angle)) * 1000 + 0.5) / 1000;
+		double y = std::floor((100 + radius * std::sin(angle)) * 1000 + 0.5) / 1000;
+		if (index > first_segment)
+		{
+			gcode += prefix;
+			gcode += is_relative ? " X" + utilities::dtos(x - previous_x, 3) + " Y" + utilities::dtos(y - previous_y, 3) : " X" + utilities::dtos(x, 3) + " Y" + utilities::dtos(y, 3);
+			gcode += " E0.01\n";
+		}
+		previous_x = x;
+		previous_y = y;
+	}
+	return gcode;
+}
+
+static std::string GetEndpointIndexes(const std::string& source, const std::string& target)
+{
+	// Returns the index of the source move that each move in the target ends at, separated by spaces, or ? if it ends
+	// somewhere else.  Moves are matched by their X and Y parameters.
+	std::vector<std::string> source_endpoints;
+	std::istringstream source_stream(source);
+	std::string line;
+	while (std::getline(source_stream, line))
+	{
+		size_t x_position = line.find(" X");
+		if (line.compare(0, 2, "G1") == 0 && x_position != std::string::npos)
+		{
+			source_endpoints.push_back(line.substr(x_position, line.find(' ', line.find(" Y") + 1) - x_position));
+		}
+	}
+	std::string indexes;
+	std::istringstream target_stream(target);
+	while (std::getline(target_stream, line))
+	{
+		size_t x_position = line.find(" X");
+		if (line[0] != 'G' || x_position == std::string::npos)
+		{
+			continue;
+		}
+		std::string endpoint = line.substr(x_position, line.find(' ', line.find(" Y") + 1) - x_position);
+		std::vector<std::string>::iterator found = std::find(source_endpoints.begin(), source_endpoints.end(), endpoint);
+		if (indexes.length() > 0)
+		{
+			indexes += ' ';
+		}
+		indexes += found == source_endpoints.end() ? "?" : std::to_string(found - source_endpoints.begin());
+	}
+	return indexes;
+}
+
+static double GetTotalE(const std::string& gcode)
+{
+	// Returns the sum of the E parameters of the moves in relative extrusion gcode.
+	double total_e = 0;
+	std::istringstream stream(gcode);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		size_t e_position = line.find(" E");
+		if (line[0] == 'G' && e_position != std::string::npos)
+		{
+			total_e += std::atof(line.c_str() + e_position + 2);
+		}
+	}
+	return total_e;
+}
+
+bool TestPushOwnItem()
+{
+	// Pushing an item of a full array_list makes it grow, which frees the item being pushed unless it was copied first.
+	bool all_success = true;
+	array_list<std::string> list;
+	int max_size = list.get_max_size();
+	for (int index = 0; index < max_size; index++)
+	{
+		list.push_back("an item long enough to be stored on the heap " + std::to_string(index));
+	}
+	list.push_back(list[0]);
+	list.push_front(list[list.count() - 1]);
+	if (list.count() != max_size + 2 || list[0] != list[1] || list[list.count() - 1] != list[1])
+	{
+		std::cout << "Pushing an item of a full array_list is wrong: " << list[0] << ", " << list[list.count() - 1] << std::endl;
+		all_success = false;
+	}
+
+	// Pushing onto the back of a full circular_buffer replaces its first item.
+	circular_buffer<int> buffer(3);
+	for (int value = 1; value <= 4; value++)
+	{
+		buffer.push_back(value);
+	}
+	if (buffer.count() != 3 || buffer[0] != 2 || buffer[1] != 3 || buffer[2] != 4)
+	{
+		std::cout << "Pushing onto the back of a full circular_buffer is wrong: " << buffer[0] << ", " << buffer[1] << ", " << buffer[2] << std::endl;
+		all_success = false;
+	}
+	return all_success;
+}
+
+bool TestRelativeArcs()
+{
+	// A half circle of relative moves must become one relative arc that ends exactly where the moves end, even though
+	// the absolute position is never known.
+	bool all_success = true;
+	std::string source = "G91\nM83\nG1 F1800\n" + GetCircleGcode(10, 64, 0, 32, "G1", true) + "M107\n";
+	std::string target = WeldGcode(arc_welder_args(), source);
+	if (target != "G91\nM83\nG1 F1800\nG3 X-20.000 Y0.000 I-10.000 J0.000 E0.32000\nM107\n")
+	{
+		std::cout << "The relative arc is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+
+	// Relative moves on an unknown axis are ignored by default, and only added up when requested.
+	gcode_parser parser;
+	for (int index = 0; index < 2; index++)
+	{
+		gcode_position_args args = get_single_extruder_position_args();
+		args.relative_moves_from_unknown_position = index == 1;
+		gcode_position source_position(args);
+		parsed_command command = parser.parse_gcode("G91");
+		source_position.update(command, 1, 1, 0);
+		command = parser.parse_gcode("G1 X1.5 Y-2");
+		source_position.update(command, 2, 2, 0);
+		command = parser.parse_gcode("G1 X1.5 Y-2");
+		source_position.update(command, 3, 3, 0);
+		position* p_current = source_position.get_current_position_ptr();
+		double expected_x = index == 1 ? 3 : 0;
+		double expected_y = index == 1 ? -4 : 0;
+		if (!p_current->x_null || !p_current->y_null || p_current->x != expected_x || p_current->y != expected_y)
+		{
+			std::cout << "Relative moves from an unknown position are wrong when relative_moves_from_unknown_position is " << (index == 1 ? "true" : "false") << "." << std::endl;
+			all_success = false;
+		}
+	}
+	return all_success;
+}
+
+bool TestLeastSquaresCircle()
+{
+	// A quarter circle with alternating noise and a bump in the middle.  The circle through the first, middle and last
+	// points is over the resolution, so the least squares circle through the endpoints must be found instead.
+	const int count = 17;
+	printer_point_list points(count);
+	for (int index = 0; index < count; index++)
+	{
+		double angle = PI_DOUBLE / 2.0 * index / (count - 1);
+		double radius = 10;
+		if (index > 0 && index < count - 1)
+		{
+			radius += index % 2 == 1 ? -0.004 : 0.004;
+		}
+		if (index == count / 2)
+		{
+			radius += 0.015;
+		}
+		points.push_back(printer_point(100 + radius * std::cos(angle), 100 + radius * std::sin(angle), 0.2, 0, 0, 1800, 0, false));
+	}
+	bool all_success = true;
+	circle midpoint_circle;
+	if (circle::try_create_circle(points[0], points[count / 2], points[count - 1], DEFAULT_MAX_RADIUS_MM, midpoint_circle)
+		&& !midpoint_circle.is_over_deviation(points, 0.025, 0.0001, false))
+	{
+		std::cout << "The midpoint circle should be over the resolution." << std::endl;
+		all_success = false;
+	}
+	circle fitted_circle;
+	if (!circle::try_create_circle(points, DEFAULT_MAX_RADIUS_MM, 0.025, 0.0001, false, fitted_circle)
+		|| !utilities::is_equal(fitted_circle.center.x, 99.985954925078, 0.000000001)
+		|| !utilities::is_equal(fitted_circle.center.y, 99.985954925078, 0.000000001)
+		|| !utilities::is_equal(fitted_circle.radius, 10.014054924290, 0.000000001))
+	{
+		std::cout << std::fixed << std::setprecision(12) << "The least squares circle is wrong: center (" << fitted_circle.center.x << ", " << fitted_circle.center.y << "), radius " << fitted_circle.radius << std::endl;
+		all_success = false;
+	}
+	return all_success;
+}
+
+bool TestFeatureTolerances()
+{
+	// A quarter circle of outer wall followed by a quarter circle of infill.  By default both are welded.  With a tiny
+	// resolution for infill, only the wall is welded.
+	const std::string source = "G90\nM83\nG1 X110 Y100 F1800\n;TYPE:WALL-OUTER\n" + GetCircleGcode(10, 64, 0, 16, "G1", false)
+		+ ";TYPE:FILL\n" + GetCircleGcode(10, 64, 16, 32, "G1", false) + "M107\n";
+	const std::string wall = "G3 X100.000 Y110.000 I-10.000 J-0.000 E0.16000\n";
+	const std::string infill = "G3 X90.000 Y100.000 I0.000 J-10.000 E0.16000\n";
+	bool all_success = true;
+	std::string target = WeldGcode(arc_welder_args(), source);
+	if (target != "G90\nM83\nG1 X110 Y100 F1800\n;TYPE:WALL-OUTER\n" + wall + ";TYPE:FILL\n" + infill + "M107\n")
+	{
+		std::cout << "The default output with feature comments is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+	arc_welder_args args;
+	args.feature_tolerances[feature_type_infill_feature] = feature_tolerance(0.001, -1, -1);
+	target = WeldGcode(args, source);
+	if (target != "G90\nM83\nG1 X110 Y100 F1800\n;TYPE:WALL-OUTER\n" + wall + ";TYPE:FILL\n" + GetCircleGcode(10, 64, 16, 32, "G1", false) + "M107\n")
+	{
+		std::cout << "The output with an infill tolerance is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+
+	// PrusaSlicer's feature comments.  The first quarter circle has a tiny resolution and must not be welded.  Support
+	// has no feature type, so it ends the first feature and the second quarter circle is welded.
+	const char* prusa_slicer_types[] = { "External perimeter", "Perimeter", "Overhang perimeter", "Internal infill", "Solid infill", "Top solid infill", "Bridge infill", "Gap fill", "Skirt/Brim", "Wipe tower" };
+	const feature_type prusa_slicer_features[] = { feature_type_outer_perimeter_feature, feature_type_inner_perimeter_feature, feature_type_unknown_perimeter_feature,
+		feature_type_infill_feature, feature_type_solid_infill_feature, feature_type_solid_infill_feature, feature_type_bridge_feature,
+		feature_type_gap_fill_feature, feature_type_skirt_feature, feature_type_prime_pillar_feature };
+	for (int index = 0; index < 10; index++)
+	{
+		const std::string type = std::string(";TYPE:") + prusa_slicer_types[index] + "\n";
+		const std::string prusa_slicer_source = "G90\nM83\nG1 X110 Y100 F1800\n" + type + GetCircleGcode(10, 64, 0, 16, "G1", false)
+			+ ";TYPE:Support material\n" + GetCircleGcode(10, 64, 16, 32, "G1", false) + "M107\n";
+		arc_welder_args prusa_slicer_args;
+		prusa_slicer_args.feature_tolerances[prusa_slicer_features[index]] = feature_tolerance(0.001, -1, -1);
+		target = WeldGcode(prusa_slicer_args, prusa_slicer_source);
+		if (target != "G90\nM83\nG1 X110 Y100 F1800\n" + type + GetCircleGcode(10, 64, 0, 16, "G1", false) + ";TYPE:Support material\n" + infill + "M107\n")
+		{
+			std::cout << "The output with a tolerance for " << prusa_slicer_types[index] << " is wrong:\n" << target << std::endl;
+			all_success = false;
+		}
+	}
+	return all_success;
+}
+
+bool TestCurvaturePrefilter()
+{
+	// Points along a circle must never be rejected by the curvature prefilter, and a sharp corner after them must be
+	// rejected by it without fitting a circle.
+	const double radius = 10;
+	const int segments = 64;
+	segmented_arc shape(DEFAULT_MIN_SEGMENTS, DEFAULT_MAX_SEGMENTS, DEFAULT_RESOLUTION_MM);
+	double segment_length = 2.0 * radius * std::sin(PI_DOUBLE / segments);
+	bool all_success = true;
+	printer_point_list points(segments);
+	double x = radius;
+	double y = 0;
+	for (int index = 0; index <= segments / 4; index++)
+	{
+		double angle = 2.0 * PI_DOUBLE * index / segments;
+		x = radius * std::cos(angle);
+		y = radius * std::sin(angle);
+		printer_point p(x, y, 0.2, 0.01 * index, index == 0 ? 0 : 0.01, 1800, index == 0 ? 0 : segment_length, true);
+		points.push_back(p);
+		if (!shape.try_add_point(p))
+		{
+			std::cout << "Point " << index << " of the circle was not added." << std::endl;
+			all_success = false;
+		}
+	}
+	if (shape.get_num_prefilter_rejects() != 0)
+	{
+		std::cout << "The curvature prefilter rejected a point on the circle." << std::endl;
+		all_success = false;
+	}
+	// The circle ends heading in -X at (0, 10), turn 90 degrees to head in +Y.
+	printer_point corner(x, y + segment_length, 0.2, 0.18, 0.01, 1800, segment_length, true);
+	if (shape.try_add_point(corner) || shape.get_num_prefilter_rejects() != 1)
+	{
+		std::cout << "The curvature prefilter did not reject a corner." << std::endl;
+		all_success = false;
+	}
+	// The prefilter may only reject points that the full fit would reject.
+	points.push_back(corner);
+	arc corner_arc;
+	if (arc::try_create_arc(points, corner_arc, radius * PI_DOUBLE / 2.0 + segment_length))
+	{
+		std::cout << "The corner rejected by the curvature prefilter fits an arc." << std::endl;
+		all_success = false;
+	}
+	// The rejected point must not change the arc that was built before it.
+	if (shape.get_num_segments() != segments / 4 + 1 || !utilities::is_equal(shape.get_shape_length(), radius * PI_DOUBLE / 2.0, 0.01))
+	{
+		std::cout << "The arc changed when the curvature prefilter rejected a point: " << shape.get_num_segments() << " points, length " << shape.get_shape_length() << std::endl;
+		all_success = false;
+	}
+	return all_success;
+}
+
+bool TestLookahead()
+{
+	// A noisy curve where the greedy welder extends the first arc too far and has to leave the last move as a G1.
+	// Ending the first arc one point earlier lets the second arc reach the end.
+	const std::string source =
+		"G90\nM83\nG1 X100.000 Y100.000 F1800\n"
+		"G1 X100.209 Y100.014 E0.00628\nG1 X100.380 Y100.040 E0.00519\nG1 X100.592 Y100.072 E0.00644\n"
+		"G1 X100.793 Y100.117 E0.00618\nG1 X100.992 Y100.159 E0.00610\nG1 X101.177 Y100.256 E0.00626\n"
+		"G1 X101.367 Y100.338 E0.00622\nG1 X101.511 Y100.424 E0.00502\nG1 X102.142 Y100.816 E0.02227\n"
+		"G1 X102.717 Y101.252 E0.02165\nG1 X103.205 Y101.762 E0.02120\nG1 X103.712 Y102.308 E0.02234\n"
+		"G1 X104.108 Y102.879 E0.02085\nG1 X104.480 Y103.501 E0.02175\nG1 X104.820 Y104.153 E0.02207\n"
+		"M107\n";
+	bool all_success = true;
+	std::string target = WeldGcode(arc_welder_args(), source);
+	// Greedy:  an arc to move 8, an arc to move 14 and a G1 to move 15.
+	std::string greedy_breakpoints = GetEndpointIndexes(source, target);
+	if (greedy_breakpoints != "0 8 14 15")
+	{
+		std::cout << "The greedy breakpoints are wrong: " << greedy_breakpoints << std::endl;
+		all_success = false;
+	}
+	if (target != "G90\nM83\nG1 X100.000 Y100.000 F1800\n"
+		"G3 X101.511 Y100.424 I-0.049 J3.080 E0.04769\n"
+		"G3 X104.480 Y103.501 I-3.818 J6.655 E0.13006\n"
+		"G1 X104.820 Y104.153 E0.02207\n"
+		"M107\n")
+	{
+		std::cout << "The greedy output is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+	arc_welder_args args;
+	args.lookahead_window = 50;
+	target = WeldGcode(args, source);
+	// Lookahead:  the first arc ends one move earlier, at move 7, so the second arc reaches move 15 and one command is saved.
+	std::string lookahead_breakpoints = GetEndpointIndexes(source, target);
+	if (lookahead_breakpoints != "0 7 15")
+	{
+		std::cout << "The lookahead breakpoints are wrong: " << lookahead_breakpoints << std::endl;
+		all_success = false;
+	}
+	if (target != "G90\nM83\nG1 X100.000 Y100.000 F1800\n"
+		"G3 X101.367 Y100.338 I-0.069 J3.211 E0.04267\n"
+		"G3 X104.820 Y104.153 I-3.908 J7.007 E0.15715\n"
+		"M107\n")
+	{
+		std::cout << "The lookahead output is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+	return all_success;
+}
+
+bool TestBezierCurves()
+{
+	// A parabola doesn't follow a circle, so it takes three arcs.  With bezier curves allowed, most of it becomes a
+	// single G5.
+	std::string source = "G90\nM83\nG1 X100.000 Y100.000 F1800\n";
+	for (int index = 1; index <= 20; index++)
+	{
+		double x = 100 + index;
+		double y = 100 + 0.03 * index * index;
+		double length = utilities::get_cartesian_distance(x - 1, 100 + 0.03 * (index - 1) * (index - 1), x, y);
+		source += "G1 X" + utilities::dtos(x, 3) + " Y" + utilities::dtos(y, 3) + " E" + utilities::dtos(length * 0.03, 5) + "\n";
+	}
+	source += "M107\n";
+	bool all_success = true;
+	std::string target = WeldGcode(arc_welder_args(), source);
+	if (target != "G90\nM83\nG1 X100.000 Y100.000 F1800\n"
+		"G3 X109.000 Y102.430 I-0.284 J18.932 E0.28256\n"
+		"G3 X117.000 Y108.670 I-16.722 J29.687 E0.30549\n"
+		"G3 X120.000 Y112.000 I-40.377 J39.392 E0.13449\n"
+		"M107\n")
+	{
+		std::cout << "The output without bezier curves is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+	arc_welder_args args;
+	args.allow_bezier_curves = true;
+	target = WeldGcode(args, source);
+	if (target != "G90\nM83\nG1 X100.000 Y100.000 F1800\n"
+		"G5 X117.000 Y108.670 I6.671 J-0.005 P-4.483 Q-4.600 E0.58805\n"
+		"G3 X120.000 Y112.000 I-40.377 J39.392 E0.13449\n"
+		"M107\n")
+	{
+		std::cout << "The output with bezier curves is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+
+	// Every source point the G5 replaces must be within the resolution of the curve.  I and J offset the first control
+	// point from the start, and P and Q offset the second control point from the end.
+	// gcode_parser doesn't parse the parameters of G5, so read them here.
+	std::string g5 = target.substr(target.find("G5"));
+	std::istringstream g5_stream(g5.substr(3, g5.find('\n') - 3));
+	double x = 0, y = 0, i = 0, j = 0, p = 0, q = 0, e = 0;
+	std::string parameter;
+	while (g5_stream >> parameter)
+	{
+		double value = std::atof(parameter.c_str() + 1);
+		switch (parameter[0])
+		{
+		case 'X': x = value; break;
+		case 'Y': y = value; break;
+		case 'I': i = value; break;
+		case 'J': j = value; break;
+		case 'P': p = value; break;
+		case 'Q': q = value; break;
+		case 'E': e = value; break;
+		}
+	}
+	double control_x[4] = { 100, 100 + i, x + p, x };
+	double control_y[4] = { 100, 100 + j, y + q, y };
+	double max_deviation = 0;
+	double source_e = 0;
+	for (int index = 0; index <= 17; index++)
+	{
+		double point_x = 100 + index;
+		double point_y = std::floor((100 + 0.03 * index * index) * 1000 + 0.5) / 1000;
+		if (index > 0)
+		{
+			source_e += std::floor(utilities::get_cartesian_distance(point_x - 1, 100 + 0.03 * (index - 1) * (index - 1), point_x, 100 + 0.03 * index * index) * 0.03 * 100000 + 0.5) / 100000;
+		}
+		double deviation = std::numeric_limits<double>::max();
+		for (int step = 0; step <= 10000; step++)
+		{
+			double t = step / 10000.0;
+			double u = 1 - t;
+			double curve_x = u * u * u * control_x[0] + 3 * u * u * t * control_x[1] + 3 * u * t * t * control_x[2] + t * t * t * control_x[3];
+			double curve_y = u * u * u * control_y[0] + 3 * u * u * t * control_y[1] + 3 * u * t * t * control_y[2] + t * t * t * control_y[3];
+			deviation = std::min(deviation, utilities::get_cartesian_distance(point_x, point_y, curve_x, curve_y));
+		}
+		max_deviation = std::max(max_deviation, deviation);
+	}
+	if (max_deviation > DEFAULT_RESOLUTION_MM / 2.0)
+	{
+		std::cout << "A point replaced by the G5 is " << max_deviation << "mm from the curve." << std::endl;
+		all_success = false;
+	}
+	if (!utilities::is_equal(e, source_e, 0.00001))
+	{
+		std::cout << "The G5 extrudes " << e << " instead of " << source_e << "." << std::endl;
+		all_success = false;
+	}
+	return all_success;
+}
+
+bool TestSimplifyPolylines()
+{
+	// A straight run with 0.01mm of noise after a shallow arc can't be an arc, since it doesn't turn.  When polylines are
+	// simplified it becomes a single move that extrudes as much as the moves it replaces.
+	const std::string arc = "G90\nM83\nG1 X100.000 Y100.000 F1800\n"
+		"G1 X101.000 Y100.010 E0.03\nG1 X102.000 Y100.000 E0.03\nG1 X103.000 Y100.010 E0.03\nG1 X104.000 Y100.000 E0.03\n"
+		"G1 X105.000 Y100.010 E0.03\nG1 X106.000 Y100.000 E0.03\nG1 X107.000 Y100.010 E0.03\nG1 X108.000 Y100.000 E0.03\n"
+		"G1 X109.000 Y100.010 E0.03\nG1 X110.000 Y100.000 E0.03\n";
+	const std::string run = "G1 X110.000 Y101.010 E0.03\nG1 X110.000 Y102.000 E0.03\nG1 X110.000 Y103.010 E0.03\n"
+		"G1 X110.000 Y104.000 E0.03\nG1 X110.000 Y105.010 E0.03\n";
+	const std::string welded_arc = "G90\nM83\nG1 X100.000 Y100.000 F1800\nG2 X110.000 Y100.000 I5.000 J-1249.995 E0.30000\n";
+	bool all_success = true;
+	std::string target = WeldGcode(arc_welder_args(), arc + run + "M107\n");
+	if (target != welded_arc + run + "M107\n")
+	{
+		std::cout << "The output without polyline simplification is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+	arc_welder_args args;
+	args.simplify_polylines = true;
+	target = WeldGcode(args, arc + run + "M107\n");
+	if (target != welded_arc + "G1 X110.000 Y105.010 E0.15000\nM107\n")
+	{
+		std::cout << "The simplified polyline is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+
+	// Turning a corner at the end of the run.  The moves on either side are collinear, so only the corner must be kept,
+	// and the nine moves become two that extrude as much in total.
+	const std::string corner = "G1 X111.010 Y105.010 E0.03\nG1 X112.000 Y105.010 E0.03\nG1 X113.010 Y105.010 E0.03\n"
+		"G1 X114.000 Y105.010 E0.03\n";
+	const std::string source = arc + run + corner + "M107\n";
+	target = WeldGcode(args, source);
+	std::string polyline = target.substr(welded_arc.length());
+	int kept_moves = 0;
+	for (size_t position = polyline.find("G1"); position != std::string::npos; position = polyline.find("G1", position + 1))
+	{
+		kept_moves++;
+	}
+	if (target.compare(0, welded_arc.length(), welded_arc) != 0 || kept_moves != 2 || polyline.find("G1 X110.000 Y105.010 ") != 0)
+	{
+		std::cout << "The simplified polyline should keep only the corner and the end:\n" << target << std::endl;
+		all_success = false;
+	}
+	if (!utilities::is_equal(GetTotalE(target), GetTotalE(source), 0.000001))
+	{
+		std::cout << "The simplified polyline extrudes " << GetTotalE(target) << " instead of " << GetTotalE(source) << "." << std::endl;
+		all_success = false;
+	}
+	return all_success;
+}
+
+bool TestReducePrecisionToFit()
+{
+	// A quarter circle with absolute extrusion welds to a 46 character arc.  With a 40 character limit the arc is
+	// aborted, unless the precision may be reduced to fit.
+	std::string header = "G90\nM82\nG92 E0\nG1 X110.000 Y100.000 F1800\n";
+	std::string moves;
+	for (int index = 1; index <= 16; index++)
+	{
+		double angle = 2.0 * PI_DOUBLE * index / 64;
+		moves += "G1 X" + utilities::dtos(100 + 10 * std::cos(angle), 3) + " Y" + utilities::dtos(100 + 10 * std::sin(angle), 3) + " E" + utilities::dtos(0.1 * index, 2) + "\n";
+	}
+	bool all_success = true;
+	arc_welder_args args;
+	args.max_gcode_length = 40;
+	std::string target = WeldGcode(args, header + moves + "M107\n");
+	if (target != header + moves + "M107\n")
+	{
+		std::cout << "The arc over the maximum gcode length was not aborted:\n" << target << std::endl;
+		all_success = false;
+	}
+	args.reduce_precision_to_fit = true;
+	target = WeldGcode(args, header + moves + "M107\n");
+	if (target != header + "G3 X100.00 Y110.00 I-10.00 J-0.00 E1.600\nM107\n")
+	{
+		std::cout << "The reduced precision arc is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+
+	// E is lowered first, one decimal at a time, and only then XYZ.  Relative E is never lowered.
+	struct precision_case { bool is_extruder_relative; int max_gcode_length; int xyz_precision; int e_precision; };
+	const precision_case cases[] = {
+		{ false, 46, 3, 5 }, { false, 45, 3, 4 }, { false, 44, 3, 3 }, { false, 43, 2, 3 },
+		{ true, 46, 3, 5 }, { true, 45, 2, 5 }
+	};
+	for (unsigned int index = 0; index < sizeof(cases) / sizeof(cases[0]); index++)
+	{
+		const precision_case& test_case = cases[index];
+		std::string source = test_case.is_extruder_relative ? "G90\nM83\nG1 X110.000 Y100.000 F1800\n" : header;
+		for (int segment = 1; segment <= 16; segment++)
+		{
+			double angle = 2.0 * PI_DOUBLE * segment / 64;
+			source += "G1 X" + utilities::dtos(100 + 10 * std::cos(angle), 3) + " Y" + utilities::dtos(100 + 10 * std::sin(angle), 3)
+				+ " E" + utilities::dtos(test_case.is_extruder_relative ? 0.1 : 0.1 * segment, 2) + "\n";
+		}
+		args.max_gcode_length = test_case.max_gcode_length;
+		target = WeldGcode(args, source + "M107\n");
+		size_t arc_position = target.find("G3");
+		std::string arc = arc_position == std::string::npos ? "" : target.substr(arc_position, target.find('\n', arc_position) - arc_position);
+		int xyz_precision = -1;
+		int e_precision = -1;
+		if (arc.length() > 0)
+		{
+			xyz_precision = (int)(arc.find(' ', arc.find(" X") + 1) - arc.find('.') - 1);
+			e_precision = (int)(arc.length() - arc.find('.', arc.find(" E")) - 1);
+		}
+		if (xyz_precision != test_case.xyz_precision || e_precision != test_case.e_precision || (int)arc.length() > test_case.max_gcode_length)
+		{
+			std::cout << "With a maximum gcode length of " << test_case.max_gcode_length << " and " << (test_case.is_extruder_relative ? "relative" : "absolute")
+				<< " extrusion, the precision should be " << test_case.xyz_precision << "/" << test_case.e_precision << ":\n" << target << std::endl;
+			all_success = false;
+		}
+	}
+	return all_success;
+}
+
+bool TestCompactOutput()
+{
+	// Compact output drops trailing and leading zeros, unchanged Z and F, and writes the arc with R since that is
+	// shorter.  Comments are only removed when they are stripped.
+	const std::string source = "G90\nM83\nG1 X110.000 Y100.000 Z0.200 F1800 ; start\n" + GetCircleGcode(10, 64, 0, 16, "G1", false)
+		+ "G1 X100.000 Y90.000 Z0.200 F1800\nM107\n";
+	bool all_success = true;
+	std::string target = WeldGcode(arc_welder_args(), source);
+	if (target != "G90\nM83\nG1 X110.000 Y100.000 Z0.200 F1800 ; start\nG3 X100.000 Y110.000 I-10.000 J-0.000 E0.16000\nG1 X100.000 Y90.000 Z0.200 F1800\nM107\n")
+	{
+		std::cout << "The standard output is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+	arc_welder_args args;
+	args.compact_output = true;
+	target = WeldGcode(args, source);
+	if (target != "G90\nM83\nG1 X110 Y100 Z.2 F1800; start\nG3 X100 Y110 R10 E.16\nG1 X100 Y90\nM107\n")
+	{
+		std::cout << "The compact output is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+	args.strip_comments = true;
+	target = WeldGcode(args, source);
+	if (target != "G90\nM83\nG1 X110 Y100 Z.2 F1800\nG3 X100 Y110 R10 E.16\nG1 X100 Y90\nM107\n")
+	{
+		std::cout << "The compact output without comments is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+
+	// Three quarters of a circle is over 180 degrees, so R must be negative.  The firmware picks the center on the far
+	// side of the chord from a negative R, which must be the real center.
+	const std::string large_arc_source = "G90\nM83\nG1 X110.000 Y100.000 F1800\n" + GetCircleGcode(10, 64, 0, 48, "G1", false) + "M107\n";
+	args.strip_comments = false;
+	target = WeldGcode(args, large_arc_source);
+	if (target != "G90\nM83\nG1 X110 Y100 F1800\nG3 X100 Y90 R-10 E.48\nM107\n")
+	{
+		std::cout << "The compact output of an arc over 180 degrees is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+	else
+	{
+		// The same calculation Marlin uses to find the center from R.
+		double r = -10, x = 100, y = 90, start_x = 110, start_y = 100;
+		double dx = x - start_x, dy = y - start_y, d = utilities::hypot(dx, dy);
+		double h = std::sqrt((r - 0.5 * d) * (r + 0.5 * d));
+		double direction = (r < 0) ? -1 : 1;
+		double center_x = (start_x + x) * 0.5 - direction * h * dy / d;
+		double center_y = (start_y + y) * 0.5 + direction * h * dx / d;
+		if (!utilities::is_equal(center_x, 100, 0.0005) || !utilities::is_equal(center_y, 100, 0.0005))
+		{
+			std::cout << "The compact arc over 180 degrees has its center at (" << center_x << ", " << center_y << ") instead of (100, 100)." << std::endl;
+			all_success = false;
+		}
+	}
+	return all_success;
+}
+
+bool TestWeldThroughComments()
+{
+	// Lines carried between the moves of an arc are written just before it, and lines carried after its last move are
+	// written after it.  Layer change comments are never carried, so they end the arc.
+	const std::string header = "G90\nM83\nG1 X110.000 Y100.000 F1800\n";
+	const std::string source = header + GetCircleGcode(10, 64, 0, 8, "G1", false) + ";mid comment\nM117 mid\n"
+		+ GetCircleGcode(10, 64, 8, 16, "G1", false) + ";after comment\nM73 P50\nG0 Z0.4\nM107\n";
+	bool all_success = true;
+	std::string target = WeldGcode(arc_welder_args(), source);
+	if (target != header + "G3 X107.071 Y107.071 I-9.996 J0.001 E0.08000\n;mid comment\nM117 mid\n"
+		"G3 X100.000 Y110.000 I-7.070 J-7.067 E0.08000\n;after comment\nM73 P50\nG0 Z0.4\nM107\n")
+	{
+		std::cout << "The output without welding through comments is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+	arc_welder_args args;
+	args.weld_through_comments = true;
+	target = WeldGcode(args, source);
+	if (target != header + ";mid comment\nM117 mid\nG3 X100.000 Y110.000 I-10.000 J-0.000 E0.16000\n"
+		";after comment\nM73 P50\nG0 Z0.4\nM107\n" || std::fabs(GetTotalE(target) - GetTotalE(source)) > 0.000001)
+	{
+		std::cout << "The output welded through comments is wrong:\n" << target << std::endl;
+		all_success = false;
+	}
+	const std::string layer_source = header + GetCircleGcode(10, 64, 0, 8, "G1", false) + ";LAYER:1\n"
+		+ GetCircleGcode(10, 64, 8, 16, "G1", false) + "M107\n";
+	target = WeldGcode(args, layer_source);
+	if (target != header + "G3 X107.071 Y107.071 I-9.996 J0.001 E0.08000\n;LAYER:1\n"
+		"G3 X100.000 Y110.000 I-7.070 J-7.067 E0.08000\nM107\n")
+	{
+		std::cout << "A layer change comment was carried:\n" << target << std::endl;
+		all_success = false;
+	}
+	// PrusaSlicer writes feature and width markers inside the perimeters.  They end the arc even when the feature type
+	// doesn't change, while the progress line is still carried.
+	const std::string prusa_header = "G90\nM83\n;TYPE:Perimeter\nG1 X110.000 Y100.000 F1800\n";
+	const std::string prusa_source = prusa_header + GetCircleGcode(10, 64, 0, 4, "G1", false) + "M73 P25 R1\n"
+		+ GetCircleGcode(10, 64, 4, 8, "G1", false) + ";WIDTH:0.45\n" + GetCircleGcode(10, 64, 8, 16, "G1", false)
+		+ ";TYPE:Perimeter\n" + GetCircleGcode(10, 64, 16, 24, "G1", false) + ";TYPE:Overhang perimeter\n"
+		+ GetCircleGcode(10, 64, 24, 32, "G1", false) + "M107\n";
+	target = WeldGcode(args, prusa_source);
+	if (target != prusa_header + "M73 P25 R1\nG3 X107.071 Y107.071 I-9.996 J0.001 E0.08000\n;WIDTH:0.45\n"
+		"G3 X100.000 Y110.000 I-7.070 J-7.067 E0.08000\n;TYPE:Perimeter\nG3 X92.929 Y107.071 I-0.001 J-9.996 E0.08000\n"
+		";TYPE:Overhang perimeter\nG3 X90.000 Y100.000 I7.067 J-7.070 E0.08000\nM107\n"
+		|| std::fabs(GetTotalE(target) - GetTotalE(prusa_source)) > 0.000001)
+	{
+		std::cout << "An arc was welded through a PrusaSlicer feature comment:\n" << target << std::endl;
+		all_success = false;
+	}
+	return all_success;
+}
+
+static std::string RemoveSpaces(const std::string& gcode)
+{
+	// Removes the spaces from the G lines, as MeatPack encoded blocks are written in no spaces mode.
+	std::stringstream stream(gcode);
+	std::string unpacked;
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (line.length() > 0 && line[0] == 'G')
+		{
+			line.erase(std::remove(line.begin(), line.end(), ' '), line.end());
+		}
+		unpacked += line;
+		unpacked += '\n';
+	}
+	return unpacked;
+}
+
+static bool ReadBgcode(const std::string& file, std::vector<bgcode_block>& blocks, std::string& gcode, std::string& error)
+{
+	// Reads every block of a binary gcode file, and appends the text of the gcode blocks to gcode.
+	std::stringstream stream(file);
+	bgcode_reader reader;
+	bgcode_block block;
+	if (!reader.read_file_header(stream) || reader.get_version() != 1 || reader.get_checksum_type() != bgcode_checksum_crc32)
+	{
+		error = "The file header is wrong. " + reader.get_error();
+		return false;
+	}
+	while (reader.read_block(stream, block))
+	{
+		if (block.type == bgcode_block_gcode && !reader.append_gcode(block, gcode))
+		{
+			break;
+		}
+		blocks.push_back(block);
+	}
+	error = reader.get_error();
+	return error.empty();
+}
+
+bool TestBinaryGcodeFile()
+{
+	// A reference file laid out like PrusaSlicer writes it: file, printer, thumbnail, print and slicer metadata blocks,
+	// the last two deflated, and two gcode blocks.  The first gcode block is heatshrink 12,4 compressed and MeatPack
+	// encoded with comments, and the second is heatshrink 11,4 compressed and MeatPack encoded without them.  The bytes
+	// were assembled from the binary gcode, heatshrink and MeatPack specifications rather than by bgcode_writer, so
+	// both sides of the format are checked against something other than this library.
+	static const unsigned char reference_file[] = {
+		0x47, 0x43, 0x44, 0x45, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1b, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x50, 0x72, 0x6f, 0x64, 0x75, 0x63, 0x65, 0x72, 0x3d, 0x50, 0x72, 0x75,
+		0x73, 0x61, 0x53, 0x6c, 0x69, 0x63, 0x65, 0x72, 0x20, 0x32, 0x2e, 0x36, 0x2e, 0x30, 0x0a, 0x99,
+		0x90, 0x08, 0x42, 0x03, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x72, 0x69,
+		0x6e, 0x74, 0x65, 0x72, 0x5f, 0x6d, 0x6f, 0x64, 0x65, 0x6c, 0x3d, 0x4d, 0x4b, 0x34, 0x0a, 0x66,
+		0x69, 0x6c, 0x61, 0x6d, 0x65, 0x6e, 0x74, 0x5f, 0x74, 0x79, 0x70, 0x65, 0x3d, 0x50, 0x4c, 0x41,
+		0x0a, 0x6e, 0x6f, 0x7a, 0x7a, 0x6c, 0x65, 0x5f, 0x64, 0x69, 0x61, 0x6d, 0x65, 0x74, 0x65, 0x72,
+		0x3d, 0x30, 0x2e, 0x34, 0x0a, 0x0e, 0x63, 0x1a, 0xa5, 0x05, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x10, 0x00, 0x10, 0x00, 0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x6e,
+		0x6f, 0x74, 0x20, 0x72, 0x65, 0x61, 0x6c, 0x6c, 0x79, 0x20, 0x61, 0x20, 0x70, 0x6e, 0x67, 0xfb,
+		0xc7, 0xed, 0xc5, 0x04, 0x00, 0x01, 0x00, 0x44, 0x00, 0x00, 0x00, 0x49, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x78, 0xda, 0x4b, 0xcb, 0xcc, 0x49, 0xcc, 0x4d, 0xcd, 0x2b, 0x51, 0x28, 0x2d, 0x4e, 0x4d,
+		0x51, 0x88, 0xce, 0xcd, 0x8d, 0xb5, 0x35, 0xd4, 0x33, 0x32, 0xe6, 0x4a, 0x2d, 0x2e, 0xc9, 0xcc,
+		0x4d, 0x2c, 0x01, 0x8a, 0x15, 0x14, 0x65, 0xe6, 0x95, 0x64, 0xe6, 0xa5, 0x2b, 0x00, 0x05, 0x52,
+		0x15, 0x34, 0xf2, 0xf2, 0x8b, 0x72, 0x13, 0x73, 0x14, 0x72, 0xf3, 0x53, 0x52, 0x35, 0x6d, 0x0d,
+		0x73, 0x15, 0x8c, 0x8a, 0xb9, 0x00, 0x42, 0xdd, 0x17, 0x62, 0xa9, 0x0b, 0x1d, 0x8a, 0x02, 0x00,
+		0x01, 0x00, 0x1e, 0x00, 0x00, 0x00, 0x26, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0xda, 0xcb, 0x49,
+		0xac, 0x4c, 0x2d, 0x8a, 0xcf, 0x48, 0xcd, 0x4c, 0xcf, 0x28, 0xb1, 0x35, 0xd0, 0x33, 0xe2, 0x2a,
+		0x48, 0x2d, 0xca, 0xcc, 0x4d, 0x2d, 0x49, 0x2d, 0x2a, 0xb6, 0x35, 0xe2, 0x02, 0x00, 0xac, 0x7b,
+		0x0a, 0x86, 0xce, 0xcc, 0x25, 0x79, 0x01, 0x00, 0x03, 0x00, 0x12, 0x01, 0x00, 0x00, 0xe0, 0x00,
+		0x00, 0x00, 0x02, 0x00, 0xff, 0xff, 0xff, 0x7f, 0xff, 0xff, 0xde, 0xff, 0x4d, 0xf9, 0xc8, 0x21,
+		0xf5, 0x0f, 0xfc, 0x82, 0xa5, 0xc1, 0xce, 0xf0, 0x31, 0xf4, 0xde, 0x1f, 0xff, 0xff, 0xfa, 0x9d,
+		0xd5, 0x2b, 0x35, 0x0a, 0x2c, 0xea, 0x8b, 0x78, 0xba, 0x59, 0x6e, 0x56, 0xeb, 0x0d, 0xb2, 0x41,
+		0x70, 0xb2, 0xdc, 0xad, 0x36, 0xdb, 0x28, 0x03, 0x0a, 0x14, 0x03, 0x02, 0x8e, 0xc7, 0xa0, 0x30,
+		0xa8, 0x04, 0x7e, 0xb3, 0x00, 0x00, 0x21, 0x51, 0xa1, 0x1c, 0x08, 0xec, 0x7b, 0x21, 0x9a, 0x92,
+		0x80, 0x34, 0xb3, 0x50, 0x88, 0x5c, 0x2b, 0x82, 0x00, 0xc2, 0xc5, 0x60, 0x23, 0xf5, 0x98, 0x86,
+		0x6a, 0x2a, 0x00, 0xc5, 0xad, 0x65, 0xa3, 0xf5, 0x99, 0x06, 0x6a, 0x60, 0x00, 0xc5, 0x95, 0x64,
+		0xe3, 0xf5, 0x99, 0x86, 0x2a, 0xe4, 0x00, 0xc4, 0xc0, 0x62, 0xb2, 0x31, 0xfa, 0xcd, 0x02, 0xf5,
+		0x41, 0x00, 0x62, 0xce, 0xaa, 0x31, 0xfa, 0xcd, 0x42, 0xb5, 0x65, 0x00, 0x62, 0x5c, 0x2f, 0x50,
+		0x38, 0xfd, 0x66, 0xc1, 0x3a, 0xa2, 0x00, 0x31, 0x61, 0x51, 0x78, 0xfd, 0x64, 0x00, 0x84, 0x00,
+		0xc4, 0x00, 0xa1, 0x00, 0x30, 0xaf, 0x50, 0x30, 0x06, 0x20, 0x0b, 0x8a, 0x3f, 0x59, 0x01, 0xc1,
+		0x00, 0x31, 0x00, 0x90, 0x40, 0x0c, 0x2c, 0x56, 0x44, 0x01, 0x88, 0x06, 0x22, 0x8f, 0xd6, 0x40,
+		0xd8, 0x40, 0x0c, 0x40, 0x3e, 0x10, 0x03, 0x0a, 0xb5, 0x96, 0x00, 0x62, 0x02, 0x58, 0x80, 0x18,
+		0x58, 0xac, 0x00, 0x03, 0x10, 0x16, 0x04, 0x00, 0xc2, 0xcd, 0x49, 0x40, 0x18, 0xa0, 0xd0, 0x30,
+		0x6a, 0x90, 0x03, 0x08, 0x5f, 0xe8, 0xad, 0x8f, 0x01, 0x00, 0x02, 0x00, 0xe5, 0x00, 0x00, 0x00,
+		0xb4, 0x00, 0x00, 0x00, 0x01, 0x00, 0xff, 0xff, 0xff, 0x7f, 0xff, 0xff, 0xde, 0xff, 0x4d, 0xf9,
+		0xc8, 0x2b, 0xf5, 0x0f, 0x84, 0x82, 0x1f, 0x52, 0xe6, 0x47, 0x73, 0xda, 0x99, 0x07, 0xc2, 0xb3,
+		0x01, 0xd4, 0xd6, 0x76, 0x5a, 0x08, 0x80, 0x06, 0x16, 0xa2, 0x81, 0xf9, 0x00, 0xc2, 0x84, 0x6e,
+		0x00, 0x31, 0x34, 0xf9, 0x0f, 0xb8, 0x06, 0x15, 0x97, 0x72, 0x01, 0x89, 0xa6, 0xb8, 0xfc, 0xc0,
+		0x30, 0xa6, 0x40, 0x18, 0xba, 0x5c, 0x17, 0xda, 0xb3, 0x01, 0xd4, 0x46, 0x00, 0x31, 0x74, 0x94,
+		0x4f, 0xa0, 0x06, 0x14, 0x4f, 0x6a, 0x01, 0x89, 0xa3, 0xab, 0x00, 0xc9, 0x69, 0xe6, 0xfb, 0x00,
+		0x0c, 0x4d, 0x14, 0xa4, 0x13, 0x4b, 0x4f, 0x70, 0xd8, 0x80, 0x62, 0xdc, 0x81, 0x9c, 0xb4, 0xd4,
+		0x3d, 0xa0, 0x06, 0x26, 0x87, 0x0d, 0xf5, 0xac, 0xc0, 0x74, 0xb5, 0x5d, 0xb0, 0x06, 0x2e, 0x07,
+		0xe3, 0x59, 0x80, 0xe9, 0x22, 0xe0, 0x32, 0xba, 0x0b, 0x38, 0x06, 0x16, 0x8e, 0x51, 0xb7, 0x00,
+		0xc5, 0x9a, 0x00, 0x61, 0x68, 0xa1, 0x3b, 0x30, 0x0c, 0x5c, 0x8f, 0xca, 0xb3, 0x01, 0xd0, 0xd6,
+		0x41, 0x35, 0x74, 0x14, 0x0f, 0xc5, 0x66, 0x03, 0xa0, 0xc4, 0x83, 0x3a, 0xe8, 0x20, 0x00, 0xb4,
+		0x5a, 0x08, 0x00, 0x06, 0x1c, 0x7e, 0x9b, 0x70, 0xe6, 0x00, 0xee, 0xb1, 0xe5, 0x94
+	};
+	const std::string file(reinterpret_cast<const char*>(reference_file), sizeof(reference_file));
+	const std::string gcode = "M73 P0 R1\nG90\nM83\n;TYPE:External perimeter\n" + RemoveSpaces("G1 X110.000 Y100.000 F1800\n"
+		+ GetCircleGcode(10, 64, 0, 16, "G1", false) + "M73 P50 R0\n" + GetCircleGcode(10, 64, 16, 32, "G1", false)) + "M107\n";
+	static const uint16_t block_types[] = {
+		bgcode_block_file_metadata, bgcode_block_printer_metadata, bgcode_block_thumbnail, bgcode_block_print_metadata,
+		bgcode_block_slicer_metadata, bgcode_block_gcode, bgcode_block_gcode
+	};
+	static const uint16_t block_compressions[] = {
+		bgcode_compression_none, bgcode_compression_none, bgcode_compression_none, bgcode_compression_deflate,
+		bgcode_compression_deflate, bgcode_compression_heatshrink_12_4, bgcode_compression_heatshrink_11_4
+	};
+	const int num_blocks = sizeof(block_types) / sizeof(block_types[0]);
+	bool all_success = true;
+
+	std::vector<bgcode_block> blocks;
+	std::string unpacked;
+	std::string error;
+	bool success = ReadBgcode(file, blocks, unpacked, error) && blocks.size() == num_blocks;
+	for (int index = 0; success && index < num_blocks; index++)
+	{
+		success = blocks[index].type == block_types[index] && blocks[index].compression == block_compressions[index];
+	}
+	if (!success || blocks[1].data != "printer_model=MK4\nfilament_type=PLA\nnozzle_diameter=0.4\n"
+		|| blocks[2].parameters != std::string("\0\0\x10\0\x10\0", 6) || blocks[5].get_encoding() != bgcode_gcode_encoding_meatpack_comments
+		|| blocks[6].get_encoding() != bgcode_gcode_encoding_meatpack || unpacked != gcode)
+	{
+		std::cout << "The reference binary gcode file was read wrong. " << error << "\n" << unpacked << std::endl;
+		return false;
+	}
+
+	// Welding the file must copy the metadata blocks unchanged, and write the welded gcode in the format of the first
+	// gcode block.
+	static const char* source_path = "bgcode_test_source.bgcode";
+	static const char* target_path = "bgcode_test_target.bgcode";
+	std::ofstream source_file(source_path, std::ios::binary);
+	source_file << file;
+	source_file.close();
+	WeldFile(arc_welder_args(), source_path, target_path);
+	std::ifstream target_file(target_path, std::ios::binary);
+	std::stringstream target;
+	target << target_file.rdbuf();
+	target_file.close();
+	std::remove(source_path);
+	std::remove(target_path);
+
+	std::vector<bgcode_block> welded_blocks;
+	std::string welded;
+	success = ReadBgcode(target.str(), welded_blocks, welded, error) && welded_blocks.size() > 5;
+	for (int index = 0; success && index < static_cast<int>(welded_blocks.size()); index++)
+	{
+		const bgcode_block& block = welded_blocks[index];
+		if (index < 5)
+		{
+			success = block.type == blocks[index].type && block.compression == blocks[index].compression
+				&& block.uncompressed_size == blocks[index].uncompressed_size && block.parameters == blocks[index].parameters
+				&& block.data == blocks[index].data;
+		}
+		else
+		{
+			success = block.type == bgcode_block_gcode && block.compression == bgcode_compression_heatshrink_12_4
+				&& block.get_encoding() == bgcode_gcode_encoding_meatpack_comments;
+		}
+	}
+	// MeatPack drops the blank line that ends the header, so the header ends where the source gcode starts.
+	const std::string expected = RemoveSpaces(WeldGcode(arc_welder_args(), gcode));
+	const size_t gcode_start = welded.find(gcode.substr(0, gcode.find('\n') + 1));
+	if (!success || gcode_start == std::string::npos || welded.substr(gcode_start) != expected || expected.find("G3") == std::string::npos)
+	{
+		std::cout << "The welded reference binary gcode file is wrong. " << error << "\n" << welded << std::endl;
+		all_success = false;
+	}
+	return all_success;
+}
@@ -35,9 +35,16 @@
 #include "gcode_parser.h"
 #include <sstream>
 #include "arc_welder.h"
+#include "deviation_kernels.h"
 #include "array_list.h"
+#include "circular_buffer.h"
 #include "logger.h"
+#include "meatpack.h"
+#include "bgcode.h"
+#include "line_numbers.h"
+#include "compressed_file.h"
 #include <exception>
+#include <algorithm>
 
 int run_tests(int argc, char* argv[]);
 static gcode_position_args get_single_extruder_position_args();
@@ -50,6 +57,25 @@ bool CompareDoubleToStringResult(double value, unsigned char precision);
 bool TestIntToStringRandom(int low, int high, int num_runs);
 bool TestDoubleToStringRandom(double low, double high, int num_runs);
 bool TestProblemDoubles();
+bool TestDeviationKernels(int num_runs);
+bool TestMeatPack(int num_runs);
+bool TestBinaryGcode(int num_runs);
+bool TestLineNumbers();
+bool TestCompressedFiles();
+bool TestMergeArcs();
+bool TestPushOwnItem();
+bool TestRelativeArcs();
+bool TestRelativeInterpolation();
+bool TestLeastSquaresCircle();
+bool TestFeatureTolerances();
+bool TestCurvaturePrefilter();
+bool TestLookahead();
+bool TestBezierCurves();
+bool TestSimplifyPolylines();
+bool TestReducePrecisionToFit();
+bool TestCompactOutput();
+bool TestWeldThroughComments();
+bool TestBinaryGcodeFile();
 
 static std::string ANTI_STUTTER_TEST = "C:\\Users\\Brad\\Documents\\3DPrinter\\AntiStutter\\5x5_cylinder_2000Fn_0.2mm_PLA_MK2.5MMU2_4m.gcode";
 static std::string BENCHY_GCODE = "C:\\Users\\Brad\\Documents\\3DPrinter\\Calibration\\Benchy\\3DBenchy_0.2mm_PLA_MK2.5MMU2.gcode";
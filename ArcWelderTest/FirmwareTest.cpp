@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Arc Welder: Test Application
+//
+// Tests of the firmware arc interpolation used by the inverse processor.  The firmware headers define some of the
+// same macros as the anti-stutter library with different values, so these tests are kept out of ArcWelderTest.cpp.
+//
+// Built using the 'Arc Welder: Anti Stutter' library
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address: 
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include "gcode_parser.h"
+#include "utilities.h"
+#include "prusa.h"
+#include "marlin_1.h"
+#include "repetier.h"
+
+bool TestRelativeInterpolation()
+{
+	// Each relative segment is written rounded to 3 decimals.  The firmware must keep the position it actually wrote,
+	// otherwise the rounding errors add up and the interpolated half circle ends away from the arc's endpoint.
+	bool all_success = true;
+	gcode_parser parser;
+	firmware_arguments args;
+	prusa prusa_firmware(args);
+	marlin_1 marlin_1_firmware(args);
+	repetier repetier_firmware(args);
+	firmware* firmwares[] = { &prusa_firmware, &marlin_1_firmware, &repetier_firmware };
+	const char* names[] = { "prusa", "marlin_1", "repetier" };
+	for (unsigned int index = 0; index < 3; index++)
+	{
+		firmware_state state;
+		state.is_relative = true;
+		state.is_extruder_relative = true;
+		firmwares[index]->set_current_state(state);
+		firmware_position current;
+		current.x = 110;
+		current.y = 100;
+		current.z = 0.2;
+		current.f = 1800;
+		firmwares[index]->set_current_position(current);
+		firmware_position target = current;
+		target.x = 90;
+		target.e = 1;
+		std::stringstream gcodes(firmwares[index]->interpolate_arc(target, -10, 0, 10, false));
+		double x = 0, y = 0, e = 0;
+		int segments = 0;
+		std::string line;
+		while (std::getline(gcodes, line))
+		{
+			if (line.empty())
+			{
+				continue;
+			}
+			parsed_command command = parser.parse_gcode(line.c_str());
+			for (unsigned int parameter_index = 0; parameter_index < command.parameters.size(); parameter_index++)
+			{
+				const parsed_command_parameter& parameter = command.parameters[parameter_index];
+				if (parameter.name == "X")
+				{
+					x += parameter.double_value;
+				}
+				else if (parameter.name == "Y")
+				{
+					y += parameter.double_value;
+				}
+				else if (parameter.name == "E")
+				{
+					e += parameter.double_value;
+				}
+			}
+			segments++;
+		}
+		if (segments < 2 || !utilities::is_equal(x, -20, 0.0000001) || !utilities::is_equal(y, 0, 0.0000001) || !utilities::is_equal(e, 1, 0.0000001))
+		{
+			std::cout << std::fixed << std::setprecision(6) << "The relative " << names[index] << " interpolation of " << segments << " segments ends at X" << x << " Y" << y << " E" << e << " instead of X-20 Y0 E1." << std::endl;
+			all_success = false;
+		}
+	}
+	return all_success;
+}
@@ -23,6 +23,7 @@
 
 #pragma once
 #include <exception>
+#include <utility>
 template <typename T>
 class array_list
 {
@@ -54,7 +55,7 @@ public:
 		T* new_items = new T[max_size];
 		for (int index = 0; index < count_; index++)
 		{
-			new_items[index] = items_[(front_index_ + index + max_size_) % max_size_];
+			new_items[index] = std::move(items_[(front_index_ + index + max_size_) % max_size_]);
 		}
 		front_index_ = 0;
 		delete[] items_;
@@ -72,43 +73,18 @@ public:
 		return index_position;
 	}
 
+	// object is taken by value so that it is copied before the list grows.  It may be an item in this list, and growing
+	// frees the old items.
 	void push_front(T object)
 	{
-		if (count_ == max_size_)
-		{
-			if (auto_grow_)
-			{
-				resize(max_size_ * 2);
-			}
-			else {
-				throw std::exception();
-			}
-		}
-		//front_index_ = (front_index_ - 1 + max_size_) % max_size_;
-		front_index_ -= 1;
-		if (front_index_ < 0)
-		{
-			front_index_ = max_size_ - 1;
-		}
-		count_++;
-		items_[front_index_] = object;
+		int pos = make_front_slot();
+		items_[pos] = std::move(object);
 	}
 
 	void push_back(T object)
 	{
-		if (count_ == max_size_)
-		{
-			if (auto_grow_)
-			{
-				resize(max_size_ * 2);
-			}
-			else {
-				throw std::exception();
-			}
-		}
-		int pos = get_index_position(count_);
-		items_[pos] = object;
-		count_++;
+		int pos = make_back_slot();
+		items_[pos] = std::move(object);
 	}
 
 	T& pop_front()
@@ -184,6 +160,43 @@ public:
 	}
 
 protected:
+	// Reserves a slot at the front of the list and returns its index
+	int make_front_slot()
+	{
+		ensure_capacity();
+		//front_index_ = (front_index_ - 1 + max_size_) % max_size_;
+		front_index_ -= 1;
+		if (front_index_ < 0)
+		{
+			front_index_ = max_size_ - 1;
+		}
+		count_++;
+		return front_index_;
+	}
+
+	// Reserves a slot at the back of the list and returns its index
+	int make_back_slot()
+	{
+		ensure_capacity();
+		int pos = get_index_position(count_);
+		count_++;
+		return pos;
+	}
+
+	void ensure_capacity()
+	{
+		if (count_ == max_size_)
+		{
+			if (auto_grow_)
+			{
+				resize(max_size_ * 2);
+			}
+			else {
+				throw std::exception();
+			}
+		}
+	}
+
 	T* items_;
 	int  max_size_;
 	int  front_index_;
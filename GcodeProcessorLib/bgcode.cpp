@@ -0,0 +1,607 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Gcode Processor Library
+//
+// Tools for parsing gcode and calculating printer state from parsed gcode commands.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address:
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "bgcode.h"
+#include <fstream>
+#include <vector>
+#include <cstring>
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+static void append_uint16(std::string& output, uint16_t value)
+{
+	output += static_cast<char>(value & 0xFF);
+	output += static_cast<char>((value >> 8) & 0xFF);
+}
+
+static void append_uint32(std::string& output, uint32_t value)
+{
+	append_uint16(output, static_cast<uint16_t>(value & 0xFFFF));
+	append_uint16(output, static_cast<uint16_t>((value >> 16) & 0xFFFF));
+}
+
+static uint16_t get_uint16(const char* data)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t get_uint32(const char* data)
+{
+	return static_cast<uint32_t>(get_uint16(data)) | (static_cast<uint32_t>(get_uint16(data + 2)) << 16);
+}
+
+static bool is_heatshrink(uint16_t compression)
+{
+	return compression == bgcode_compression_heatshrink_11_4 || compression == bgcode_compression_heatshrink_12_4;
+}
+
+static int get_heatshrink_window_bits(uint16_t compression)
+{
+	return compression == bgcode_compression_heatshrink_11_4 ? 11 : 12;
+}
+
+#define HEATSHRINK_MIN_MATCH 2
+#define HEATSHRINK_MAX_CHAIN 128
+
+namespace bgcode
+{
+	uint32_t crc32(uint32_t crc, const char* data, size_t length)
+	{
+		static uint32_t table[256];
+		static bool table_created = false;
+		if (!table_created)
+		{
+			for (uint32_t index = 0; index < 256; index++)
+			{
+				uint32_t value = index;
+				for (int bit = 0; bit < 8; bit++)
+				{
+					value = (value & 1) ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+				}
+				table[index] = value;
+			}
+			table_created = true;
+		}
+		crc = ~crc;
+		for (size_t index = 0; index < length; index++)
+		{
+			crc = table[(crc ^ static_cast<unsigned char>(data[index])) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	// Bits are written most significant first, and the last byte is padded with zeros.
+	class bit_writer
+	{
+	public:
+		bit_writer(std::string& output) : output_(output), current_(0), count_(0) {}
+		void append(unsigned int value, int bits)
+		{
+			for (int bit = bits - 1; bit >= 0; bit--)
+			{
+				current_ = static_cast<unsigned char>((current_ << 1) | ((value >> bit) & 1));
+				if (++count_ == 8)
+				{
+					output_ += static_cast<char>(current_);
+					current_ = 0;
+					count_ = 0;
+				}
+			}
+		}
+		void flush()
+		{
+			if (count_ > 0)
+			{
+				output_ += static_cast<char>(current_ << (8 - count_));
+				current_ = 0;
+				count_ = 0;
+			}
+		}
+	private:
+		std::string& output_;
+		unsigned char current_;
+		int count_;
+	};
+
+	class bit_reader
+	{
+	public:
+		bit_reader(const std::string& input) : input_(input), index_(0), bit_(0) {}
+		bool read(int bits, unsigned int& value)
+		{
+			value = 0;
+			for (int count = 0; count < bits; count++)
+			{
+				if (index_ >= input_.length())
+				{
+					return false;
+				}
+				value = (value << 1) | ((static_cast<unsigned char>(input_[index_]) >> (7 - bit_)) & 1);
+				if (++bit_ == 8)
+				{
+					bit_ = 0;
+					index_++;
+				}
+			}
+			return true;
+		}
+	private:
+		const std::string& input_;
+		size_t index_;
+		int bit_;
+	};
+
+	void heatshrink_compress(const std::string& data, int window_bits, int lookahead_bits, std::string& compressed)
+	{
+		// Greedy matching, with the previous positions of every pair of bytes kept in a hash chain.
+		const size_t window_size = static_cast<size_t>(1) << window_bits;
+		const size_t max_match = static_cast<size_t>(1) << lookahead_bits;
+		const size_t length = data.length();
+		std::vector<int> head(65536, -1);
+		std::vector<int> previous(length, -1);
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.c_str());
+		bit_writer writer(compressed);
+		size_t index = 0;
+		while (index < length)
+		{
+			size_t best_length = 0;
+			size_t best_distance = 0;
+			if (index + HEATSHRINK_MIN_MATCH <= length)
+			{
+				size_t limit = length - index < max_match ? length - index : max_match;
+				int candidate = head[(bytes[index] << 8) | bytes[index + 1]];
+				for (int chain = 0; candidate >= 0 && chain < HEATSHRINK_MAX_CHAIN; chain++)
+				{
+					size_t distance = index - static_cast<size_t>(candidate);
+					if (distance > window_size)
+					{
+						break;
+					}
+					size_t match = 0;
+					while (match < limit && bytes[candidate + match] == bytes[index + match])
+					{
+						match++;
+					}
+					if (match > best_length)
+					{
+						best_length = match;
+						best_distance = distance;
+						if (match == limit)
+						{
+							break;
+						}
+					}
+					candidate = previous[candidate];
+				}
+			}
+			size_t step = 1;
+			if (best_length >= HEATSHRINK_MIN_MATCH)
+			{
+				writer.append(0, 1);
+				writer.append(static_cast<unsigned int>(best_distance - 1), window_bits);
+				writer.append(static_cast<unsigned int>(best_length - 1), lookahead_bits);
+				step = best_length;
+			}
+			else
+			{
+				writer.append(1, 1);
+				writer.append(bytes[index], 8);
+			}
+			for (size_t end = index + step; index < end; index++)
+			{
+				if (index + 1 < length)
+				{
+					int key = (bytes[index] << 8) | bytes[index + 1];
+					previous[index] = head[key];
+					head[key] = static_cast<int>(index);
+				}
+			}
+		}
+		writer.flush();
+	}
+
+	bool heatshrink_decompress(const std::string& compressed, size_t uncompressed_size, int window_bits, int lookahead_bits, std::string& data)
+	{
+		bit_reader reader(compressed);
+		size_t start = data.length();
+		while (data.length() - start < uncompressed_size)
+		{
+			unsigned int tag;
+			if (!reader.read(1, tag))
+			{
+				return false;
+			}
+			if (tag == 1)
+			{
+				unsigned int value;
+				if (!reader.read(8, value))
+				{
+					return false;
+				}
+				data += static_cast<char>(value);
+				continue;
+			}
+			unsigned int distance;
+			unsigned int count;
+			if (!reader.read(window_bits, distance) || !reader.read(lookahead_bits, count))
+			{
+				return false;
+			}
+			distance++;
+			count++;
+			if (distance > data.length() - start)
+			{
+				return false;
+			}
+			for (unsigned int index = 0; index < count && data.length() - start < uncompressed_size; index++)
+			{
+				data += data[data.length() - distance];
+			}
+		}
+		return true;
+	}
+}
+
+bgcode_block::bgcode_block()
+{
+	clear();
+}
+
+void bgcode_block::clear()
+{
+	type = bgcode_block_gcode;
+	compression = bgcode_compression_none;
+	uncompressed_size = 0;
+	compressed_size = 0;
+	parameters.clear();
+	data.clear();
+}
+
+uint16_t bgcode_block::get_encoding() const
+{
+	if (type == bgcode_block_thumbnail || parameters.length() < 2)
+	{
+		return 0;
+	}
+	return get_uint16(parameters.c_str());
+}
+
+bgcode_reader::bgcode_reader()
+{
+	version_ = BGCODE_VERSION;
+	checksum_type_ = bgcode_checksum_none;
+}
+
+bool bgcode_reader::is_bgcode_file(const std::string& path)
+{
+	std::ifstream file(path.c_str(), std::ifstream::in | std::ifstream::binary);
+	char magic[4];
+	if (!file.is_open() || !file.read(magic, 4))
+	{
+		return false;
+	}
+	return std::memcmp(magic, BGCODE_MAGIC, 4) == 0;
+}
+
+uint32_t bgcode_reader::get_version() const
+{
+	return version_;
+}
+
+uint16_t bgcode_reader::get_checksum_type() const
+{
+	return checksum_type_;
+}
+
+const std::string& bgcode_reader::get_error() const
+{
+	return error_;
+}
+
+bool bgcode_reader::read_file_header(std::istream& stream)
+{
+	char header[BGCODE_FILE_HEADER_SIZE];
+	if (!stream.read(header, BGCODE_FILE_HEADER_SIZE) || std::memcmp(header, BGCODE_MAGIC, 4) != 0)
+	{
+		error_ = "The file is not a binary gcode file.";
+		return false;
+	}
+	version_ = get_uint32(header + 4);
+	checksum_type_ = get_uint16(header + 8);
+	if (version_ != BGCODE_VERSION)
+	{
+		error_ = "Unsupported binary gcode version.";
+		return false;
+	}
+	if (checksum_type_ != bgcode_checksum_none && checksum_type_ != bgcode_checksum_crc32)
+	{
+		error_ = "Unsupported binary gcode checksum type.";
+		return false;
+	}
+	return true;
+}
+
+bool bgcode_reader::read_block(std::istream& stream, bgcode_block& block)
+{
+	block.clear();
+	char header[12];
+	if (!stream.read(header, 8))
+	{
+		if (stream.gcount() != 0)
+		{
+			error_ = "The binary gcode file ends in the middle of a block header.";
+		}
+		return false;
+	}
+	block.type = get_uint16(header);
+	block.compression = get_uint16(header + 2);
+	block.uncompressed_size = get_uint32(header + 4);
+	size_t header_size = 8;
+	if (block.compression != bgcode_compression_none)
+	{
+		if (!stream.read(header + 8, 4))
+		{
+			error_ = "The binary gcode file ends in the middle of a block header.";
+			return false;
+		}
+		block.compressed_size = get_uint32(header + 8);
+		header_size = 12;
+	}
+	if (block.type > bgcode_block_thumbnail)
+	{
+		error_ = "Unknown binary gcode block type.";
+		return false;
+	}
+	size_t data_size = block.compression == bgcode_compression_none ? block.uncompressed_size : block.compressed_size;
+	block.parameters.resize(block.type == bgcode_block_thumbnail ? 6 : 2);
+	block.data.resize(data_size);
+	if (!stream.read(&block.parameters[0], block.parameters.length())
+		|| (data_size > 0 && !stream.read(&block.data[0], data_size)))
+	{
+		error_ = "The binary gcode file ends in the middle of a block.";
+		return false;
+	}
+	if (checksum_type_ == bgcode_checksum_crc32)
+	{
+		char checksum[4];
+		if (!stream.read(checksum, 4))
+		{
+			error_ = "The binary gcode file ends in the middle of a block checksum.";
+			return false;
+		}
+		uint32_t crc = bgcode::crc32(0, header, header_size);
+		crc = bgcode::crc32(crc, block.parameters.c_str(), block.parameters.length());
+		crc = bgcode::crc32(crc, block.data.c_str(), block.data.length());
+		if (crc != get_uint32(checksum))
+		{
+			error_ = "A binary gcode block has an invalid checksum.";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool bgcode_reader::append_gcode(const bgcode_block& block, std::string& gcode)
+{
+	const std::string* p_encoded = &block.data;
+	if (block.compression != bgcode_compression_none)
+	{
+		decompressed_.clear();
+		if (block.compression == bgcode_compression_deflate)
+		{
+#ifdef HAS_ZLIB
+			decompressed_.resize(block.uncompressed_size);
+			uLongf length = block.uncompressed_size;
+			if (block.uncompressed_size > 0 && (uncompress(reinterpret_cast<Bytef*>(&decompressed_[0]), &length,
+				reinterpret_cast<const Bytef*>(block.data.c_str()), static_cast<uLong>(block.data.length())) != Z_OK
+				|| length != block.uncompressed_size))
+			{
+				error_ = "Unable to decompress a deflate compressed gcode block.";
+				return false;
+			}
+#else
+			error_ = "Deflate compressed binary gcode is not supported by this build.";
+			return false;
+#endif
+		}
+		else if (is_heatshrink(block.compression))
+		{
+			if (!bgcode::heatshrink_decompress(block.data, block.uncompressed_size, get_heatshrink_window_bits(block.compression), 4, decompressed_))
+			{
+				error_ = "Unable to decompress a heatshrink compressed gcode block.";
+				return false;
+			}
+		}
+		else
+		{
+			error_ = "Unknown binary gcode compression type.";
+			return false;
+		}
+		p_encoded = &decompressed_;
+	}
+
+	uint16_t encoding = block.get_encoding();
+	if (encoding == bgcode_gcode_encoding_none)
+	{
+		gcode.append(*p_encoded);
+	}
+	else if (encoding == bgcode_gcode_encoding_meatpack || encoding == bgcode_gcode_encoding_meatpack_comments)
+	{
+		// Every block is packed separately
+		meatpack_decoder decoder;
+		decoder.append_unpacked(*p_encoded, gcode);
+	}
+	else
+	{
+		error_ = "Unknown binary gcode encoding.";
+		return false;
+	}
+	return true;
+}
+
+bgcode_writer::bgcode_writer()
+{
+	checksum_type_ = bgcode_checksum_crc32;
+	gcode_compression_ = bgcode_compression_none;
+	gcode_encoding_ = bgcode_gcode_encoding_none;
+}
+
+void bgcode_writer::set_checksum_type(uint16_t checksum_type)
+{
+	checksum_type_ = checksum_type;
+}
+
+void bgcode_writer::set_gcode_format(uint16_t compression, uint16_t encoding)
+{
+#ifndef HAS_ZLIB
+	if (compression == bgcode_compression_deflate)
+	{
+		compression = bgcode_compression_heatshrink_12_4;
+	}
+#endif
+	gcode_compression_ = compression;
+	gcode_encoding_ = encoding;
+}
+
+uint16_t bgcode_writer::get_gcode_compression() const
+{
+	return gcode_compression_;
+}
+
+uint16_t bgcode_writer::get_gcode_encoding() const
+{
+	return gcode_encoding_;
+}
+
+void bgcode_writer::append_file_header(std::string& output) const
+{
+	output.append(BGCODE_MAGIC, 4);
+	append_uint32(output, BGCODE_VERSION);
+	append_uint16(output, checksum_type_);
+}
+
+void bgcode_writer::append_block(const bgcode_block& block, std::string& output)
+{
+	append_end(output);
+	append_block_(block.type, block.compression, block.uncompressed_size, block.compressed_size, block.parameters, block.data, output);
+}
+
+void bgcode_writer::append_gcode(const std::string& text, std::string& output)
+{
+	append_gcode(text.c_str(), text.length(), output);
+}
+
+void bgcode_writer::append_gcode(const char* text, size_t length, std::string& output)
+{
+	gcode_.append(text, length);
+	while (gcode_.length() >= BGCODE_MAX_GCODE_BLOCK_SIZE)
+	{
+		// Blocks end at a line break, so a very long line is kept whole.
+		size_t end = gcode_.rfind('\n', BGCODE_MAX_GCODE_BLOCK_SIZE - 1);
+		if (end == std::string::npos)
+		{
+			end = gcode_.find('\n', BGCODE_MAX_GCODE_BLOCK_SIZE);
+			if (end == std::string::npos)
+			{
+				return;
+			}
+		}
+		append_gcode_block_(end + 1, output);
+	}
+}
+
+void bgcode_writer::append_end(std::string& output)
+{
+	if (gcode_.length() > 0)
+	{
+		append_gcode_block_(gcode_.length(), output);
+	}
+}
+
+void bgcode_writer::append_gcode_block_(size_t length, std::string& output)
+{
+	encoded_.clear();
+	if (gcode_encoding_ == bgcode_gcode_encoding_none)
+	{
+		encoded_.append(gcode_, 0, length);
+	}
+	else
+	{
+		// No spaces mode is always used, since the parser doesn't need spaces between parameters.
+		meatpack_encoder encoder(true, gcode_encoding_ == bgcode_gcode_encoding_meatpack_comments);
+		encoder.append_start(encoded_);
+		encoder.append_packed(gcode_.c_str(), length, encoded_);
+		encoder.append_end(encoded_);
+	}
+	gcode_.erase(0, length);
+
+	compressed_.clear();
+	if (gcode_compression_ == bgcode_compression_deflate)
+	{
+#ifdef HAS_ZLIB
+		uLongf compressed_length = compressBound(static_cast<uLong>(encoded_.length()));
+		compressed_.resize(compressed_length);
+		if (compress2(reinterpret_cast<Bytef*>(&compressed_[0]), &compressed_length, reinterpret_cast<const Bytef*>(encoded_.c_str()),
+			static_cast<uLong>(encoded_.length()), Z_BEST_COMPRESSION) != Z_OK)
+		{
+			compressed_length = 0;
+		}
+		compressed_.resize(compressed_length);
+#endif
+	}
+	else if (is_heatshrink(gcode_compression_))
+	{
+		bgcode::heatshrink_compress(encoded_, get_heatshrink_window_bits(gcode_compression_), 4, compressed_);
+	}
+
+	std::string parameters;
+	append_uint16(parameters, gcode_encoding_);
+	uint32_t uncompressed_size = static_cast<uint32_t>(encoded_.length());
+	if (gcode_compression_ == bgcode_compression_none || compressed_.length() == 0)
+	{
+		append_block_(bgcode_block_gcode, bgcode_compression_none, uncompressed_size, 0, parameters, encoded_, output);
+	}
+	else
+	{
+		append_block_(bgcode_block_gcode, gcode_compression_, uncompressed_size, static_cast<uint32_t>(compressed_.length()), parameters, compressed_, output);
+	}
+}
+
+void bgcode_writer::append_block_(uint16_t type, uint16_t compression, uint32_t uncompressed_size, uint32_t compressed_size,
+	const std::string& parameters, const std::string& data, std::string& output)
+{
+	size_t start = output.length();
+	append_uint16(output, type);
+	append_uint16(output, compression);
+	append_uint32(output, uncompressed_size);
+	if (compression != bgcode_compression_none)
+	{
+		append_uint32(output, compressed_size);
+	}
+	output.append(parameters);
+	output.append(data);
+	if (checksum_type_ == bgcode_checksum_crc32)
+	{
+		append_uint32(output, bgcode::crc32(0, output.c_str() + start, output.length() - start));
+	}
+}
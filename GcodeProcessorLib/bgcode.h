@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Gcode Processor Library
+//
+// Tools for parsing gcode and calculating printer state from parsed gcode commands.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address:
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <string>
+#include <istream>
+#include <cstdint>
+#include "meatpack.h"
+
+// Prusa binary gcode (.bgcode) is a file header followed by blocks.  Each block has a header, parameters, data and an
+// optional CRC32 of the other three.  All values are little endian.  Metadata and thumbnail blocks come first, followed
+// by the gcode, which is split into blocks that are encoded and compressed separately.
+#define BGCODE_MAGIC "GCDE"
+#define BGCODE_VERSION 1
+#define BGCODE_FILE_HEADER_SIZE 10
+// The most gcode text that is written to a single block.
+#define BGCODE_MAX_GCODE_BLOCK_SIZE 65536
+
+enum bgcode_checksum_type
+{
+	bgcode_checksum_none = 0,
+	bgcode_checksum_crc32 = 1
+};
+
+enum bgcode_block_type
+{
+	bgcode_block_file_metadata = 0,
+	bgcode_block_gcode = 1,
+	bgcode_block_slicer_metadata = 2,
+	bgcode_block_printer_metadata = 3,
+	bgcode_block_print_metadata = 4,
+	bgcode_block_thumbnail = 5
+};
+
+enum bgcode_compression_type
+{
+	bgcode_compression_none = 0,
+	// Zlib wrapped deflate, which is only available when built with zlib (HAS_ZLIB).
+	bgcode_compression_deflate = 1,
+	bgcode_compression_heatshrink_11_4 = 2,
+	bgcode_compression_heatshrink_12_4 = 3
+};
+
+enum bgcode_gcode_encoding
+{
+	bgcode_gcode_encoding_none = 0,
+	bgcode_gcode_encoding_meatpack = 1,
+	bgcode_gcode_encoding_meatpack_comments = 2
+};
+
+struct bgcode_block
+{
+	bgcode_block();
+	void clear();
+	// The encoding parameter of gcode and metadata blocks.
+	uint16_t get_encoding() const;
+	uint16_t type;
+	uint16_t compression;
+	uint32_t uncompressed_size;
+	uint32_t compressed_size;
+	// The block parameters, which are 6 bytes for thumbnails and 2 bytes for every other block type.
+	std::string parameters;
+	// The data as it is stored in the file, so possibly compressed.
+	std::string data;
+};
+
+class bgcode_reader
+{
+public:
+	bgcode_reader();
+	// Returns true if the file starts with the bgcode magic number.
+	static bool is_bgcode_file(const std::string& path);
+	bool read_file_header(std::istream& stream);
+	// Reads the next block and verifies its checksum.  Returns false at the end of the file, or if the block can't be
+	// read, in which case get_error returns the reason.
+	bool read_block(std::istream& stream, bgcode_block& block);
+	// Decompresses and decodes a gcode block, and appends the text to gcode.
+	bool append_gcode(const bgcode_block& block, std::string& gcode);
+	uint32_t get_version() const;
+	uint16_t get_checksum_type() const;
+	const std::string& get_error() const;
+private:
+	uint32_t version_;
+	uint16_t checksum_type_;
+	std::string error_;
+	std::string decompressed_;
+};
+
+class bgcode_writer
+{
+public:
+	bgcode_writer();
+	void set_checksum_type(uint16_t checksum_type);
+	// Sets how gcode blocks are written.  Deflate falls back to heatshrink when zlib isn't available.
+	void set_gcode_format(uint16_t compression, uint16_t encoding);
+	uint16_t get_gcode_compression() const;
+	uint16_t get_gcode_encoding() const;
+	void append_file_header(std::string& output) const;
+	// Writes a block as it is, after any gcode that is waiting to be written.
+	void append_block(const bgcode_block& block, std::string& output);
+	// Adds gcode text, and writes a gcode block whenever enough whole lines have been added.
+	void append_gcode(const char* text, size_t length, std::string& output);
+	void append_gcode(const std::string& text, std::string& output);
+	// Writes any gcode that is waiting in a final block.
+	void append_end(std::string& output);
+private:
+	void append_gcode_block_(size_t length, std::string& output);
+	void append_block_(uint16_t type, uint16_t compression, uint32_t uncompressed_size, uint32_t compressed_size,
+		const std::string& parameters, const std::string& data, std::string& output);
+	uint16_t checksum_type_;
+	uint16_t gcode_compression_;
+	uint16_t gcode_encoding_;
+	std::string gcode_;
+	std::string encoded_;
+	std::string compressed_;
+};
+
+namespace bgcode
+{
+	uint32_t crc32(uint32_t crc, const char* data, size_t length);
+	// Heatshrink is an LZSS variant for small devices.  Each block is compressed separately, with a window of
+	// 2^window_bits bytes and back references of up to 2^lookahead_bits bytes.
+	void heatshrink_compress(const std::string& data, int window_bits, int lookahead_bits, std::string& compressed);
+	bool heatshrink_decompress(const std::string& compressed, size_t uncompressed_size, int window_bits, int lookahead_bits, std::string& data);
+}
@@ -24,6 +24,7 @@
 
 #pragma once
 #include <exception>
+#include <utility>
 template <typename T>
 class circular_buffer
 {
@@ -48,7 +49,7 @@ public:
 		delete[] items_;
 	}
 
-	void initialize(T object)
+	void initialize(const T& object)
 	{
 		for (int index = 0; index < max_size_; index++)
 		{
@@ -63,7 +64,7 @@ public:
 		T* new_items = new T[max_size];
 		for (int index = 0; index < count_; index++)
 		{
-			new_items[index] = items_[(front_index_ + index + max_size_) % max_size_];
+			new_items[index] = std::move(items_[(front_index_ + index + max_size_) % max_size_]);
 		}
 		front_index_ = 0;
 		delete[] items_;
@@ -71,12 +72,12 @@ public:
 		max_size_ = max_size;
 	}
 
-	void resize(int max_size, T object)
+	void resize(int max_size, const T& object)
 	{
 		T* new_items = new T[max_size];
 		for (int index = 0; index < count_; index++)
 		{
-			new_items[index] = items_[(front_index_ + index + max_size_) % max_size_];
+			new_items[index] = std::move(items_[(front_index_ + index + max_size_) % max_size_]);
 		}
 		// Initialize the rest of the entries
 		for (int index = count_; index < max_size; index++)
@@ -99,30 +100,29 @@ public:
 		return index_position;
 	}
 
-	void push_front(T object)
+	void push_front(const T& object)
 	{
-		//front_index_ = (front_index_ - 1 + max_size_) % max_size_;
-		front_index_ -= 1;
-		if (front_index_ < 0)
-		{
-			front_index_ = max_size_ - 1;
-		}
-		if (count_ != max_size_)
-		{
-			count_++;
-		}
-		items_[front_index_] = object;
+		// Note:  object may be an item in this buffer.  Existing items never move, so the reference remains valid.
+		int pos = make_front_slot();
+		items_[pos] = object;
 	}
 
-	void push_back(T object)
+	void push_front(T&& object)
 	{
-		int pos = get_index_position(count_);
+		int pos = make_front_slot();
+		items_[pos] = std::move(object);
+	}
+
+	void push_back(const T& object)
+	{
+		int pos = make_back_slot();
 		items_[pos] = object;
-		count_++;
-		if (count_ != max_size_)
-		{
-			count_++;
-		}
+	}
+
+	void push_back(T&& object)
+	{
+		int pos = make_back_slot();
+		items_[pos] = std::move(object);
 	}
 
 	T& pop_front()
@@ -198,6 +198,41 @@ public:
 	}
 
 protected:
+	// Reserves a slot at the front of the buffer, overwriting the last item if the buffer is full
+	int make_front_slot()
+	{
+		//front_index_ = (front_index_ - 1 + max_size_) % max_size_;
+		front_index_ -= 1;
+		if (front_index_ < 0)
+		{
+			front_index_ = max_size_ - 1;
+		}
+		if (count_ != max_size_)
+		{
+			count_++;
+		}
+		return front_index_;
+	}
+
+	// Reserves a slot at the back of the buffer, overwriting the first item if the buffer is full
+	int make_back_slot()
+	{
+		int pos = get_index_position(count_);
+		if (count_ != max_size_)
+		{
+			count_++;
+		}
+		else
+		{
+			front_index_ += 1;
+			if (front_index_ >= max_size_)
+			{
+				front_index_ = 0;
+			}
+		}
+		return pos;
+	}
+
 	T* items_;
 	int  max_size_;
 	int  front_index_;
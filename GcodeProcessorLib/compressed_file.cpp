@@ -0,0 +1,661 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Gcode Processor Library
+//
+// Tools for parsing gcode and calculating printer state from parsed gcode commands.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address:
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "compressed_file.h"
+#include <cstring>
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#define COMPRESSED_FILE_BUFFER_SIZE 65536
+#define GZIP_COMPRESSION_LEVEL 6
+#define ZSTD_COMPRESSION_LEVEL 3
+
+static bool ends_with_ignore_case(const std::string& text, const char* suffix)
+{
+	size_t length = std::strlen(suffix);
+	if (text.length() < length)
+	{
+		return false;
+	}
+	for (size_t index = 0; index < length; index++)
+	{
+		char c = text[text.length() - length + index];
+		if (c >= 'A' && c <= 'Z')
+		{
+			c = static_cast<char>(c - 'A' + 'a');
+		}
+		if (c != suffix[index])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+namespace compressed_file
+{
+	compression_format detect_format(const std::string& path)
+	{
+		std::ifstream file(path.c_str(), std::ifstream::in | std::ifstream::binary);
+		unsigned char magic[4];
+		if (!file.is_open() || !file.read(reinterpret_cast<char*>(magic), 4))
+		{
+			return compression_format_none;
+		}
+		if (magic[0] == 0x1F && magic[1] == 0x8B)
+		{
+			return compression_format_gzip;
+		}
+		if (magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD)
+		{
+			return compression_format_zstd;
+		}
+		return compression_format_none;
+	}
+
+	compression_format get_format_from_path(const std::string& path)
+	{
+		if (ends_with_ignore_case(path, ".gz"))
+		{
+			return compression_format_gzip;
+		}
+		if (ends_with_ignore_case(path, ".zst"))
+		{
+			return compression_format_zstd;
+		}
+		return compression_format_none;
+	}
+
+	bool is_format_supported(compression_format format)
+	{
+		switch (format)
+		{
+		case compression_format_none:
+			return true;
+		case compression_format_gzip:
+#ifdef HAS_ZLIB
+			return true;
+#else
+			return false;
+#endif
+		case compression_format_zstd:
+#ifdef HAS_ZSTD
+			return true;
+#else
+			return false;
+#endif
+		default:
+			return false;
+		}
+	}
+
+	const char* get_format_name(compression_format format)
+	{
+		switch (format)
+		{
+		case compression_format_gzip:
+			return "gzip";
+		case compression_format_zstd:
+			return "zstd";
+		default:
+			return "uncompressed";
+		}
+	}
+}
+
+decompressing_streambuf::decompressing_streambuf()
+{
+	format_ = compression_format_none;
+	p_state_ = NULL;
+	in_start_ = 0;
+	in_end_ = 0;
+	compressed_bytes_read_ = 0;
+	is_end_of_file_ = false;
+	is_frame_complete_ = true;
+	has_completed_frame_ = false;
+}
+
+decompressing_streambuf::~decompressing_streambuf()
+{
+	close();
+}
+
+bool decompressing_streambuf::open(const std::string& path, compression_format format)
+{
+	close();
+	error_.clear();
+	if (format == compression_format_none || !compressed_file::is_format_supported(format))
+	{
+		error_ = std::string("Reading ") + compressed_file::get_format_name(format) + " compressed files is not supported by this build.";
+		return false;
+	}
+	if (file_.open(path.c_str(), std::ios_base::in | std::ios_base::binary) == NULL)
+	{
+		error_ = "Unable to open the compressed file.";
+		return false;
+	}
+#ifdef HAS_ZLIB
+	if (format == compression_format_gzip)
+	{
+		z_stream* p_stream = new z_stream();
+		std::memset(p_stream, 0, sizeof(z_stream));
+		// 32 detects a gzip or zlib header
+		if (inflateInit2(p_stream, MAX_WBITS + 32) != Z_OK)
+		{
+			delete p_stream;
+			file_.close();
+			error_ = "Unable to start gzip decompression.";
+			return false;
+		}
+		p_state_ = p_stream;
+	}
+#endif
+#ifdef HAS_ZSTD
+	if (format == compression_format_zstd)
+	{
+		ZSTD_DCtx* p_context = ZSTD_createDCtx();
+		if (p_context == NULL)
+		{
+			file_.close();
+			error_ = "Unable to start zstd decompression.";
+			return false;
+		}
+		p_state_ = p_context;
+	}
+#endif
+	format_ = format;
+	in_buffer_.resize(COMPRESSED_FILE_BUFFER_SIZE);
+	out_buffer_.resize(COMPRESSED_FILE_BUFFER_SIZE);
+	in_start_ = 0;
+	in_end_ = 0;
+	compressed_bytes_read_ = 0;
+	is_end_of_file_ = false;
+	is_frame_complete_ = true;
+	has_completed_frame_ = false;
+	setg(&out_buffer_[0], &out_buffer_[0], &out_buffer_[0]);
+	return true;
+}
+
+bool decompressing_streambuf::is_open() const
+{
+	return p_state_ != NULL;
+}
+
+void decompressing_streambuf::close()
+{
+	if (p_state_ != NULL)
+	{
+#ifdef HAS_ZLIB
+		if (format_ == compression_format_gzip)
+		{
+			z_stream* p_stream = static_cast<z_stream*>(p_state_);
+			inflateEnd(p_stream);
+			delete p_stream;
+		}
+#endif
+#ifdef HAS_ZSTD
+		if (format_ == compression_format_zstd)
+		{
+			ZSTD_freeDCtx(static_cast<ZSTD_DCtx*>(p_state_));
+		}
+#endif
+		p_state_ = NULL;
+	}
+	if (file_.is_open())
+	{
+		file_.close();
+	}
+	format_ = compression_format_none;
+	setg(NULL, NULL, NULL);
+}
+
+const std::string& decompressing_streambuf::get_error() const
+{
+	return error_;
+}
+
+bool decompressing_streambuf::read_compressed_()
+{
+	if (is_end_of_file_)
+	{
+		return false;
+	}
+	std::streamsize count = file_.sgetn(&in_buffer_[0], static_cast<std::streamsize>(in_buffer_.size()));
+	if (count <= 0)
+	{
+		is_end_of_file_ = true;
+		return false;
+	}
+	in_start_ = 0;
+	in_end_ = static_cast<size_t>(count);
+	compressed_bytes_read_ += count;
+	return true;
+}
+
+decompressing_streambuf::int_type decompressing_streambuf::underflow()
+{
+	if (gptr() < egptr())
+	{
+		return traits_type::to_int_type(*gptr());
+	}
+	if (p_state_ == NULL)
+	{
+		return traits_type::eof();
+	}
+	while (true)
+	{
+		if (in_start_ == in_end_ && !read_compressed_())
+		{
+			if (!is_frame_complete_ && error_.empty())
+			{
+				error_ = "The compressed file ends unexpectedly.";
+			}
+			return traits_type::eof();
+		}
+		size_t produced = 0;
+		bool is_error = false;
+#ifdef HAS_ZLIB
+		if (format_ == compression_format_gzip)
+		{
+			z_stream* p_stream = static_cast<z_stream*>(p_state_);
+			if (is_frame_complete_)
+			{
+				inflateReset(p_stream);
+				is_frame_complete_ = false;
+			}
+			p_stream->next_in = reinterpret_cast<Bytef*>(&in_buffer_[in_start_]);
+			p_stream->avail_in = static_cast<uInt>(in_end_ - in_start_);
+			p_stream->next_out = reinterpret_cast<Bytef*>(&out_buffer_[0]);
+			p_stream->avail_out = static_cast<uInt>(out_buffer_.size());
+			int result = inflate(p_stream, Z_NO_FLUSH);
+			in_start_ = in_end_ - p_stream->avail_in;
+			produced = out_buffer_.size() - p_stream->avail_out;
+			if (result == Z_STREAM_END)
+			{
+				is_frame_complete_ = true;
+				has_completed_frame_ = true;
+			}
+			else if (result != Z_OK && result != Z_BUF_ERROR)
+			{
+				is_error = true;
+			}
+		}
+#endif
+#ifdef HAS_ZSTD
+		if (format_ == compression_format_zstd)
+		{
+			ZSTD_inBuffer input = { &in_buffer_[in_start_], in_end_ - in_start_, 0 };
+			ZSTD_outBuffer output = { &out_buffer_[0], out_buffer_.size(), 0 };
+			size_t result = ZSTD_decompressStream(static_cast<ZSTD_DCtx*>(p_state_), &output, &input);
+			in_start_ += input.pos;
+			produced = output.pos;
+			if (ZSTD_isError(result))
+			{
+				is_error = true;
+			}
+			else
+			{
+				is_frame_complete_ = result == 0;
+				has_completed_frame_ = has_completed_frame_ || is_frame_complete_;
+			}
+		}
+#endif
+		if (is_error)
+		{
+			// Anything that follows a complete frame, like padding, is ignored, the same as gzip -d does.
+			if (!has_completed_frame_)
+			{
+				error_ = std::string("The ") + compressed_file::get_format_name(format_) + " compressed data is corrupt.";
+			}
+			is_frame_complete_ = true;
+			is_end_of_file_ = true;
+			in_start_ = in_end_;
+			return traits_type::eof();
+		}
+		if (produced > 0)
+		{
+			setg(&out_buffer_[0], &out_buffer_[0], &out_buffer_[0] + produced);
+			return traits_type::to_int_type(*gptr());
+		}
+	}
+}
+
+decompressing_streambuf::pos_type decompressing_streambuf::seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode)
+{
+	// Only the current position can be requested, and it is the number of compressed bytes used so far.
+	if (offset != 0 || direction != std::ios_base::cur || (mode & std::ios_base::in) == 0 || p_state_ == NULL)
+	{
+		return pos_type(off_type(-1));
+	}
+	return pos_type(off_type(compressed_bytes_read_ - static_cast<long long>(in_end_ - in_start_)));
+}
+
+compressing_streambuf::compressing_streambuf()
+{
+	format_ = compression_format_none;
+	p_state_ = NULL;
+	compressed_bytes_written_ = 0;
+}
+
+compressing_streambuf::~compressing_streambuf()
+{
+	close();
+}
+
+bool compressing_streambuf::open(const std::string& path, compression_format format)
+{
+	close();
+	error_.clear();
+	if (format == compression_format_none || !compressed_file::is_format_supported(format))
+	{
+		error_ = std::string("Writing ") + compressed_file::get_format_name(format) + " compressed files is not supported by this build.";
+		return false;
+	}
+	if (file_.open(path.c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary) == NULL)
+	{
+		error_ = "Unable to open the compressed file for writing.";
+		return false;
+	}
+#ifdef HAS_ZLIB
+	if (format == compression_format_gzip)
+	{
+		z_stream* p_stream = new z_stream();
+		std::memset(p_stream, 0, sizeof(z_stream));
+		// 16 writes a gzip header instead of a zlib header
+		if (deflateInit2(p_stream, GZIP_COMPRESSION_LEVEL, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		{
+			delete p_stream;
+			file_.close();
+			error_ = "Unable to start gzip compression.";
+			return false;
+		}
+		p_state_ = p_stream;
+	}
+#endif
+#ifdef HAS_ZSTD
+	if (format == compression_format_zstd)
+	{
+		ZSTD_CCtx* p_context = ZSTD_createCCtx();
+		if (p_context == NULL)
+		{
+			file_.close();
+			error_ = "Unable to start zstd compression.";
+			return false;
+		}
+		ZSTD_CCtx_setParameter(p_context, ZSTD_c_compressionLevel, ZSTD_COMPRESSION_LEVEL);
+		p_state_ = p_context;
+	}
+#endif
+	format_ = format;
+	compressed_bytes_written_ = 0;
+	in_buffer_.resize(COMPRESSED_FILE_BUFFER_SIZE);
+	out_buffer_.resize(COMPRESSED_FILE_BUFFER_SIZE);
+	setp(&in_buffer_[0], &in_buffer_[0] + in_buffer_.size());
+	return true;
+}
+
+bool compressing_streambuf::is_open() const
+{
+	return p_state_ != NULL;
+}
+
+bool compressing_streambuf::close()
+{
+	bool success = true;
+	if (p_state_ != NULL)
+	{
+		success = compress_(pbase(), static_cast<size_t>(pptr() - pbase()), true);
+#ifdef HAS_ZLIB
+		if (format_ == compression_format_gzip)
+		{
+			z_stream* p_stream = static_cast<z_stream*>(p_state_);
+			deflateEnd(p_stream);
+			delete p_stream;
+		}
+#endif
+#ifdef HAS_ZSTD
+		if (format_ == compression_format_zstd)
+		{
+			ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(p_state_));
+		}
+#endif
+		p_state_ = NULL;
+	}
+	if (file_.is_open() && file_.close() == NULL)
+	{
+		success = false;
+	}
+	format_ = compression_format_none;
+	setp(NULL, NULL);
+	return success;
+}
+
+const std::string& compressing_streambuf::get_error() const
+{
+	return error_;
+}
+
+compressing_streambuf::int_type compressing_streambuf::overflow(int_type c)
+{
+	if (p_state_ == NULL || !compress_(pbase(), static_cast<size_t>(pptr() - pbase()), false))
+	{
+		return traits_type::eof();
+	}
+	setp(&in_buffer_[0], &in_buffer_[0] + in_buffer_.size());
+	if (!traits_type::eq_int_type(c, traits_type::eof()))
+	{
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+int compressing_streambuf::sync()
+{
+	if (p_state_ == NULL)
+	{
+		return 0;
+	}
+	if (!compress_(pbase(), static_cast<size_t>(pptr() - pbase()), false))
+	{
+		return -1;
+	}
+	setp(&in_buffer_[0], &in_buffer_[0] + in_buffer_.size());
+	return 0;
+}
+
+compressing_streambuf::pos_type compressing_streambuf::seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode)
+{
+	// Only the current position can be requested, and it is the number of compressed bytes written so far.
+	if (offset != 0 || direction != std::ios_base::cur || (mode & std::ios_base::out) == 0 || p_state_ == NULL)
+	{
+		return pos_type(off_type(-1));
+	}
+	return pos_type(off_type(compressed_bytes_written_));
+}
+
+bool compressing_streambuf::compress_(const char* data, size_t length, bool finish)
+{
+	bool is_done = false;
+#ifdef HAS_ZLIB
+	if (format_ == compression_format_gzip)
+	{
+		z_stream* p_stream = static_cast<z_stream*>(p_state_);
+		p_stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+		p_stream->avail_in = static_cast<uInt>(length);
+		while (!is_done)
+		{
+			p_stream->next_out = reinterpret_cast<Bytef*>(&out_buffer_[0]);
+			p_stream->avail_out = static_cast<uInt>(out_buffer_.size());
+			int result = deflate(p_stream, finish ? Z_FINISH : Z_NO_FLUSH);
+			if (result == Z_STREAM_ERROR)
+			{
+				error_ = "Unable to compress the gzip output.";
+				return false;
+			}
+			size_t produced = out_buffer_.size() - p_stream->avail_out;
+			if (produced > 0 && file_.sputn(&out_buffer_[0], static_cast<std::streamsize>(produced)) != static_cast<std::streamsize>(produced))
+			{
+				error_ = "Unable to write the compressed file.";
+				return false;
+			}
+			compressed_bytes_written_ += produced;
+			is_done = finish ? result == Z_STREAM_END : p_stream->avail_out != 0;
+		}
+	}
+#endif
+#ifdef HAS_ZSTD
+	if (format_ == compression_format_zstd)
+	{
+		ZSTD_inBuffer input = { data, length, 0 };
+		while (!is_done)
+		{
+			ZSTD_outBuffer output = { &out_buffer_[0], out_buffer_.size(), 0 };
+			size_t remaining = ZSTD_compressStream2(static_cast<ZSTD_CCtx*>(p_state_), &output, &input, finish ? ZSTD_e_end : ZSTD_e_continue);
+			if (ZSTD_isError(remaining))
+			{
+				error_ = "Unable to compress the zstd output.";
+				return false;
+			}
+			if (output.pos > 0 && file_.sputn(&out_buffer_[0], static_cast<std::streamsize>(output.pos)) != static_cast<std::streamsize>(output.pos))
+			{
+				error_ = "Unable to write the compressed file.";
+				return false;
+			}
+			compressed_bytes_written_ += output.pos;
+			is_done = finish ? remaining == 0 : input.pos == input.size;
+		}
+	}
+#endif
+	return is_done || length == 0;
+}
+
+compressed_ifstream::compressed_ifstream() : std::istream(NULL)
+{
+	format_ = compression_format_none;
+	rdbuf(&file_);
+}
+
+void compressed_ifstream::open(const char* path, std::ios_base::openmode mode)
+{
+	close();
+	format_ = compressed_file::detect_format(path);
+	if (format_ == compression_format_none)
+	{
+		rdbuf(&file_);
+		if (file_.open(path, mode | std::ios_base::in) == NULL)
+		{
+			setstate(std::ios_base::failbit);
+		}
+		return;
+	}
+	rdbuf(&decompressor_);
+	if (!decompressor_.open(path, format_))
+	{
+		setstate(std::ios_base::failbit);
+	}
+}
+
+bool compressed_ifstream::is_open() const
+{
+	return format_ == compression_format_none ? file_.is_open() : decompressor_.is_open();
+}
+
+void compressed_ifstream::close()
+{
+	if (file_.is_open())
+	{
+		file_.close();
+	}
+	decompressor_.close();
+}
+
+compression_format compressed_ifstream::get_format() const
+{
+	return format_;
+}
+
+const std::string& compressed_ifstream::get_error() const
+{
+	return decompressor_.get_error();
+}
+
+compressed_ofstream::compressed_ofstream() : std::ostream(NULL)
+{
+	format_ = compression_format_none;
+	rdbuf(&file_);
+}
+
+void compressed_ofstream::open(const char* path, std::ios_base::openmode mode)
+{
+	open(path, mode, compressed_file::get_format_from_path(path));
+}
+
+void compressed_ofstream::open(const char* path, std::ios_base::openmode mode, compression_format format)
+{
+	close();
+	format_ = format;
+	if (format_ == compression_format_none)
+	{
+		rdbuf(&file_);
+		if (file_.open(path, mode | std::ios_base::out) == NULL)
+		{
+			setstate(std::ios_base::failbit);
+		}
+		return;
+	}
+	rdbuf(&compressor_);
+	if (!compressor_.open(path, format_))
+	{
+		setstate(std::ios_base::failbit);
+	}
+}
+
+bool compressed_ofstream::is_open() const
+{
+	return format_ == compression_format_none ? file_.is_open() : compressor_.is_open();
+}
+
+void compressed_ofstream::close()
+{
+	if (file_.is_open() && file_.close() == NULL)
+	{
+		setstate(std::ios_base::failbit);
+	}
+	if (compressor_.is_open() && !compressor_.close())
+	{
+		setstate(std::ios_base::failbit);
+	}
+}
+
+compression_format compressed_ofstream::get_format() const
+{
+	return format_;
+}
+
+const std::string& compressed_ofstream::get_error() const
+{
+	return compressor_.get_error();
+}
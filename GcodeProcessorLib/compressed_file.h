@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Gcode Processor Library
+//
+// Tools for parsing gcode and calculating printer state from parsed gcode commands.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address:
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <fstream>
+
+// Reads and writes gzip and zstd compressed gcode as a stream, so that nothing is decompressed to disk first.  Gzip
+// needs zlib (HAS_ZLIB) and zstd needs libzstd (HAS_ZSTD).  Stream positions (tellg and tellp) are counted in
+// compressed bytes, the same as the file size, so progress can be calculated the same way for every format.
+enum compression_format
+{
+	compression_format_none = 0,
+	compression_format_gzip = 1,
+	compression_format_zstd = 2
+};
+
+namespace compressed_file
+{
+	// Detects the format from the first bytes of the file.
+	compression_format detect_format(const std::string& path);
+	// Gets the format from the extension (.gz or .zst) of a file that will be written.
+	compression_format get_format_from_path(const std::string& path);
+	bool is_format_supported(compression_format format);
+	const char* get_format_name(compression_format format);
+}
+
+class decompressing_streambuf : public std::streambuf
+{
+public:
+	decompressing_streambuf();
+	virtual ~decompressing_streambuf();
+	bool open(const std::string& path, compression_format format);
+	bool is_open() const;
+	void close();
+	const std::string& get_error() const;
+protected:
+	virtual int_type underflow();
+	virtual pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode);
+private:
+	decompressing_streambuf(const decompressing_streambuf&);
+	decompressing_streambuf& operator=(const decompressing_streambuf&);
+	bool read_compressed_();
+	std::filebuf file_;
+	compression_format format_;
+	// The zlib or zstd stream state
+	void* p_state_;
+	std::vector<char> in_buffer_;
+	std::vector<char> out_buffer_;
+	size_t in_start_;
+	size_t in_end_;
+	long long compressed_bytes_read_;
+	bool is_end_of_file_;
+	// Compressed files can hold several gzip members or zstd frames, one after the other.
+	bool is_frame_complete_;
+	bool has_completed_frame_;
+	std::string error_;
+};
+
+class compressing_streambuf : public std::streambuf
+{
+public:
+	compressing_streambuf();
+	virtual ~compressing_streambuf();
+	bool open(const std::string& path, compression_format format);
+	bool is_open() const;
+	// Finishes the compressed stream and closes the file.
+	bool close();
+	const std::string& get_error() const;
+protected:
+	virtual int_type overflow(int_type c);
+	virtual int sync();
+	virtual pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode);
+private:
+	compressing_streambuf(const compressing_streambuf&);
+	compressing_streambuf& operator=(const compressing_streambuf&);
+	bool compress_(const char* data, size_t length, bool finish);
+	std::filebuf file_;
+	compression_format format_;
+	void* p_state_;
+	std::vector<char> in_buffer_;
+	std::vector<char> out_buffer_;
+	long long compressed_bytes_written_;
+	std::string error_;
+};
+
+// Used in place of std::ifstream.  Compressed files are detected when they are opened.
+class compressed_ifstream : public std::istream
+{
+public:
+	compressed_ifstream();
+	void open(const char* path, std::ios_base::openmode mode = std::ios_base::in);
+	bool is_open() const;
+	void close();
+	compression_format get_format() const;
+	// Explains why a compressed file couldn't be opened or read.
+	const std::string& get_error() const;
+private:
+	std::filebuf file_;
+	decompressing_streambuf decompressor_;
+	compression_format format_;
+};
+
+// Used in place of std::ofstream.  The format is taken from the extension unless it is supplied.
+class compressed_ofstream : public std::ostream
+{
+public:
+	compressed_ofstream();
+	void open(const char* path, std::ios_base::openmode mode = std::ios_base::out);
+	void open(const char* path, std::ios_base::openmode mode, compression_format format);
+	bool is_open() const;
+	void close();
+	compression_format get_format() const;
+	// Explains why a compressed file couldn't be opened or written.
+	const std::string& get_error() const;
+private:
+	std::filebuf file_;
+	compressing_streambuf compressor_;
+	compression_format format_;
+};
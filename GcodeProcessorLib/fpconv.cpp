@@ -449,6 +449,87 @@ static int emit_digits_decimal(char* digits, int ndigits, char* dest, int K, boo
 }
 
 
+/* Fast path for fixed precision output.  Values within this range are scaled by 10^precision and rounded to an
+ * integer, which is exact enough to decide the rounding unless the scaled value is within the tie window of a half.
+ * Anything outside of the range, or close to a tie, is passed to grisu so the output matches exactly. */
+#define scaled_max_precision 12
+#define scaled_max_value     1e7
+#define scaled_max           1e12
+#define scaled_tie_window    1e-3
+
+static const double scaled_powers_ten[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12
+};
+
+static const char digit_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+static bool try_round_scaled(double d, unsigned char precision, unsigned long long* scaled)
+{
+  if (precision > scaled_max_precision || !(d < scaled_max_value)) {
+    return false;
+  }
+  double value = d * scaled_powers_ten[precision];
+  if (!(value < scaled_max)) {
+    return false;
+  }
+  unsigned long long integer = (unsigned long long)value;
+  double fraction = value - (double)integer;
+  if (fraction > 0.5 + scaled_tie_window) {
+    integer++;
+  }
+  else if (fraction >= 0.5 - scaled_tie_window) {
+    return false;
+  }
+  *scaled = integer;
+  return true;
+}
+
+static int emit_scaled(unsigned long long scaled, char* dest, unsigned char precision)
+{
+  /* write the digits from right to left, two at a time */
+  char digits[24];
+  int idx = 24;
+  while (scaled >= 100) {
+    unsigned int pair = (unsigned int)(scaled % 100) * 2;
+    scaled /= 100;
+    digits[--idx] = digit_pairs[pair + 1];
+    digits[--idx] = digit_pairs[pair];
+  }
+  if (scaled >= 10) {
+    unsigned int pair = (unsigned int)scaled * 2;
+    digits[--idx] = digit_pairs[pair + 1];
+    digits[--idx] = digit_pairs[pair];
+  }
+  else {
+    digits[--idx] = (char)('0' + scaled);
+  }
+
+  /* pad with 0s so there is at least one digit before the decimal point */
+  while (24 - idx < precision + 1) {
+    digits[--idx] = '0';
+  }
+
+  int ndigits = 24 - idx;
+  int nintegers = ndigits - precision;
+  memcpy(dest, digits + idx, nintegers);
+  if (precision == 0) {
+    return nintegers;
+  }
+  dest[nintegers] = '.';
+  memcpy(dest + nintegers + 1, digits + idx + nintegers, precision);
+  return ndigits + 1;
+}
+
 static int filter_special(double fp, char* dest)
 {
   if (fp == 0.0) {
@@ -521,6 +602,11 @@ int fpconv_dtos(double d, char dest[24], unsigned char precision)
     return str_len + spec;
   }
 
+  unsigned long long scaled;
+  if (try_round_scaled(neg ? -d : d, precision, &scaled)) {
+    return str_len + emit_scaled(scaled, dest + str_len, precision);
+  }
+
   int K = 0;
   int ndigits = grisu2(d, digits, &K);
 
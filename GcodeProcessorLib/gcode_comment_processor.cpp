@@ -45,7 +45,11 @@ void gcode_comment_processor::update(position& pos)
 	{
 		update_feature_from_section(pos);
 		return;
-	}		
+	}
+
+	// Most lines have no comment, skip them before doing any matching
+	if (pos.command.comment.empty())
+		return;
 
 	if (processing_type_ == comment_process_type_unknown || processing_type_ == comment_process_type_slic3r_pe)
 	{
@@ -55,27 +59,72 @@ void gcode_comment_processor::update(position& pos)
 	
 }
 
+bool gcode_comment_processor::is_comment_match(const std::string& comment, size_t offset, const char* text, size_t text_length)
+{
+	return comment.length() == offset + text_length && comment.compare(offset, text_length, text) == 0;
+}
+
+bool gcode_comment_processor::has_comment_prefix(const std::string& comment, const char* prefix, size_t prefix_length)
+{
+	return comment.length() >= prefix_length && comment.compare(0, prefix_length, prefix) == 0;
+}
+
+bool gcode_comment_processor::has_comment_suffix(const std::string& comment, const char* suffix, size_t suffix_length)
+{
+	return comment.length() >= suffix_length && comment.compare(comment.length() - suffix_length, suffix_length, suffix) == 0;
+}
+
 bool gcode_comment_processor::update_feature_for_slic3r_pe_comment(position& pos, std::string &comment) const
 {
-	if (comment == "perimeter" || comment == "move to first perimeter point")
-	{
-		pos.feature_type_tag = feature_type_unknown_perimeter_feature;
-		return true;
-	}
-	if (comment == "infill" || comment == "move to first infill point")
+	// Slic3r PE feature comments are either "<feature>" or "move to first <feature> point".
+	// Switch on the first character so that most comments are rejected after a single comparison.
+	size_t offset = 0;
+	size_t suffix_length = 0;
+	switch (comment[0])
 	{
-		pos.feature_type_tag = feature_type_infill_feature;
-		return true;
-	}
-	if (comment == "infill(bridge)" || comment == "move to first infill(bridge) point")
-	{
-		pos.feature_type_tag = feature_type_bridge_feature;
-		return true;
+	case 'm':
+		if (comment.length() <= 20 || !has_comment_prefix(comment, "move to first ", 14) || !has_comment_suffix(comment, " point", 6))
+			return false;
+		offset = 14;
+		suffix_length = 6;
+		break;
+	case 'p':
+	case 'i':
+	case 's':
+		break;
+	default:
+		return false;
 	}
-	if (comment == "skirt" || comment == "move to first skirt point")
+
+	const size_t length = comment.length() - offset - suffix_length;
+	switch (comment[offset])
 	{
-		pos.feature_type_tag = feature_type_skirt_feature;
-		return true;
+	case 'p':
+		if (length == 9 && comment.compare(offset, length, "perimeter") == 0)
+		{
+			pos.feature_type_tag = feature_type_unknown_perimeter_feature;
+			return true;
+		}
+		break;
+	case 'i':
+		if (length == 6 && comment.compare(offset, length, "infill") == 0)
+		{
+			pos.feature_type_tag = feature_type_infill_feature;
+			return true;
+		}
+		if (length == 14 && comment.compare(offset, length, "infill(bridge)") == 0)
+		{
+			pos.feature_type_tag = feature_type_bridge_feature;
+			return true;
+		}
+		break;
+	case 's':
+		if (length == 5 && comment.compare(offset, length, "skirt") == 0)
+		{
+			pos.feature_type_tag = feature_type_skirt_feature;
+			return true;
+		}
+		break;
 	}
 	return false;
 }
@@ -111,6 +160,12 @@ void gcode_comment_processor::update_feature_from_section(position& pos) const
 	case(section_type_gap_fill_section):
 		pos.feature_type_tag = feature_type_gap_fill_feature;
 		break;
+	case(section_type_unknown_perimeter_section):
+		pos.feature_type_tag = feature_type_unknown_perimeter_feature;
+		break;
+	case(section_type_bridge_section):
+		pos.feature_type_tag = feature_type_bridge_feature;
+		break;
 	case(section_type_no_section):
 		// Do Nothing
 		break;
@@ -143,55 +198,142 @@ void gcode_comment_processor::update_unknown_section(std::string & comment)
 	if (comment.length() == 0)
 		return;
 
-	if (update_cura_section(comment))
-	{
-		processing_type_ = comment_process_type_cura;
-		return;
-	}
-		
-	if (update_simplify_3d_section(comment))
+	// The section comments of each slicer start with different characters, so the first character
+	// tells us which dialect (if any) could match.  Once a dialect matches it is used exclusively.
+	switch (comment[0])
 	{
-		processing_type_ = comment_process_type_simplify_3d;
-		return;
-	}
-	if(update_slic3r_pe_section(comment))
-	{
-		processing_type_ = comment_process_type_slic3r_pe;
-		return;
+	case 'T':
+	case 'L':
+	case ';':
+		if (update_cura_section(comment))
+			processing_type_ = comment_process_type_cura;
+		break;
+	case 'f':
+	case 'o':
+	case 'i':
+	case 's':
+	case 'g':
+	case 'p':
+		if (update_simplify_3d_section(comment))
+			processing_type_ = comment_process_type_simplify_3d;
+		break;
+	case 'C':
+		if (update_slic3r_pe_section(comment))
+			processing_type_ = comment_process_type_slic3r_pe;
+		break;
 	}
 }
 
 bool gcode_comment_processor::update_cura_section(std::string &comment)
 {
-	if (comment == "TYPE:WALL-OUTER")
-	{
-		current_section_ = section_type_outer_perimeter_section;
-		return true;
-	}
-	else if (comment == "TYPE:WALL-INNER")
-	{
-		current_section_ = section_type_inner_perimeter_section;
-		return true;
-	}
-	if (comment == "TYPE:FILL")
-	{
-		current_section_ = section_type_infill_section;
-		return true;
-	}
-	if (comment == "TYPE:SKIN")
-	{
-		current_section_ = section_type_solid_infill_section;
-		return true;
-	}
-	if (comment.rfind("LAYER:", 0) != std::string::npos || comment.rfind(";MESH:NONMESH", 0) != std::string::npos)
-	{
-		current_section_ = section_type_no_section;
+	if (comment.length() == 0)
 		return false;
-	}
-	if (comment == "TYPE:SKIRT")
+
+	switch (comment[0])
 	{
-		current_section_ = section_type_skirt_section;
-		return true;
+	case 'T':
+		// PrusaSlicer uses the same TYPE: prefix as Cura, with its own feature names.
+		if (!has_comment_prefix(comment, "TYPE:", 5))
+			return false;
+		switch (comment.length() > 5 ? comment[5] : '\0')
+		{
+		case 'W':
+			if (is_comment_match(comment, 5, "WALL-OUTER", 10))
+			{
+				current_section_ = section_type_outer_perimeter_section;
+				return true;
+			}
+			if (is_comment_match(comment, 5, "WALL-INNER", 10))
+			{
+				current_section_ = section_type_inner_perimeter_section;
+				return true;
+			}
+			if (is_comment_match(comment, 5, "Wipe tower", 10))
+			{
+				current_section_ = section_type_prime_pillar_section;
+				return true;
+			}
+			break;
+		case 'E':
+			if (is_comment_match(comment, 5, "External perimeter", 18))
+			{
+				current_section_ = section_type_outer_perimeter_section;
+				return true;
+			}
+			break;
+		case 'P':
+			if (is_comment_match(comment, 5, "Perimeter", 9))
+			{
+				current_section_ = section_type_inner_perimeter_section;
+				return true;
+			}
+			break;
+		case 'O':
+			if (is_comment_match(comment, 5, "Overhang perimeter", 18))
+			{
+				current_section_ = section_type_unknown_perimeter_section;
+				return true;
+			}
+			break;
+		case 'F':
+			if (is_comment_match(comment, 5, "FILL", 4))
+			{
+				current_section_ = section_type_infill_section;
+				return true;
+			}
+			break;
+		case 'I':
+			if (is_comment_match(comment, 5, "Internal infill", 15))
+			{
+				current_section_ = section_type_infill_section;
+				return true;
+			}
+			break;
+		case 'S':
+			if (is_comment_match(comment, 5, "SKIN", 4) || is_comment_match(comment, 5, "Solid infill", 12))
+			{
+				current_section_ = section_type_solid_infill_section;
+				return true;
+			}
+			if (is_comment_match(comment, 5, "SKIRT", 5) || is_comment_match(comment, 5, "Skirt/Brim", 10) || is_comment_match(comment, 5, "Skirt", 5))
+			{
+				current_section_ = section_type_skirt_section;
+				return true;
+			}
+			break;
+		case 'T':
+			if (is_comment_match(comment, 5, "Top solid infill", 16))
+			{
+				current_section_ = section_type_solid_infill_section;
+				return true;
+			}
+			break;
+		case 'B':
+			if (is_comment_match(comment, 5, "Bridge infill", 13))
+			{
+				current_section_ = section_type_bridge_section;
+				return true;
+			}
+			break;
+		case 'G':
+			if (is_comment_match(comment, 5, "Gap fill", 8))
+			{
+				current_section_ = section_type_gap_fill_section;
+				return true;
+			}
+			break;
+		}
+		// Any other feature, like support, ends the previous one.
+		current_section_ = section_type_no_section;
+		break;
+	case 'L':
+		if (has_comment_prefix(comment, "LAYER:", 6))
+			current_section_ = section_type_no_section;
+		break;
+	case ';':
+		if (has_comment_prefix(comment, ";MESH:NONMESH", 13))
+			current_section_ = section_type_no_section;
+		break;
 	}
 	return false;
 }
@@ -200,111 +342,85 @@ bool gcode_comment_processor::update_simplify_3d_section(std::string &comment)
 {
 	// Apparently simplify 3d added the word 'feature' to the their feature comments
 	// at some point to make my life more difficult :P
-	if (comment.rfind("feature", 0) != std::string::npos)
+	size_t offset = 0;
+	if (has_comment_prefix(comment, "feature", 7))
 	{
-		if (comment == "feature outer perimeter")
+		if (!has_comment_prefix(comment, "feature ", 8))
+			return false;
+		offset = 8;
+	}
+	if (comment.length() <= offset)
+		return false;
+
+	switch (comment[offset])
+	{
+	case 'o':
+		if (is_comment_match(comment, offset, "outer perimeter", 15))
 		{
 			current_section_ = section_type_outer_perimeter_section;
 			return true;
 		}
-		if (comment == "feature inner perimeter")
-		{
-			current_section_ = section_type_inner_perimeter_section;
-			return true;
-		}
-		if (comment == "feature infill")
-		{
-			current_section_ = section_type_infill_section;
-			return true;
-		}
-		if (comment == "feature solid layer")
-		{
-			current_section_ = section_type_solid_infill_section;
-			return true;
-		}
-		if (comment == "feature skirt")
-		{
-			current_section_ = section_type_skirt_section;
-			return true;
-		}
-		if (comment == "feature ooze shield")
+		if (is_comment_match(comment, offset, "ooze shield", 11))
 		{
 			current_section_ = section_type_ooze_shield_section;
 			return true;
 		}
-		if (comment == "feature prime pillar")
-		{
-			current_section_ = section_type_prime_pillar_section;
-			return true;
-		}
-		if (comment == "feature gap fill")
-		{
-			current_section_ = section_type_gap_fill_section;
-			return true;
-		}
-	}
-	else
-	{
-		if (comment == "outer perimeter")
-		{
-			current_section_ = section_type_outer_perimeter_section;
-			return true;
-		}
-		if (comment == "inner perimeter")
+		break;
+	case 'i':
+		if (is_comment_match(comment, offset, "inner perimeter", 15))
 		{
 			current_section_ = section_type_inner_perimeter_section;
 			return true;
 		}
-		if (comment == "infill")
+		if (is_comment_match(comment, offset, "infill", 6))
 		{
 			current_section_ = section_type_infill_section;
 			return true;
 		}
-		if (comment == "solid layer")
+		break;
+	case 's':
+		if (is_comment_match(comment, offset, "solid layer", 11))
 		{
 			current_section_ = section_type_solid_infill_section;
 			return true;
 		}
-		if (comment == "skirt")
+		if (is_comment_match(comment, offset, "skirt", 5))
 		{
 			current_section_ = section_type_skirt_section;
 			return true;
 		}
-		if (comment == "ooze shield")
-		{
-			current_section_ = section_type_ooze_shield_section;
-			return true;
-		}
-
-		if (comment == "prime pillar")
+		break;
+	case 'p':
+		if (is_comment_match(comment, offset, "prime pillar", 12))
 		{
 			current_section_ = section_type_prime_pillar_section;
 			return true;
 		}
-
-		if (comment == "gap fill")
+		break;
+	case 'g':
+		if (is_comment_match(comment, offset, "gap fill", 8))
 		{
 			current_section_ = section_type_gap_fill_section;
 			return true;
 		}
+		break;
 	}
-	
-	
 	return false;
 }
 
 bool gcode_comment_processor::update_slic3r_pe_section(std::string &comment)
 {
-	if (comment == "CP TOOLCHANGE WIPE")
+	if (!has_comment_prefix(comment, "CP TOOLCHANGE ", 14))
+		return false;
+	if (is_comment_match(comment, 14, "WIPE", 4))
 	{
 		current_section_ = section_type_prime_pillar_section;
 		return true;
 	}
-	if (comment == "CP TOOLCHANGE END")
+	if (is_comment_match(comment, 14, "END", 3))
 	{
 		current_section_ = section_type_no_section;
 		return true;
 	}
 	return false;
 }
-
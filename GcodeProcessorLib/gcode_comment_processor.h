@@ -47,7 +47,7 @@ enum comment_process_type
 	comment_process_type_cura, 
 	comment_process_type_simplify_3d
 };
-// used for marking slicer sections for cura and simplify 3d
+// used for marking slicer sections for cura, prusa slicer and simplify 3d
 enum section_type
 {
 	section_type_no_section, 
@@ -58,7 +58,9 @@ enum section_type
 	section_type_skirt_section, 
 	section_type_solid_infill_section, 
 	section_type_ooze_shield_section,
-	section_type_prime_pillar_section
+	section_type_prime_pillar_section,
+	section_type_unknown_perimeter_section,
+	section_type_bridge_section
 };
 
 class gcode_comment_processor
@@ -86,5 +88,8 @@ private:
 	bool update_cura_section(std::string &comment);
 	bool update_simplify_3d_section(std::string &comment);
 	bool update_slic3r_pe_section(std::string &comment);
+	static bool is_comment_match(const std::string& comment, size_t offset, const char* text, size_t text_length);
+	static bool has_comment_prefix(const std::string& comment, const char* prefix, size_t prefix_length);
+	static bool has_comment_suffix(const std::string& comment, const char* suffix, size_t suffix_length);
 };
 
@@ -62,6 +62,9 @@ gcode_position_args::gcode_position_args(const gcode_position_args &pos_args)
 	default_extruder = pos_args.default_extruder;
 	zero_based_extruder = pos_args.zero_based_extruder;
 	num_extruders = pos_args.num_extruders;
+	tracking_type = pos_args.tracking_type;
+	relative_moves_from_unknown_position = pos_args.relative_moves_from_unknown_position;
+	track_feature_types = pos_args.track_feature_types;
 	retraction_lengths = NULL;
 	z_lift_heights = NULL;
 	x_firmware_offsets = NULL;
@@ -123,6 +126,9 @@ gcode_position_args& gcode_position_args::operator=(const gcode_position_args& p
 	default_extruder = pos_args.default_extruder;
 	zero_based_extruder = pos_args.zero_based_extruder;
 	num_extruders = pos_args.num_extruders;
+	tracking_type = pos_args.tracking_type;
+	relative_moves_from_unknown_position = pos_args.relative_moves_from_unknown_position;
+	track_feature_types = pos_args.track_feature_types;
 	delete_retraction_lengths();
 	delete_x_firmware_offsets();
 	delete_y_firmware_offsets();
@@ -245,7 +251,9 @@ gcode_position::gcode_position() : positions_(50), initial_position_(1)
 	z_min_ = 0;
 	z_max_ = 0;
 	is_circular_bed_ = false;
-
+	tracking_type_ = position_tracking_type_full;
+	relative_moves_from_unknown_position_ = false;
+	track_feature_types_ = false;
 	
 	position initial_pos(num_extruders_);
 	initial_pos.set_xyz_axis_mode(xyz_axis_default_mode_);
@@ -326,6 +334,9 @@ gcode_position::gcode_position(gcode_position_args args) : positions_(args.posit
 
 	is_circular_bed_ = args.is_circular_bed;
 	num_extruders_ = args.num_extruders;
+	tracking_type_ = args.tracking_type;
+	relative_moves_from_unknown_position_ = args.relative_moves_from_unknown_position;
+	track_feature_types_ = args.track_feature_types;
 
 	// Configure the initial position
 	position initial_pos(num_extruders_);
@@ -422,13 +433,13 @@ void gcode_position::add_position(position& pos)
 
 void gcode_position::add_position(parsed_command& cmd)
 {
-
-	position current_position = positions_[0];
+	// Copy the current position into the new front slot in place.  The slot already owns its extruders and
+	// string buffers, so this does not allocate, unlike copy constructing a temporary position.
+	positions_.push_front(positions_[0]);
+	position& current_position = positions_[0];
 	current_position.reset_state();
 	current_position.command = cmd;
 	current_position.is_empty = false;
-	positions_.push_front(current_position);
-
 }
 
 position gcode_position::get_position(int index)
@@ -464,20 +475,17 @@ position * gcode_position::get_previous_position_ptr()
 
 void gcode_position::update(parsed_command& command, const long file_line_number, const long gcode_number, const long file_position)
 {
-	
-	/*if (command.is_empty)
-	{
-		// process any comment sections
-		comment_processor_.update(command.comment);
-		return;
-	}*/
-	
 	add_position(command);
 	position * p_current_pos = get_current_position_ptr();
 	position * p_previous_pos = get_previous_position_ptr();
 	p_current_pos->file_line_number = file_line_number;
 	p_current_pos->gcode_number = gcode_number;
 	p_current_pos->file_position = file_position;
+	// Track the slicer's feature comments, if requested, so that each position is tagged with its feature type
+	if (track_feature_types_ && command.comment.length() > 0)
+	{
+		comment_processor_.update(command.comment);
+	}
 	comment_processor_.update(*p_current_pos);
 
 	if (!command.is_known_command || command.is_empty)
@@ -510,7 +518,7 @@ void gcode_position::update(parsed_command& command, const long file_line_number
 			p_current_pos->z_null != p_previous_pos->z_null);
 
 		// see if our position is homed
-		if (!p_current_pos->has_definite_position)
+		if (tracking_type_ == position_tracking_type_full && !p_current_pos->has_definite_position)
 		{
 			p_current_pos->has_definite_position = (
 				//p_current_pos->x_homed_ &&
@@ -594,6 +602,10 @@ void gcode_position::update(parsed_command& command, const long file_line_number
 			// *************End Calculate extruder state*************
 		}
 
+		// The remaining calculations are only needed when tracking the full printer state.
+		if (tracking_type_ != position_tracking_type_full)
+			return;
+
 		// Calcluate position restructions
 		// TODO:  INCLUDE POSITION RESTRICTION CALCULATIONS!
 		// Set is_in_bounds_ to false if we're not in bounds, it will be true at this point
@@ -799,19 +811,20 @@ void gcode_position::update_position(
 	if (!pos->is_relative_null)
 	{
 		if (pos->is_relative) {
+			// Relative moves on an unknown (null) axis are only added up if requested.  The axis remains null either way.
 			if (update_x)
 			{
-				if (!pos->x_null)
+				if (!pos->x_null || relative_moves_from_unknown_position_)
 					pos->x = x + pos->x;
 			}
 			if (update_y)
 			{
-				if (!pos->y_null)
+				if (!pos->y_null || relative_moves_from_unknown_position_)
 					pos->y = y + pos->y;
 			}
 			if (update_z)
 			{
-				if (!pos->z_null)
+				if (!pos->z_null || relative_moves_from_unknown_position_)
 					pos->z = z + pos->z;
 			}
 		}
@@ -870,7 +883,7 @@ void gcode_position::process_g0_g1(position* pos, parsed_command& cmd)
 	double f = 0;
 	for (unsigned int index = 0; index < cmd.parameters.size(); index++)
 	{
-		const parsed_command_parameter p_cur_param = cmd.parameters[index];
+		const parsed_command_parameter& p_cur_param = cmd.parameters[index];
 		if (p_cur_param.name == "X")
 		{
 			update_x = true;
@@ -914,7 +927,7 @@ void gcode_position::process_g2(position* pos, parsed_command& cmd)
 	double f = 0;
 	for (unsigned int index = 0; index < cmd.parameters.size(); index++)
 	{
-		const parsed_command_parameter p_cur_param = cmd.parameters[index];
+		const parsed_command_parameter& p_cur_param = cmd.parameters[index];
 		if (p_cur_param.name == "X")
 		{
 			update_x = true;
@@ -964,7 +977,7 @@ void gcode_position::process_g10(position* pos, parsed_command& cmd)
 	// Handle extruder offset commands
 	for (unsigned int index = 0; index < cmd.parameters.size(); index++)
 	{
-		parsed_command_parameter p_cur_param = cmd.parameters[index];
+		const parsed_command_parameter& p_cur_param = cmd.parameters[index];
 		/*if (p_cur_param.name == "S")
 		{
 			if (p_cur_param.value_type == 'F')
@@ -1066,7 +1079,7 @@ void gcode_position::process_g28(position* pos, parsed_command& cmd)
 
 	for (unsigned int index = 0; index < cmd.parameters.size(); index++)
 	{
-		parsed_command_parameter p_cur_param = cmd.parameters[index];
+		const parsed_command_parameter& p_cur_param = cmd.parameters[index];
 		if (p_cur_param.name == "X")
 			has_x = true;
 		else if (p_cur_param.name == "Y")
@@ -1170,7 +1183,7 @@ void gcode_position::process_g92(position* pos, parsed_command& cmd)
 	double e = 0;
 	for (unsigned int index = 0; index < cmd.parameters.size(); index++)
 	{
-		parsed_command_parameter p_cur_param = cmd.parameters[index];
+		const parsed_command_parameter& p_cur_param = cmd.parameters[index];
 		if (p_cur_param.name == "X")
 		{
 			update_x = true;
@@ -1302,7 +1315,7 @@ void gcode_position::process_m218(position* pos, parsed_command& cmd)
 	// Handle extruder offset commands
 	for (unsigned int index = 0; index < cmd.parameters.size(); index++)
 	{
-		parsed_command_parameter p_cur_param = cmd.parameters[index];
+		const parsed_command_parameter& p_cur_param = cmd.parameters[index];
 		
 		if (p_cur_param.name == "T")
 		{
@@ -1382,7 +1395,7 @@ void gcode_position::process_t(position* pos, parsed_command& cmd)
 {
 	for (unsigned int index = 0; index < cmd.parameters.size(); index++)
 	{
-		parsed_command_parameter p_cur_param = cmd.parameters[index];
+		const parsed_command_parameter& p_cur_param = cmd.parameters[index];
 		if (p_cur_param.name == "T" && p_cur_param.value_type == 'U')
 		{
 			pos->current_tool = static_cast<int>(p_cur_param.unsigned_long_value);
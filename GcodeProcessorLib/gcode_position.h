@@ -29,6 +29,16 @@
 #include "gcode_parser.h"
 #include "position.h"
 #include "gcode_comment_processor.h"
+// Controls which derived state gcode_position::update maintains for each line.
+// position_tracking_type_full also calculates layers, height increments, zhop, bounds, priming
+// and has_definite_position.  position_tracking_type_motion only tracks XYZ, E, F, axis modes and
+// offsets, which is all that is required when converting or interpolating arcs.
+enum position_tracking_type
+{
+	position_tracking_type_full,
+	position_tracking_type_motion
+};
+
 struct gcode_position_args {
 	gcode_position_args() {
 		position_buffer_size = 50;
@@ -69,6 +79,9 @@ struct gcode_position_args {
 		num_extruders = 1;
 		default_extruder = 0;
 		zero_based_extruder = true;
+		tracking_type = position_tracking_type_full;
+		relative_moves_from_unknown_position = false;
+		track_feature_types = false;
 		std::vector<std::string> location_detection_commands; // Final list of location detection commands
 		set_num_extruders(num_extruders);
 	}
@@ -118,6 +131,14 @@ struct gcode_position_args {
 	std::string xyz_axis_default_mode;
 	std::string e_axis_default_mode;
 	std::string units_default;
+	position_tracking_type tracking_type;
+	// When true, relative XYZ moves are added up even while the axis position is unknown (null).  The axis stays
+	// null, but the distance between positions is correct, which is all the arc welder needs for relative arcs.
+	// When false (the default), relative moves on an unknown axis are ignored.
+	bool relative_moves_from_unknown_position;
+	// When true, slicer feature comments are processed so that each position is tagged with its feature type
+	// (see gcode_comment_processor).  When false (the default), feature_type_tag stays unknown.
+	bool track_feature_types;
 	std::vector<std::string> location_detection_commands; // Final list of location detection commands
 	gcode_position_args& operator=(const gcode_position_args& pos_args);
 	void set_num_extruders(int num_extruders);
@@ -190,6 +211,9 @@ private:
 	int num_extruders_;
 	bool shared_extruder_;
 	bool zero_based_extruder_;
+	position_tracking_type tracking_type_;
+	bool relative_moves_from_unknown_position_;
+	bool track_feature_types_;
 
 	std::map<std::string, pos_function_type> gcode_functions_;
 	std::map<std::string, pos_function_type>::iterator gcode_functions_iterator_;
@@ -0,0 +1,160 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Gcode Processor Library
+//
+// Tools for parsing gcode and calculating printer state from parsed gcode commands.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address:
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "line_numbers.h"
+
+line_number_encoder::line_number_encoder()
+{
+	line_number_ = 0;
+}
+
+long line_number_encoder::get_line_number() const
+{
+	return line_number_;
+}
+
+unsigned char line_number_encoder::get_checksum(const char* text, size_t length)
+{
+	unsigned char checksum = 0;
+	for (size_t index = 0; index < length; index++)
+	{
+		checksum ^= static_cast<unsigned char>(text[index]);
+	}
+	return checksum;
+}
+
+static void append_long(std::string& buffer, long value)
+{
+	char digits[24];
+	int length = 0;
+	unsigned long remaining = value < 0 ? 0UL - static_cast<unsigned long>(value) : static_cast<unsigned long>(value);
+	do
+	{
+		digits[length++] = static_cast<char>('0' + remaining % 10);
+		remaining /= 10;
+	} while (remaining > 0);
+	if (value < 0)
+	{
+		buffer += '-';
+	}
+	while (length > 0)
+	{
+		buffer += digits[--length];
+	}
+}
+
+void line_number_encoder::append_start(std::string& numbered)
+{
+	line_number_ = 0;
+	size_t start = numbered.length();
+	numbered += "N0 M110 N0";
+	numbered += '*';
+	append_long(numbered, get_checksum(numbered.c_str() + start, numbered.length() - start - 1));
+	numbered += '\n';
+}
+
+void line_number_encoder::append_end(std::string& numbered)
+{
+	if (line_.length() > 0)
+	{
+		append_numbered_line(line_, numbered);
+		line_.clear();
+	}
+}
+
+void line_number_encoder::append_numbered(const std::string& text, std::string& numbered)
+{
+	append_numbered(text.c_str(), text.length(), numbered);
+}
+
+void line_number_encoder::append_numbered(const char* text, size_t length, std::string& numbered)
+{
+	size_t start = 0;
+	for (size_t index = 0; index < length; index++)
+	{
+		if (text[index] != '\n')
+		{
+			continue;
+		}
+		if (line_.length() > 0)
+		{
+			line_.append(text + start, index - start);
+			append_numbered_line(line_, numbered);
+			line_.clear();
+		}
+		else
+		{
+			append_numbered_line(text + start, index - start, numbered);
+		}
+		start = index + 1;
+	}
+	line_.append(text + start, length - start);
+}
+
+void line_number_encoder::append_numbered_line(const std::string& line, std::string& numbered)
+{
+	append_numbered_line(line.c_str(), line.length(), numbered);
+}
+
+void line_number_encoder::append_numbered_line(const char* line, size_t length, std::string& numbered)
+{
+	// Remove the comment or old checksum, any old line number and the surrounding whitespace
+	size_t end = 0;
+	while (end < length && line[end] != ';' && line[end] != '*')
+	{
+		end++;
+	}
+	size_t start = 0;
+	while (start < end && (line[start] == ' ' || line[start] == '\t'))
+	{
+		start++;
+	}
+	if (start < end && (line[start] == 'N' || line[start] == 'n'))
+	{
+		start++;
+		while (start < end && ((line[start] >= '0' && line[start] <= '9') || line[start] == '-'))
+		{
+			start++;
+		}
+		while (start < end && (line[start] == ' ' || line[start] == '\t'))
+		{
+			start++;
+		}
+	}
+	while (end > start && (line[end - 1] == ' ' || line[end - 1] == '\t' || line[end - 1] == '\r'))
+	{
+		end--;
+	}
+	if (start == end)
+	{
+		return;
+	}
+
+	size_t line_start = numbered.length();
+	numbered += 'N';
+	append_long(numbered, ++line_number_);
+	numbered += ' ';
+	numbered.append(line + start, end - start);
+	unsigned char checksum = get_checksum(numbered.c_str() + line_start, numbered.length() - line_start);
+	numbered += '*';
+	append_long(numbered, checksum);
+	numbered += '\n';
+}
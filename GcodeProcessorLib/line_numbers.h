@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Gcode Processor Library
+//
+// Tools for parsing gcode and calculating printer state from parsed gcode commands.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address:
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <string>
+
+// Print hosts send every line as "N<line number> <command>*<checksum>", where the checksum is the XOR of every byte
+// before the '*', so that the firmware can ask for a line again if it was corrupted.  The firmware ignores anything
+// after a ';', including a checksum, so comments are removed.  Writing the lines this way ahead of time lets a host
+// stream the file as it is.
+
+class line_number_encoder
+{
+public:
+	line_number_encoder();
+	// Appends "N0 M110 N0", which resets the firmware's line number so that the first line of the file is line 1.
+	void append_start(std::string& numbered);
+	// Numbers any partial line that is left.
+	void append_end(std::string& numbered);
+	// Numbers text, which may contain any number of lines.  Comments, blank lines, surrounding whitespace and any line
+	// number or checksum that was already there are removed.  A partial line is kept until the rest of it arrives.
+	void append_numbered(const char* text, size_t length, std::string& numbered);
+	void append_numbered(const std::string& text, std::string& numbered);
+	// Numbers a single line, which must not contain a line break.
+	void append_numbered_line(const char* line, size_t length, std::string& numbered);
+	void append_numbered_line(const std::string& line, std::string& numbered);
+	long get_line_number() const;
+	static unsigned char get_checksum(const char* text, size_t length);
+private:
+	long line_number_;
+	std::string line_;
+};
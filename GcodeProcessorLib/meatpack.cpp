@@ -0,0 +1,348 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Gcode Processor Library
+//
+// Tools for parsing gcode and calculating printer state from parsed gcode commands.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address:
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "meatpack.h"
+
+static void append_signal(std::string& packed, unsigned char command)
+{
+	packed += static_cast<char>(MEATPACK_SIGNAL_BYTE);
+	packed += static_cast<char>(MEATPACK_SIGNAL_BYTE);
+	packed += static_cast<char>(command);
+}
+
+// The signal that turns packing on or off costs 3 bytes, and needs to be sent again for the next line.
+#define MEATPACK_SWITCH_COST 6
+
+meatpack_encoder::meatpack_encoder()
+{
+	no_spaces_ = false;
+	keep_comments_ = false;
+	is_packing_ = false;
+}
+
+meatpack_encoder::meatpack_encoder(bool no_spaces, bool keep_comments)
+{
+	no_spaces_ = no_spaces;
+	keep_comments_ = keep_comments;
+	is_packing_ = false;
+}
+
+void meatpack_encoder::set_no_spaces(bool no_spaces)
+{
+	no_spaces_ = no_spaces;
+}
+
+bool meatpack_encoder::get_no_spaces() const
+{
+	return no_spaces_;
+}
+
+void meatpack_encoder::append_start(std::string& packed)
+{
+	append_signal(packed, meatpack_command_enable_packing);
+	append_signal(packed, no_spaces_ ? meatpack_command_enable_no_spaces : meatpack_command_disable_no_spaces);
+	is_packing_ = true;
+}
+
+void meatpack_encoder::append_end(std::string& packed)
+{
+	if (line_.length() > 0)
+	{
+		append_packed_line_(packed);
+	}
+	if (is_packing_)
+	{
+		append_signal(packed, meatpack_command_disable_packing);
+		is_packing_ = false;
+	}
+}
+
+void meatpack_encoder::append_packed(const std::string& text, std::string& packed)
+{
+	append_packed(text.c_str(), text.length(), packed);
+}
+
+void meatpack_encoder::append_packed(const char* text, size_t length, std::string& packed)
+{
+	for (size_t index = 0; index < length; index++)
+	{
+		if (text[index] == '\n')
+		{
+			append_packed_line_(packed);
+		}
+		else
+		{
+			line_ += text[index];
+		}
+	}
+}
+
+unsigned char meatpack_encoder::get_code_(char c) const
+{
+	if (c >= '0' && c <= '9')
+	{
+		return static_cast<unsigned char>(c - '0');
+	}
+	switch (c)
+	{
+	case '.':
+		return 0x0A;
+	case ' ':
+		return no_spaces_ ? MEATPACK_NOT_PACKED : MEATPACK_SPACE_CODE;
+	case MEATPACK_SPACE_REPLACEMENT:
+		return no_spaces_ ? MEATPACK_SPACE_CODE : MEATPACK_NOT_PACKED;
+	case '\n':
+		return 0x0C;
+	case 'G':
+		return 0x0D;
+	case 'X':
+		return 0x0E;
+	default:
+		return MEATPACK_NOT_PACKED;
+	}
+}
+
+void meatpack_encoder::append_packed_line_(std::string& packed)
+{
+	// Remove the comment and any surrounding whitespace
+	size_t comment_start = line_.find(';');
+	size_t end = comment_start == std::string::npos || keep_comments_ ? line_.length() : comment_start;
+	size_t start = 0;
+	while (start < end && (line_[start] == ' ' || line_[start] == '\t' || line_[start] == '\r'))
+	{
+		start++;
+	}
+	while (end > start && (line_[end - 1] == ' ' || line_[end - 1] == '\t' || line_[end - 1] == '\r'))
+	{
+		end--;
+	}
+	if (start == end)
+	{
+		line_.clear();
+		return;
+	}
+	// The parameters of G commands are still found without spaces.  Other commands, like M117, may need them, and so
+	// do comments.
+	bool remove_spaces = no_spaces_ && (line_[start] == 'G' || line_[start] == 'g');
+	size_t length = start;
+	for (size_t index = start; index < end; index++)
+	{
+		if (line_[index] == ';')
+		{
+			remove_spaces = false;
+		}
+		if (!remove_spaces || (line_[index] != ' ' && line_[index] != '\t'))
+		{
+			line_[length++] = line_[index];
+		}
+	}
+	line_.resize(length);
+	line_ += '\n';
+
+	// Write the line as it is if that is shorter, including the signals needed to switch packing off and back on.
+	size_t packed_length = (line_.length() - start + 1) / 2;
+	for (size_t index = start; index < line_.length(); index++)
+	{
+		if (get_code_(line_[index]) == MEATPACK_NOT_PACKED)
+		{
+			packed_length++;
+		}
+	}
+	size_t unpacked_length = line_.length() - start;
+	bool pack_line = is_packing_
+		? packed_length <= unpacked_length + MEATPACK_SWITCH_COST
+		: packed_length + MEATPACK_SWITCH_COST < unpacked_length;
+	if (pack_line != is_packing_)
+	{
+		append_signal(packed, pack_line ? meatpack_command_enable_packing : meatpack_command_disable_packing);
+		is_packing_ = pack_line;
+	}
+	if (!pack_line)
+	{
+		packed.append(line_, start, unpacked_length);
+		line_.clear();
+		return;
+	}
+
+	// Pack two characters at a time.  An odd line ends with the newline packed first, after which the firmware ignores
+	// the second character, so another newline is used as padding.
+	for (size_t index = start; index < line_.length(); index += 2)
+	{
+		char first = line_[index];
+		char second = index + 1 < line_.length() ? line_[index + 1] : '\n';
+		unsigned char first_code = get_code_(first);
+		unsigned char second_code = get_code_(second);
+		packed += static_cast<char>((second_code << 4) | first_code);
+		if (first_code == MEATPACK_NOT_PACKED)
+		{
+			packed += first;
+		}
+		if (second_code == MEATPACK_NOT_PACKED)
+		{
+			packed += second;
+		}
+	}
+	line_.clear();
+}
+
+meatpack_decoder::meatpack_decoder()
+{
+	is_packing_ = false;
+	no_spaces_ = false;
+	signal_count_ = 0;
+	is_command_next_ = false;
+	full_char_count_ = 0;
+	second_char_ = '\0';
+}
+
+bool meatpack_decoder::is_packing() const
+{
+	return is_packing_;
+}
+
+bool meatpack_decoder::get_no_spaces() const
+{
+	return no_spaces_;
+}
+
+void meatpack_decoder::append_unpacked(const std::string& packed, std::string& text)
+{
+	append_unpacked(packed.c_str(), packed.length(), text);
+}
+
+void meatpack_decoder::append_unpacked(const char* packed, size_t length, std::string& text)
+{
+	for (size_t index = 0; index < length; index++)
+	{
+		unsigned char c = static_cast<unsigned char>(packed[index]);
+		if (c == MEATPACK_SIGNAL_BYTE)
+		{
+			if (signal_count_ > 0)
+			{
+				is_command_next_ = true;
+				signal_count_ = 0;
+			}
+			else
+			{
+				signal_count_++;
+			}
+		}
+		else if (is_command_next_)
+		{
+			handle_command_(c);
+			is_command_next_ = false;
+		}
+		else
+		{
+			if (signal_count_ > 0)
+			{
+				// A single signal byte is a packed byte with two characters that weren't packed
+				append_unpacked_byte_(MEATPACK_SIGNAL_BYTE, text);
+				signal_count_ = 0;
+			}
+			append_unpacked_byte_(c, text);
+		}
+	}
+}
+
+void meatpack_decoder::handle_command_(unsigned char command)
+{
+	switch (command)
+	{
+	case meatpack_command_enable_packing:
+		is_packing_ = true;
+		break;
+	case meatpack_command_disable_packing:
+		is_packing_ = false;
+		break;
+	case meatpack_command_reset_all:
+		is_packing_ = false;
+		no_spaces_ = false;
+		break;
+	case meatpack_command_enable_no_spaces:
+		no_spaces_ = true;
+		break;
+	case meatpack_command_disable_no_spaces:
+		no_spaces_ = false;
+		break;
+	default:
+		break;
+	}
+}
+
+char meatpack_decoder::get_character_(unsigned char code) const
+{
+	if (code == MEATPACK_SPACE_CODE && no_spaces_)
+	{
+		return MEATPACK_SPACE_REPLACEMENT;
+	}
+	return meatpack_characters[code];
+}
+
+void meatpack_decoder::append_unpacked_byte_(unsigned char c, std::string& text)
+{
+	if (!is_packing_)
+	{
+		text += static_cast<char>(c);
+		return;
+	}
+	if (full_char_count_ > 0)
+	{
+		// A character that couldn't be packed
+		text += static_cast<char>(c);
+		if (second_char_ != '\0')
+		{
+			text += second_char_;
+			second_char_ = '\0';
+		}
+		full_char_count_--;
+		return;
+	}
+	unsigned char first_code = c & 0x0F;
+	unsigned char second_code = (c >> 4) & 0x0F;
+	if (first_code == MEATPACK_NOT_PACKED)
+	{
+		full_char_count_++;
+		if (second_code == MEATPACK_NOT_PACKED)
+		{
+			full_char_count_++;
+		}
+		else
+		{
+			second_char_ = get_character_(second_code);
+		}
+		return;
+	}
+	char first = get_character_(first_code);
+	text += first;
+	// Nothing follows a newline in the same byte
+	if (first != '\n')
+	{
+		if (second_code == MEATPACK_NOT_PACKED)
+		{
+			full_char_count_++;
+		}
+		else
+		{
+			text += get_character_(second_code);
+		}
+	}
+}
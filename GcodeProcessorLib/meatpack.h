@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Gcode Processor Library
+//
+// Tools for parsing gcode and calculating printer state from parsed gcode commands.
+//
+// Copyright(C) 2021 - Brad Hochgesang
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+//
+// You can contact the author at the following email address:
+// FormerLurker@pm.me
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <string>
+
+// MeatPack packs the 15 most common gcode characters into 4 bits each, two per byte, which roughly halves the number
+// of bytes sent to the printer.  The low 4 bits hold the first character.  0b1111 means the character couldn't be
+// packed, and it follows the packed byte in full.  Two signal bytes followed by a command byte switch packing on and
+// off.  This matches the MeatPack implementation in Marlin and the Prusa firmware.
+#define MEATPACK_SIGNAL_BYTE 0xFF
+#define MEATPACK_NOT_PACKED 0x0F
+// In no spaces mode, the code for ' ' stands for 'E' instead.
+#define MEATPACK_SPACE_CODE 0x0B
+#define MEATPACK_SPACE_REPLACEMENT 'E'
+
+enum meatpack_command
+{
+	meatpack_command_enable_packing = 251,
+	meatpack_command_disable_packing = 250,
+	meatpack_command_reset_all = 249,
+	meatpack_command_query_config = 248,
+	meatpack_command_enable_no_spaces = 247,
+	meatpack_command_disable_no_spaces = 246
+};
+
+static const char meatpack_characters[MEATPACK_NOT_PACKED] = {
+	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '.', ' ', '\n', 'G', 'X'
+};
+
+class meatpack_encoder
+{
+public:
+	meatpack_encoder();
+	meatpack_encoder(bool no_spaces, bool keep_comments);
+	void set_no_spaces(bool no_spaces);
+	bool get_no_spaces() const;
+	// Appends the signals that switch the firmware to packed mode.
+	void append_start(std::string& packed);
+	// Packs any partial line that is left, and appends the signal that switches the firmware back to plain text.
+	void append_end(std::string& packed);
+	// Packs text, which may contain any number of lines.  Blank lines, surrounding whitespace and, unless they are kept,
+	// comments are removed.  In no spaces mode so are the spaces in G commands.  A partial line is kept until the rest
+	// of it arrives.  Lines that pack badly, like most comments, are written without packing.
+	void append_packed(const char* text, size_t length, std::string& packed);
+	void append_packed(const std::string& text, std::string& packed);
+private:
+	void append_packed_line_(std::string& packed);
+	unsigned char get_code_(char c) const;
+	bool no_spaces_;
+	bool keep_comments_;
+	bool is_packing_;
+	std::string line_;
+};
+
+class meatpack_decoder
+{
+public:
+	meatpack_decoder();
+	// Unpacks bytes written by a meatpack_encoder, or any other MeatPack stream, the same way the firmware does.
+	void append_unpacked(const char* packed, size_t length, std::string& text);
+	void append_unpacked(const std::string& packed, std::string& text);
+	bool is_packing() const;
+	bool get_no_spaces() const;
+private:
+	void handle_command_(unsigned char command);
+	void append_unpacked_byte_(unsigned char c, std::string& text);
+	char get_character_(unsigned char code) const;
+	bool is_packing_;
+	bool no_spaces_;
+	int signal_count_;
+	bool is_command_next_;
+	int full_char_count_;
+	char second_char_;
+};
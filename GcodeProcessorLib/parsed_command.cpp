@@ -56,7 +56,7 @@ std::string parsed_command::rewrite_gcode_string()
 	{
 		for (unsigned int index = 0; index < parameters.size(); index++)
 		{
-			parsed_command_parameter p = parameters[index];
+			const parsed_command_parameter& p = parameters[index];
 			
 			stream << " " << p.name;
 			switch (p.value_type)
@@ -24,6 +24,7 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <utility>
 std::string position::to_string(bool rewrite, bool verbose, std::string additional_comment)
 {
 	if (verbose)
@@ -221,60 +222,10 @@ position::position(int extruder_count)
 position::position(const position &pos)
 {
 	has_been_deleted = false;
-	is_empty = pos.is_empty;
-	feature_type_tag = pos.feature_type_tag;
-	f = pos.f;
-	f_null = pos.f_null;
-	x = pos.x;
-	x_null = pos.x_null;
-	x_offset = pos.x_offset;
-	x_firmware_offset = pos.x_firmware_offset;
-	x_homed = pos.x_homed;
-	y = pos.y;
-	y_null = pos.y_null;
-	y_offset = pos.y_offset;
-	y_firmware_offset = pos.y_firmware_offset;
-	y_homed = pos.y_homed;
-	z = pos.z;
-	z_null = pos.z_null;
-	z_offset = pos.z_offset;
-	z_firmware_offset = pos.z_firmware_offset;
-	z_homed = pos.z_homed;
-	is_relative = pos.is_relative;
-	is_relative_null = pos.is_relative_null;
-	is_extruder_relative = pos.is_extruder_relative;
-	is_extruder_relative_null = pos.is_extruder_relative_null;
-	is_metric = pos.is_metric;
-	is_metric_null = pos.is_metric_null;
-	last_extrusion_height = pos.last_extrusion_height;
-	last_extrusion_height_null = pos.last_extrusion_height_null;
-	layer = pos.layer;
-	height = pos.height;
-	height_increment = pos.height_increment;
-	height_increment_change_count = pos.height_increment_change_count;
-	is_printer_primed = pos.is_printer_primed;
-	has_definite_position = pos.has_definite_position;
-	z_relative = pos.z_relative;
-	is_in_position = pos.is_in_position;
-	in_path_position = pos.in_path_position;
-	is_zhop = pos.is_zhop;
-	is_layer_change = pos.is_layer_change;
-	is_height_change = pos.is_height_change;
-	is_height_increment_change = pos.is_height_increment_change;
-	is_xy_travel = pos.is_xy_travel;
-	is_xyz_travel = pos.is_xyz_travel;
-	has_xy_position_changed = pos.has_xy_position_changed;
-	has_position_changed = pos.has_position_changed;
-	has_received_home_command = pos.has_received_home_command;
-	file_line_number = pos.file_line_number;
-	gcode_number = pos.gcode_number;
-	file_position = pos.file_position;
-	gcode_ignored = pos.gcode_ignored;
-	is_in_bounds = pos.is_in_bounds;
-	current_tool = pos.current_tool;
 	p_extruders = NULL;
-	command = pos.command;
 	num_extruders = 0;
+	copy_state_(pos);
+	command = pos.command;
 	set_num_extruders(pos.num_extruders);
 	for(int index=0; index < pos.num_extruders; index++)
 	{
@@ -282,6 +233,18 @@ position::position(const position &pos)
 	}
 }
 
+position::position(position&& pos)
+{
+	has_been_deleted = false;
+	copy_state_(pos);
+	command = std::move(pos.command);
+	// Take ownership of the extruders, leaving the source with none.
+	p_extruders = pos.p_extruders;
+	num_extruders = pos.num_extruders;
+	pos.p_extruders = NULL;
+	pos.num_extruders = 0;
+}
+
 position::~position()
 {
 	if (has_been_deleted)
@@ -291,6 +254,38 @@ position::~position()
 }
 
 position& position::operator=(const position& pos) {
+	copy_state_(pos);
+	command = pos.command;
+	if (pos.num_extruders != num_extruders)
+	{
+		set_num_extruders(pos.num_extruders);
+	}
+	
+	
+	for (int index = 0; index < pos.num_extruders; index++)
+	{
+		p_extruders[index] = pos.p_extruders[index];
+	}
+	return *this;
+}
+
+position& position::operator=(position&& pos) {
+	if (this == &pos)
+		return *this;
+	copy_state_(pos);
+	command = std::move(pos.command);
+	// Swap the extruders so that the source releases ours when it is destroyed.
+	extruder* p_temp_extruders = p_extruders;
+	int temp_num_extruders = num_extruders;
+	p_extruders = pos.p_extruders;
+	num_extruders = pos.num_extruders;
+	pos.p_extruders = p_temp_extruders;
+	pos.num_extruders = temp_num_extruders;
+	return *this;
+}
+
+void position::copy_state_(const position& pos)
+{
 	is_empty = pos.is_empty;
 	feature_type_tag = pos.feature_type_tag;
 	f = pos.f;
@@ -342,18 +337,6 @@ position& position::operator=(const position& pos) {
 	gcode_ignored = pos.gcode_ignored;
 	is_in_bounds = pos.is_in_bounds;
 	current_tool = pos.current_tool;
-	command = pos.command;
-	if (pos.num_extruders != num_extruders)
-	{
-		set_num_extruders(pos.num_extruders);
-	}
-	
-	
-	for (int index = 0; index < pos.num_extruders; index++)
-	{
-		p_extruders[index] = pos.p_extruders[index];
-	}
-	return *this;
 }
 
 bool position::is_travel()
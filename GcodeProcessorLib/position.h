@@ -32,8 +32,10 @@ struct position
 	position();
 	position(int extruder_count);
 	position(const position &pos); // Copy Constructor
+	position(position&& pos); // Move Constructor
 	virtual ~position();
 	position& operator=(const position& pos);
+	position& operator=(position&& pos);
 	std::string to_string(bool rewrite, bool verbose, std::string additional_comment);
 	void reset_state();
 	parsed_command command;
@@ -103,5 +105,8 @@ struct position
 	void set_units_default(const std::string& units_default);
 	bool can_take_snapshot();
 	bool is_travel();
+private:
+	// Copies everything except the command and the extruders
+	void copy_state_(const position& pos);
 };
 #endif
\ No newline at end of file
@@ -1,6 +1,10 @@
 set(GcodeProcessorLibSources ${GcodeProcessorLibSources}
     array_list.h
+    bgcode.cpp
+    bgcode.h
     circular_buffer.h
+    compressed_file.cpp
+    compressed_file.h
     extruder.cpp
     extruder.h
     gcode_comment_processor.cpp
@@ -9,8 +13,12 @@ set(GcodeProcessorLibSources ${GcodeProcessorLibSources}
     gcode_parser.h
     gcode_position.cpp
     gcode_position.h
+    line_numbers.cpp
+    line_numbers.h
     logger.cpp
     logger.h
+    meatpack.cpp
+    meatpack.h
     parsed_command.cpp
     parsed_command.h
     parsed_command_parameter.cpp
@@ -212,13 +212,14 @@ double utilities::get_cartesian_distance(double x1, double y1, double z1, double
 
 double utilities::get_arc_distance(double x1, double y1, double z1, double x2, double y2, double z2, double i, double j, double r, bool is_clockwise)
 {
-	double center_x = x1 - i;
-	double center_y = y1 - j;
+	// I and J are the offset from the start point to the center, so the start point is at -I, -J from the center.
+	double center_x = x1 + i;
+	double center_y = y1 + j;
 	double radius = utilities::hypot(i, j);
 	double z_dist = z2 - z1;
 	double rt_x = x2 - center_x;
 	double rt_y = y2 - center_y;
-	double angular_travel_total = utilities::atan2(i * rt_y - j * rt_x, i * rt_x + j * rt_y);
+	double angular_travel_total = utilities::atan2(-i * rt_y + j * rt_x, -i * rt_x - j * rt_y);
 	if (angular_travel_total < 0) { angular_travel_total += 2.0 * PI_DOUBLE; }
 	// Adjust the angular travel if the direction is clockwise
 	if (is_clockwise) { angular_travel_total -= 2.0 * PI_DOUBLE; }
@@ -664,9 +665,8 @@ void* utilities::memcpy(void* dest, const void* src, size_t n)
 
 std::string utilities::dtos(double x, unsigned char precision)
 {
-	static char buffer[FPCONV_BUFFER_LENGTH];
-	char* p = buffer;
-	buffer[fpconv_dtos(x, buffer, precision)] = '\0';
+	char buffer[FPCONV_BUFFER_LENGTH];
+	int length = dtos(x, precision, buffer);
 	/* This is code that can be used to compare the output of the
 		 modified fpconv_dtos function to the ofstream output
 		 Note:  It currently only fails for some checks where the original double does not store
@@ -680,7 +680,92 @@ std::string utilities::dtos(double x, unsigned char precision)
 		std::cout << std::fixed << "Failed to convert: " << std::setprecision(24) << x << " Precision:" << std::setprecision(0) << static_cast <int> (precision) << " String:" << std::string(buffer) << " Stream:" << stream.str() << std::endl;
 	}
 	*/
-	return buffer;
+	return std::string(buffer, length);
+}
+
+int utilities::dtos(double x, unsigned char precision, char* buffer)
+{
+	int length = fpconv_dtos(x, buffer, precision);
+	buffer[length] = '\0';
+	return length;
+}
+
+void utilities::append_double(std::string& buffer, double x, unsigned char precision)
+{
+	char value[FPCONV_BUFFER_LENGTH];
+	buffer.append(value, fpconv_dtos(x, value, precision));
+}
+
+void utilities::append_parameter(std::string& buffer, char word, double value, unsigned char precision)
+{
+	buffer += ' ';
+	buffer += word;
+	append_double(buffer, value, precision);
+}
+
+int utilities::compact_number(char* number, int length)
+{
+	int start = length > 0 && (number[0] == '-' || number[0] == '+') ? 1 : 0;
+	if (length <= start)
+	{
+		return length;
+	}
+	int decimal_index = -1;
+	for (int index = start; index < length; index++)
+	{
+		if (number[index] == '.' && decimal_index < 0)
+		{
+			decimal_index = index;
+		}
+		else if (number[index] < '0' || number[index] > '9')
+		{
+			return length;
+		}
+	}
+	if (decimal_index >= 0)
+	{
+		while (length > decimal_index + 1 && number[length - 1] == '0')
+		{
+			length--;
+		}
+		if (length == decimal_index + 1)
+		{
+			length--;
+		}
+	}
+	// Remove the zero before the decimal point
+	if (length > start + 1 && number[start] == '0' && number[start + 1] == '.')
+	{
+		std::memmove(number + start, number + start + 1, length - start - 1);
+		length--;
+	}
+	// Zero, with or without a sign
+	if (length == start || (length == start + 1 && number[start] == '0'))
+	{
+		number[0] = '0';
+		length = 1;
+	}
+	return length;
+}
+
+int utilities::dtos_compact(double x, unsigned char precision, char* buffer)
+{
+	int length = compact_number(buffer, fpconv_dtos(x, buffer, precision));
+	buffer[length] = '\0';
+	return length;
+}
+
+void utilities::append_compact_double(std::string& buffer, double x, unsigned char precision)
+{
+	char value[FPCONV_BUFFER_LENGTH];
+	buffer.append(value, dtos_compact(x, precision, value));
+}
+
+void utilities::append_compact_parameter(std::string& buffer, char word, double value, unsigned char precision)
+{
+	buffer += ' ';
+	buffer += word;
+	append_compact_double(buffer, value, precision);
 }
 /*
 bool case_insensitive_compare_char(char& c1, char& c2)
@@ -179,6 +179,28 @@ namespace utilities{
 	void* memcpy(void* dest, const void* src, size_t n);
 
 	std::string dtos(double x, unsigned char precision);
+
+	// Writes x with a fixed number of decimals into a caller supplied buffer of at least FPCONV_BUFFER_LENGTH characters,
+	// null terminates it, and returns the length.  Nothing is allocated and no shared state is used.
+	int dtos(double x, unsigned char precision, char* buffer);
+
+	// Appends x with a fixed number of decimals to the end of buffer.  Clear and reuse the same buffer to avoid allocations.
+	void append_double(std::string& buffer, double x, unsigned char precision);
+
+	// Appends a gcode parameter word and its value, for example " X10.000", to the end of buffer.
+	void append_parameter(std::string& buffer, char word, double value, unsigned char precision);
+
+	// Shortens a formatted number in place by removing trailing zeros, a trailing decimal point and the zero before the
+	// decimal point, for example "-0.500" becomes "-.5" and "-0.000" becomes "0".  Returns the new length.  Anything
+	// that isn't a plain decimal number is left alone.
+	int compact_number(char* number, int length);
+
+	// The same as dtos(x, precision, buffer), but the result is compacted with compact_number.
+	int dtos_compact(double x, unsigned char precision, char* buffer);
+
+	void append_compact_double(std::string& buffer, double x, unsigned char precision);
+
+	void append_compact_parameter(std::string& buffer, char word, double value, unsigned char precision);
 	
 	std::string replace(std::string subject, const std::string& search, const std::string& replace);
 
@@ -48,7 +48,7 @@ PyObject* py_arc_welder::build_py_progress(const arc_welder_progress& progress,
   if (pyTravelMessage == NULL)
     return NULL;
   double total_travel_count_reduction_percent = progress.travel_statistics.get_total_count_reduction_percent();
-  PyObject* py_progress = Py_BuildValue("{s:d,s:d,s:d,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:f,s:f,s:f,s:f,s:i,s:i,s:f,s:f,s:f,s:i,s:i,s:f}",
+  PyObject* py_progress = Py_BuildValue("{s:d,s:d,s:d,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:f,s:f,s:f,s:f,s:i,s:i,s:f,s:f,s:f,s:i,s:i,s:f,s:i,s:i,s:i,s:i,s:l}",
     "percent_complete",
     progress.percent_complete,												//1
     "seconds_elapsed",
@@ -98,7 +98,17 @@ PyObject* py_arc_welder::build_py_progress(const arc_welder_progress& progress,
     "target_file_total_travel_count",
     progress.travel_statistics.total_count_target,    //24
     "total_travel_count_reduction_percent",
-    total_travel_count_reduction_percent              //25
+    total_travel_count_reduction_percent,             //25
+    "num_prefilter_rejects",
+    progress.num_prefilter_rejects,                   //26
+    "beziers_created",
+    progress.beziers_created,                         //27
+    "points_simplified",
+    progress.points_simplified,                       //28
+    "num_precision_reductions",
+    progress.num_precision_reductions,                //29
+    "bytes_saved",
+    progress.bytes_saved                              //30
 
   );
 
@@ -391,6 +401,36 @@ bool py_gcode_arc_args::parse_args(PyObject* py_args, py_logger* p_py_logger, py
     }
   }
 #pragma endregion max_gcode_length
+#pragma region lookahead_window
+  // Extract lookahead_window
+  PyObject* py_lookahead_window = PyDict_GetItemString(py_args, "lookahead_window");
+  if (py_lookahead_window == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve the 'lookahead_window' parameter from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.lookahead_window = (int)gcode_arc_converter::PyIntOrLong_AsLong(py_lookahead_window);
+    if (args.lookahead_window < 0)
+    {
+      args.lookahead_window = DEFAULT_LOOKAHEAD_WINDOW;
+    }
+  }
+#pragma endregion lookahead_window
+#pragma region lookahead_minimize_bytes
+  // extract lookahead_minimize_bytes
+  PyObject* py_lookahead_minimize_bytes = PyDict_GetItemString(py_args, "lookahead_minimize_bytes");
+  if (py_lookahead_minimize_bytes == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'lookahead_minimize_bytes' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.lookahead_minimize_bytes = PyLong_AsLong(py_lookahead_minimize_bytes) > 0;
+  }
+#pragma endregion lookahead_minimize_bytes
 #pragma region allow_3d_arcs
   // extract allow_3d_arcs
   PyObject* py_allow_3d_arcs = PyDict_GetItemString(py_args, "allow_3d_arcs");
@@ -417,6 +457,190 @@ bool py_gcode_arc_args::parse_args(PyObject* py_args, py_logger* p_py_logger, py
     args.allow_travel_arcs = PyLong_AsLong(py_allow_travel_arcs) > 0;
   }
 #pragma endregion allow_travel_arcs
+#pragma region allow_bezier_curves
+  // extract allow_bezier_curves
+  PyObject* py_allow_bezier_curves = PyDict_GetItemString(py_args, "allow_bezier_curves");
+  if (py_allow_bezier_curves == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'allow_bezier_curves' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.allow_bezier_curves = PyLong_AsLong(py_allow_bezier_curves) > 0;
+  }
+#pragma endregion allow_bezier_curves
+#pragma region simplify_polylines
+  // extract simplify_polylines
+  PyObject* py_simplify_polylines = PyDict_GetItemString(py_args, "simplify_polylines");
+  if (py_simplify_polylines == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'simplify_polylines' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.simplify_polylines = PyLong_AsLong(py_simplify_polylines) > 0;
+  }
+#pragma endregion simplify_polylines
+#pragma region merge_arcs
+  // extract merge_arcs
+  PyObject* py_merge_arcs = PyDict_GetItemString(py_args, "merge_arcs");
+  if (py_merge_arcs == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'merge_arcs' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.merge_arcs = PyLong_AsLong(py_merge_arcs) > 0;
+  }
+#pragma endregion merge_arcs
+#pragma region weld_through_comments
+  // extract weld_through_comments
+  PyObject* py_weld_through_comments = PyDict_GetItemString(py_args, "weld_through_comments");
+  if (py_weld_through_comments == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'weld_through_comments' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.weld_through_comments = PyLong_AsLong(py_weld_through_comments) > 0;
+  }
+#pragma endregion weld_through_comments
+#pragma region feature_tolerances
+  // extract feature_tolerances, a dict of feature names with dicts that may contain 'resolution_mm',
+  // 'path_tolerance_percent' and 'max_radius_mm'
+  PyObject* py_feature_tolerances = PyDict_GetItemString(py_args, "feature_tolerances");
+  if (py_feature_tolerances == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'feature_tolerances' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else if (PyDict_Check(py_feature_tolerances))
+  {
+    PyObject* py_feature_name;
+    PyObject* py_feature_tolerance;
+    Py_ssize_t position = 0;
+    while (PyDict_Next(py_feature_tolerances, &position, &py_feature_name, &py_feature_tolerance))
+    {
+      const char* feature_name = gcode_arc_converter::PyUnicode_SafeAsString(py_feature_name);
+      int feature_type = feature_name == NULL ? -1 : feature_tolerance::get_feature_type(feature_name);
+      if (feature_type < 0 || !PyDict_Check(py_feature_tolerance))
+      {
+        PyErr_Clear();
+        std::string message = "ParseArgs - Skipping an unknown or invalid entry in 'feature_tolerances'.";
+        p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+        continue;
+      }
+      feature_tolerance tolerance;
+      PyObject* py_value = PyDict_GetItemString(py_feature_tolerance, "resolution_mm");
+      if (py_value != NULL)
+      {
+        tolerance.resolution_mm = gcode_arc_converter::PyFloatOrInt_AsDouble(py_value);
+      }
+      py_value = PyDict_GetItemString(py_feature_tolerance, "path_tolerance_percent");
+      if (py_value != NULL)
+      {
+        tolerance.path_tolerance_percent = gcode_arc_converter::PyFloatOrInt_AsDouble(py_value);
+      }
+      py_value = PyDict_GetItemString(py_feature_tolerance, "max_radius_mm");
+      if (py_value != NULL)
+      {
+        tolerance.max_radius_mm = gcode_arc_converter::PyFloatOrInt_AsDouble(py_value);
+      }
+      // A resolution or radius of 0 is not valid, use the default instead.
+      if (tolerance.resolution_mm == 0)
+      {
+        tolerance.resolution_mm = -1;
+      }
+      if (tolerance.max_radius_mm == 0)
+      {
+        tolerance.max_radius_mm = -1;
+      }
+      args.feature_tolerances[feature_type] = tolerance;
+    }
+  }
+#pragma endregion feature_tolerances
+#pragma region reduce_precision_to_fit
+  // extract reduce_precision_to_fit
+  PyObject* py_reduce_precision_to_fit = PyDict_GetItemString(py_args, "reduce_precision_to_fit");
+  if (py_reduce_precision_to_fit == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'reduce_precision_to_fit' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.reduce_precision_to_fit = PyLong_AsLong(py_reduce_precision_to_fit) > 0;
+  }
+#pragma endregion reduce_precision_to_fit
+#pragma region compact_output
+  // extract compact_output
+  PyObject* py_compact_output = PyDict_GetItemString(py_args, "compact_output");
+  if (py_compact_output == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'compact_output' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.compact_output = PyLong_AsLong(py_compact_output) > 0;
+  }
+#pragma endregion compact_output
+#pragma region strip_comments
+  // extract strip_comments
+  PyObject* py_strip_comments = PyDict_GetItemString(py_args, "strip_comments");
+  if (py_strip_comments == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'strip_comments' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.strip_comments = PyLong_AsLong(py_strip_comments) > 0;
+  }
+#pragma endregion strip_comments
+#pragma region meatpack_output
+  // extract meatpack_output
+  PyObject* py_meatpack_output = PyDict_GetItemString(py_args, "meatpack_output");
+  if (py_meatpack_output == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'meatpack_output' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.meatpack_output = PyLong_AsLong(py_meatpack_output) > 0;
+  }
+#pragma endregion meatpack_output
+#pragma region meatpack_no_spaces
+  // extract meatpack_no_spaces
+  PyObject* py_meatpack_no_spaces = PyDict_GetItemString(py_args, "meatpack_no_spaces");
+  if (py_meatpack_no_spaces == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'meatpack_no_spaces' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.meatpack_no_spaces = PyLong_AsLong(py_meatpack_no_spaces) > 0;
+  }
+#pragma endregion meatpack_no_spaces
+#pragma region line_numbers
+  // extract line_numbers
+  PyObject* py_line_numbers = PyDict_GetItemString(py_args, "line_numbers");
+  if (py_line_numbers == NULL)
+  {
+    std::string message = "ParseArgs - Unable to retrieve 'line_numbers' from the args.";
+    p_py_logger->log(WARNING, GCODE_CONVERSION, message);
+  }
+  else
+  {
+    args.line_numbers = PyLong_AsLong(py_line_numbers) > 0;
+  }
+#pragma endregion line_numbers
 #pragma region g90_g91_influences_extruder
   // Extract G90/G91 influences extruder
   // g90_influences_extruder